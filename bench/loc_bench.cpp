@@ -0,0 +1,846 @@
+// loc_bench: micro- and pass-level benchmarks with JSON baselines.
+//
+//   loc_bench [--filter=S] [--quick] [--min-time=SEC] [--repetitions=N]
+//             [--runs=N] [--threads=N] [--simd=ISA] [--json=FILE]
+//             [--baseline=FILE] [--tolerance=F]
+//
+// Each benchmark runs enough iterations to fill --min-time per repetition;
+// the reported time is the median over repetitions. With --runs=N the
+// whole suite is measured N times; each benchmark reports its median run
+// and the spread of the runs. --json writes the results; --baseline
+// compares against a previous --json file and exits with status 1 if any
+// benchmark is slower than baseline * (1 + margin).
+//
+// A fixed calibration workload is timed just before each benchmark, and
+// the comparison is made in units of it: a baseline recorded on a faster
+// or slower host (or while this one was busier) scales with the
+// calibration instead of reading as a regression. The margin is
+// --tolerance if given, else per entry: kSpreadMargins times the spread
+// recorded in the baseline, clamped to [kMinTolerance, kMaxTolerance]. A
+// benchmark over it is measured once more, and counts if that run is too.
+#include "loc/frontend/ast.hpp"
+#include "loc/ir/graph.hpp"
+#include "loc/ir/lower.hpp"
+#include "loc/ir/passes/const_fold.hpp"
+#include "loc/ir/passes/dce.hpp"
+#include "loc/ir/serialize.hpp"
+#include "loc/runtime/executor.hpp"
+#include "loc/runtime/gemm.hpp"
+#include "loc/runtime/matrix.hpp"
+#include "loc/runtime/registry.hpp"
+#include "loc/runtime/simd.hpp"
+#include "loc/runtime/sparse.hpp"
+#include "loc/runtime/thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// ---------- Harness ----------
+
+// Benchmarks time only what lies between start() and stop(); setup that
+// must be redone per iteration (e.g. copying a graph a pass rewrites) goes
+// outside.
+class Timer {
+public:
+    void start() { t0_ = Clock::now(); }
+    void stop() { elapsed_ += std::chrono::duration<double>(Clock::now() - t0_).count(); }
+    double seconds() const { return elapsed_; }
+
+private:
+    Clock::time_point t0_;
+    double elapsed_ = 0.0;
+};
+
+// Per-entry margins (no --tolerance): a multiple of the run-to-run spread
+// the baseline recorded, so a noisy benchmark gets room and a steady one
+// stays tight, within these bounds.
+constexpr double kSpreadMargins = 3.0;
+constexpr double kMinTolerance = 0.3;
+constexpr double kMaxTolerance = 0.75;
+
+struct Benchmark {
+    std::string name;
+    std::function<void(Timer&)> iteration;
+    double flops = 0.0;   // per iteration (0 = not reported)
+    double bytes = 0.0;   // per iteration (0 = not reported)
+    bool large = false;   // skipped with --quick
+    std::map<std::string, double> counters;
+};
+
+struct Result {
+    std::string name;
+    std::size_t iterations = 0; // per repetition
+    double median_ns = 0.0;     // per iteration
+    double min_ns = 0.0;
+    double gflops = 0.0;        // at the median
+    double gbytes = 0.0;
+    double calibration_ns = 0.0; // timed just before it
+    double spread = 0.0;         // slowest run over the median one, minus 1 (--runs)
+    std::map<std::string, double> counters;
+};
+
+struct Options {
+    std::string filter;
+    bool quick = false;
+    double min_time = 0.2;
+    int repetitions = 5;
+    int runs = 1;
+    std::string json, baseline;
+    double tolerance = -1.0; // < 0: per entry, from the baseline's spread
+};
+
+Result run_benchmark(const Benchmark& b, const Options& opt) {
+    // Warm-up, and a first estimate of the iteration time
+    Timer warm;
+    b.iteration(warm);
+    const double per_iter = std::max(warm.seconds(), 1e-9);
+    const std::size_t iters = std::max<std::size_t>(1, (std::size_t)(opt.min_time / per_iter));
+
+    std::vector<double> ns;
+    for (int r = 0; r < opt.repetitions; ++r) {
+        Timer t;
+        for (std::size_t i = 0; i < iters; ++i) b.iteration(t);
+        ns.push_back(t.seconds() * 1e9 / (double)iters);
+    }
+    std::sort(ns.begin(), ns.end());
+
+    Result res;
+    res.name = b.name;
+    res.iterations = iters;
+    res.median_ns = ns[ns.size() / 2];
+    res.min_ns = ns.front();
+    res.gflops = b.flops > 0 ? b.flops / res.median_ns : 0.0;
+    res.gbytes = b.bytes > 0 ? b.bytes / res.median_ns : 0.0;
+    res.counters = b.counters;
+    return res;
+}
+
+// The calibration workload: a small GEMM on the naive loop (scalar code,
+// independent of --simd and of the kernels under test) and a sweep over a
+// buffer larger than most L2s, so it tracks both core speed and memory
+// bandwidth. It takes a few milliseconds per iteration.
+Benchmark calibration_benchmark() {
+    constexpr std::size_t n = 96, sweep = std::size_t(1) << 22; // 32 MiB
+    auto a = std::make_shared<std::vector<double>>(n * n, 0.5);
+    auto c = std::make_shared<std::vector<double>>(n * n);
+    auto buf = std::make_shared<std::vector<double>>(sweep, 1.0);
+    Benchmark b;
+    b.name = "calibration";
+    b.iteration = [a, c, buf](Timer& t) {
+        t.start();
+        loc::rt::gemm_naive(n, n, n, 1.0, a->data(), n, a->data(), n, 0.0, c->data(), n);
+        double sum = 0.0;
+        for (double v : *buf) sum += v;
+        (*c)[0] += sum;
+        t.stop();
+    };
+    return b;
+}
+
+// Per-iteration time of the calibration workload, the median of a few
+// samples of several iterations each: samples long enough to span the
+// time slices of a shared CPU, so a busy host reads as slower.
+double calibrate(const Benchmark& cal) {
+    constexpr int kSamples = 3, kIters = 4;
+    Timer warm;
+    cal.iteration(warm);
+    std::vector<double> ns;
+    for (int r = 0; r < kSamples; ++r) {
+        Timer t;
+        for (int i = 0; i < kIters; ++i) cal.iteration(t);
+        ns.push_back(t.seconds() * 1e9 / kIters);
+    }
+    std::sort(ns.begin(), ns.end());
+    return ns[ns.size() / 2];
+}
+
+// Time in units of the calibration timed next to it.
+double calibrated(const Result& r) {
+    return r.calibration_ns > 0 ? r.median_ns / r.calibration_ns : r.median_ns;
+}
+
+// One result standing for several runs of a benchmark: the run with the
+// median calibrated time, with the slowest run's excess over it as spread.
+Result combine_runs(std::vector<Result> runs) {
+    std::sort(runs.begin(), runs.end(),
+              [](const Result& a, const Result& b) { return calibrated(a) < calibrated(b); });
+    Result r = runs[runs.size() / 2];
+    r.spread = calibrated(runs.back()) / calibrated(r) - 1.0;
+    return r;
+}
+
+std::string format_time(double ns) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3);
+    if (ns < 1e3) oss << ns << " ns";
+    else if (ns < 1e6) oss << ns / 1e3 << " us";
+    else if (ns < 1e9) oss << ns / 1e6 << " ms";
+    else oss << ns / 1e9 << " s";
+    return oss.str();
+}
+
+void write_json(std::ostream& os, const std::vector<Result>& results, const Options& opt) {
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    os << "{\n  \"context\": {\"date\": \"" << date << "\""
+       << ", \"threads\": " << loc::rt::global_pool().size()
+       << ", \"simd\": \"" << loc::rt::simd::isa_name(loc::rt::simd::active_isa()) << "\""
+       << ", \"quick\": " << (opt.quick ? "true" : "false")
+       << ", \"min_time\": " << opt.min_time
+       << ", \"repetitions\": " << opt.repetitions << ", \"runs\": " << opt.runs << "},\n  \"benchmarks\": [";
+    os << std::setprecision(17);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        os << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\""
+           << ", \"iterations\": " << r.iterations
+           << ", \"median_ns\": " << r.median_ns << ", \"min_ns\": " << r.min_ns
+           << ", \"calibration_ns\": " << r.calibration_ns << ", \"spread\": " << r.spread;
+        if (r.gflops > 0) os << ", \"gflops\": " << r.gflops;
+        if (r.gbytes > 0) os << ", \"gbytes_per_s\": " << r.gbytes;
+        for (const auto& [k, v] : r.counters) os << ", \"" << k << "\": " << v;
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+struct BaselineEntry {
+    double median_ns = 0.0;
+    double calibration_ns = 0.0; // 0: not recorded
+    double spread = 0.0;         // 0: not recorded (or steady)
+};
+
+// Reads name -> entry from a file written by write_json. Only that layout
+// is supported: one benchmark object per line.
+std::map<std::string, BaselineEntry> read_baseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("could not open baseline " + path);
+
+    std::map<std::string, BaselineEntry> out;
+    std::string line;
+    while (std::getline(in, line)) {
+        const auto n = line.find("\"name\": \"");
+        const auto m = line.find("\"median_ns\": ");
+        if (n == std::string::npos || m == std::string::npos) continue;
+        const auto start = n + 9;
+        BaselineEntry& e = out[line.substr(start, line.find('"', start) - start)];
+        e.median_ns = std::strtod(line.c_str() + m + 13, nullptr);
+        const auto cal = line.find("\"calibration_ns\": ");
+        if (cal != std::string::npos) e.calibration_ns = std::strtod(line.c_str() + cal + 18, nullptr);
+        const auto sp = line.find("\"spread\": ");
+        if (sp != std::string::npos) e.spread = std::strtod(line.c_str() + sp + 10, nullptr);
+    }
+    return out;
+}
+
+// The baseline time scaled by r's calibration over the baseline's
+double expected_ns(const Result& r, const BaselineEntry& e) {
+    const double scale = e.calibration_ns > 0 && r.calibration_ns > 0
+        ? r.calibration_ns / e.calibration_ns : 1.0;
+    return e.median_ns * scale;
+}
+
+// --tolerance if given (>= 0), else the entry's own margin.
+double margin(const BaselineEntry& e, double tolerance) {
+    if (tolerance >= 0) return tolerance;
+    return std::clamp(kSpreadMargins * e.spread, kMinTolerance, kMaxTolerance);
+}
+
+bool regressed(const Result& r, const BaselineEntry& e, double tolerance) {
+    return r.median_ns > expected_ns(r, e) * (1.0 + margin(e, tolerance));
+}
+
+// Prints the comparison; returns the number of regressions. Each baseline
+// time is first scaled by this run's calibration over the baseline's (the
+// `cal` column).
+int compare(const std::vector<Result>& results, const std::map<std::string, BaselineEntry>& base,
+            double tolerance) {
+    int regressions = 0;
+    std::cout << "\n=== Against baseline (";
+    if (tolerance >= 0) std::cout << "tolerance " << tolerance * 100 << "%";
+    else std::cout << "per-entry margins";
+    std::cout << ") ===\n"
+              << std::left << std::setw(36) << "benchmark" << std::right << std::setw(14) << "expected"
+              << "    " << std::setw(14) << "time" << std::setw(9) << "ratio" << std::setw(8) << "cal"
+              << std::setw(8) << "margin" << "\n";
+    for (const Result& r : results) {
+        auto it = base.find(r.name);
+        std::cout << std::left << std::setw(36) << r.name << std::right;
+        if (it == base.end() || it->second.median_ns <= 0) {
+            std::cout << "  (no baseline)\n";
+            continue;
+        }
+        const double expected = expected_ns(r, it->second);
+        std::cout << std::setw(14) << format_time(expected) << " -> " << std::setw(14)
+                  << format_time(r.median_ns) << std::fixed << std::setprecision(2)
+                  << std::setw(8) << r.median_ns / expected << "x"
+                  << std::setw(7) << expected / it->second.median_ns << "x"
+                  << std::setw(7) << std::setprecision(0) << margin(it->second, tolerance) * 100 << "%";
+        if (regressed(r, it->second, tolerance)) {
+            std::cout << "  REGRESSION";
+            ++regressions;
+        }
+        std::cout << "\n";
+    }
+    return regressions;
+}
+
+// ---------- Workloads ----------
+
+loc::rt::Matrix random_matrix(std::size_t r, std::size_t c, double scale, std::uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> d(-scale, scale);
+    loc::rt::Matrix m(r, c);
+    for (std::size_t i = 0; i < r; ++i)
+        for (std::size_t j = 0; j < c; ++j) m(i, j) = d(rng);
+    return m;
+}
+
+loc::ast::NodePtr ident(const std::string& name) {
+    return std::make_unique<loc::ast::IdentExpr>(name);
+}
+
+// A straight-line program of about `nodes` IR nodes: statements of depth
+// 50 built from +, @ and scalar *, each reading the previous live result;
+// one statement in four is dead (nothing reads it), for DCE to drop.
+loc::ast::Program generate_program(std::size_t nodes, std::uint32_t seed) {
+    constexpr int kDepth = 50;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> op(0, 9), leaf(0, 2);
+    const double scalars[] = {0.5, 0.25, 2.0};
+
+    loc::ast::Program prog;
+    for (const char* name : {"A", "B"}) {
+        loc::ast::MatrixLiteral lit;
+        lit.rows = lit.cols = 2;
+        lit.values = {0.5, 0.1, 0.2, 0.3};
+        prog.statements.push_back(std::make_unique<loc::ast::OperatorDecl>(name, lit));
+    }
+
+    std::string live = "A";
+    const std::size_t stmts = std::max<std::size_t>(2, nodes / kDepth);
+    for (std::size_t s = 0; s < stmts; ++s) {
+        loc::ast::NodePtr e = ident(live);
+        for (int d = 0; d < kDepth; ++d) {
+            const int r = op(rng);
+            if (r < 4) {
+                const int l = leaf(rng);
+                e = std::make_unique<loc::ast::AddExpr>(std::move(e), ident(l == 0 ? "A" : l == 1 ? "B" : live));
+            } else if (r < 7) {
+                e = std::make_unique<loc::ast::ComposeExpr>(std::move(e), ident("B"));
+            } else {
+                e = std::make_unique<loc::ast::ScalarMulExpr>(scalars[leaf(rng)], std::move(e));
+            }
+        }
+        const std::string name = "x" + std::to_string(s);
+        prog.statements.push_back(std::make_unique<loc::ast::AssignStmt>(name, std::move(e)));
+        if (s % 4 != 3) live = name;
+    }
+    prog.statements.push_back(std::make_unique<loc::ast::PrintStmt>(ident(live)));
+    return prog;
+}
+
+// IR over operators "A" and "B" (n x n). Deep: x <- x @ B + A, `depth`
+// times. Wide: `width` independent products A @ B_i, summed pairwise.
+loc::ir::Graph deep_dag(int depth) {
+    using loc::ir::Node;
+    using loc::ir::NodeKind;
+    loc::ir::Graph g;
+    Node a; a.kind = NodeKind::Op; a.name = "A";
+    Node b; b.kind = NodeKind::Op; b.name = "B";
+    const int ia = g.add_node(a), ib = g.add_node(b);
+    int x = ia;
+    for (int i = 0; i < depth; ++i) {
+        Node p; p.kind = NodeKind::Compose; p.inputs = {x, ib};
+        Node s; s.kind = NodeKind::Add; s.inputs = {g.add_node(p), ia};
+        x = g.add_node(s);
+    }
+    loc::ir::Graph::Stmt st;
+    st.kind = loc::ir::Graph::Stmt::Kind::Assign;
+    st.name = "out";
+    st.value = x;
+    g.program.push_back(st);
+    return g;
+}
+
+loc::ir::Graph wide_dag(int width) {
+    using loc::ir::Node;
+    using loc::ir::NodeKind;
+    loc::ir::Graph g;
+    Node a; a.kind = NodeKind::Op; a.name = "A";
+    const int ia = g.add_node(a);
+    std::vector<int> level;
+    for (int i = 0; i < width; ++i) {
+        Node b; b.kind = NodeKind::Op; b.name = "B" + std::to_string(i);
+        Node p; p.kind = NodeKind::Compose; p.inputs = {ia, g.add_node(b)};
+        level.push_back(g.add_node(p));
+    }
+    while (level.size() > 1) {
+        std::vector<int> next;
+        for (std::size_t i = 0; i + 1 < level.size(); i += 2) {
+            Node s; s.kind = NodeKind::Add; s.inputs = {level[i], level[i + 1]};
+            next.push_back(g.add_node(s));
+        }
+        if (level.size() % 2) next.push_back(level.back());
+        level = std::move(next);
+    }
+    loc::ir::Graph::Stmt st;
+    st.kind = loc::ir::Graph::Stmt::Kind::Assign;
+    st.name = "out";
+    st.value = level[0];
+    g.program.push_back(st);
+    return g;
+}
+
+// ---------- Benchmarks ----------
+
+void add_kernel_benchmarks(std::vector<Benchmark>& out) {
+    for (std::size_t n : {64, 128, 256, 512, 1024}) {
+        auto a = std::make_shared<loc::rt::Matrix>(random_matrix(n, n, 1.0, 1));
+        auto b = std::make_shared<loc::rt::Matrix>(random_matrix(n, n, 1.0, 2));
+        Benchmark bm;
+        bm.name = "matmul/" + std::to_string(n);
+        bm.iteration = [a, b](Timer& t) {
+            t.start();
+            loc::rt::Matrix c = a->matmul(*b);
+            t.stop();
+        };
+        bm.flops = 2.0 * n * n * n;
+        bm.large = n >= 1024;
+        out.push_back(std::move(bm));
+    }
+
+    // A' @ B and A @ B' read the transposed factor in place (Trans flags)
+    for (auto [ta, tb] : {std::pair<bool, bool>{true, false}, {false, true}}) {
+        const std::size_t n = 256;
+        auto a = std::make_shared<loc::rt::Matrix>(random_matrix(n, n, 1.0, 1));
+        auto b = std::make_shared<loc::rt::Matrix>(random_matrix(n, n, 1.0, 2));
+        Benchmark bm;
+        bm.name = std::string(ta ? "matmul_tn/" : "matmul_nt/") + std::to_string(n);
+        bm.iteration = [a, b, ta = ta, tb = tb, n](Timer& t) {
+            loc::rt::Matrix c = loc::rt::Matrix::uninitialized(n, n);
+            t.start();
+            gemm_into(1.0, *a, ta, *b, tb, 0.0, nullptr, c);
+            t.stop();
+        };
+        bm.flops = 2.0 * n * n * n;
+        out.push_back(std::move(bm));
+    }
+
+    // --precision=f32 / mixed: float operands, summed in float or in double
+    for (bool wide : {false, true}) {
+        const std::size_t n = 256;
+        auto a = std::make_shared<loc::rt::MatrixF32>(loc::rt::to_f32(random_matrix(n, n, 1.0, 1)));
+        auto b = std::make_shared<loc::rt::MatrixF32>(loc::rt::to_f32(random_matrix(n, n, 1.0, 2)));
+        Benchmark bm;
+        bm.name = std::string(wide ? "matmul_mixed/" : "matmul_f32/") + std::to_string(n);
+        bm.iteration = [a, b, wide, n](Timer& t) {
+            loc::rt::MatrixF32 c = loc::rt::MatrixF32::uninitialized(n, n);
+            t.start();
+            loc::rt::gemm(loc::rt::Trans::N, loc::rt::Trans::N, n, n, n, 1.0, a->data(), n, b->data(), n,
+                          0.0, c.data(), n, c.data(), n, wide);
+            t.stop();
+        };
+        bm.flops = 2.0 * n * n * n;
+        out.push_back(std::move(bm));
+    }
+
+    // a^k by repeated squaring (what a Pow node runs)
+    for (auto [n, k] : {std::pair<std::size_t, std::uint64_t>{128, 64}, {256, 100}}) {
+        auto a = std::make_shared<loc::rt::Matrix>(random_matrix(n, n, 1.0 / n, 11)); // keeps a^k bounded
+        Benchmark bm;
+        bm.name = "power/" + std::to_string(n) + "/" + std::to_string(k);
+        bm.iteration = [a, k = k](Timer& t) {
+            t.start();
+            loc::rt::Matrix c = power(*a, k);
+            t.stop();
+        };
+        bm.flops = 2.0 * n * n * n * loc::ir::pow_products(k);
+        out.push_back(std::move(bm));
+    }
+
+    // The output is allocated once: at 2048 it is 32 MiB, right at glibc's
+    // mmap threshold, so allocating it per iteration makes the time swing
+    // between runs with the allocator's state rather than the kernel's.
+    for (std::size_t n : {256, 1024, 2048}) {
+        auto a = std::make_shared<loc::rt::Matrix>(random_matrix(n, n, 1.0, 3));
+        auto b = std::make_shared<loc::rt::Matrix>(random_matrix(n, n, 1.0, 4));
+        auto c = std::make_shared<loc::rt::Matrix>(n, n);
+        Benchmark add;
+        add.name = "add/" + std::to_string(n);
+        add.iteration = [a, b, c](Timer& t) {
+            t.start();
+            loc::rt::add_into(*a, *b, *c);
+            t.stop();
+        };
+        add.flops = (double)n * n;
+        add.bytes = 3.0 * n * n * sizeof(double);
+        out.push_back(std::move(add));
+
+        Benchmark scale;
+        scale.name = "scale/" + std::to_string(n);
+        scale.iteration = [a, c](Timer& t) {
+            t.start();
+            loc::rt::scale_into(0.5, *a, *c);
+            t.stop();
+        };
+        scale.flops = (double)n * n;
+        scale.bytes = 2.0 * n * n * sizeof(double);
+        out.push_back(std::move(scale));
+    }
+}
+
+void add_executor_benchmarks(std::vector<Benchmark>& out) {
+    using Schedule = loc::rt::Executor::Schedule;
+    const std::pair<const char*, Schedule> schedules[] = {
+        {"serial", Schedule::Serial}, {"planned", Schedule::Planned}, {"parallel", Schedule::Parallel}};
+
+    // Deep: 256 dependent 64x64 products, nothing to overlap
+    {
+        constexpr std::size_t n = 64;
+        constexpr int depth = 256;
+        auto reg = std::make_shared<loc::rt::Registry>();
+        reg->set("A", random_matrix(n, n, 1.0, 5));
+        reg->set("B", random_matrix(n, n, 1.0 / n, 6)); // keeps x bounded
+        auto g = std::make_shared<loc::ir::Graph>(deep_dag(depth));
+        for (const auto& [label, sched] : schedules) {
+            auto ex = std::make_shared<loc::rt::Executor>(*reg);
+            ex->schedule = sched;
+            Benchmark bm;
+            bm.name = std::string("executor/deep") + std::to_string(depth) + "/" + label;
+            bm.iteration = [reg, g, ex](Timer& t) {
+                t.start();
+                ex->run(*g);
+                t.stop();
+            };
+            bm.flops = depth * (2.0 * n * n * n + (double)n * n);
+            bm.counters["nodes"] = (double)g->nodes.size();
+            out.push_back(std::move(bm));
+        }
+
+        // The same operator applied to a block of 8 vectors, never formed
+        constexpr std::size_t k = 8;
+        auto x = std::make_shared<loc::rt::Matrix>(random_matrix(n, k, 1.0, 4));
+        auto ex = std::make_shared<loc::rt::Executor>(*reg);
+        Benchmark bm;
+        bm.name = std::string("executor/deep") + std::to_string(depth) + "/apply";
+        bm.iteration = [reg, g, ex, x](Timer& t) {
+            t.start();
+            loc::rt::Matrix y = ex->apply(*g, "out", *x);
+            t.stop();
+        };
+        bm.flops = depth * (4.0 * n * n * k + (double)n * k); // B @ v and A @ v per level
+        bm.counters["nodes"] = (double)g->nodes.size();
+        out.push_back(std::move(bm));
+    }
+
+    // Wide: 64 independent 128x128 products, then a sum tree
+    {
+        constexpr std::size_t n = 128;
+        constexpr int width = 64;
+        auto reg = std::make_shared<loc::rt::Registry>();
+        reg->set("A", random_matrix(n, n, 1.0, 7));
+        for (int i = 0; i < width; ++i) reg->set("B" + std::to_string(i), random_matrix(n, n, 1.0, 8 + i));
+        auto g = std::make_shared<loc::ir::Graph>(wide_dag(width));
+        for (const auto& [label, sched] : schedules) {
+            auto ex = std::make_shared<loc::rt::Executor>(*reg);
+            ex->schedule = sched;
+            Benchmark bm;
+            bm.name = std::string("executor/wide") + std::to_string(width) + "/" + label;
+            bm.iteration = [reg, g, ex](Timer& t) {
+                t.start();
+                ex->run(*g);
+                t.stop();
+            };
+            bm.flops = width * 2.0 * n * n * n + (width - 1.0) * n * n;
+            bm.counters["nodes"] = (double)g->nodes.size();
+            out.push_back(std::move(bm));
+        }
+    }
+}
+
+// 5-point Laplacian on a g x g grid: n = g^2 rows, <= 5 nonzeros each.
+loc::rt::SparseMatrix laplacian_2d(std::size_t g) {
+    using SM = loc::rt::SparseMatrix;
+    const std::size_t n = g * g;
+    SM::Array<std::size_t> row_ptr(n + 1, 0);
+    SM::Array<SM::Index> cols;
+    SM::Array<double> vals;
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::size_t x = i % g, y = i / g;
+        auto put = [&](std::size_t j, double v) {
+            cols.push_back((SM::Index)j);
+            vals.push_back(v);
+        };
+        if (y > 0) put(i - g, -1.0);
+        if (x > 0) put(i - 1, -1.0);
+        put(i, 4.0);
+        if (x + 1 < g) put(i + 1, -1.0);
+        if (y + 1 < g) put(i + g, -1.0);
+        row_ptr[i + 1] = vals.size();
+    }
+    return SM(n, n, std::move(row_ptr), std::move(cols), std::move(vals));
+}
+
+void add_sparse_benchmarks(std::vector<Benchmark>& out) {
+    for (std::size_t g : {64, 256, 512}) {
+        auto l = std::make_shared<const loc::rt::SparseMatrix>(laplacian_2d(g));
+        const std::size_t n = g * g, nnz = l->nnz();
+        const std::string size = std::to_string(n);
+
+        auto x = std::make_shared<loc::rt::Matrix>(random_matrix(n, 8, 1.0, 9));
+        Benchmark spmm;
+        spmm.name = "sparse/spmm/" + size;
+        spmm.iteration = [l, x](Timer& t) {
+            loc::rt::Matrix y = loc::rt::Matrix::uninitialized(l->rows(), x->cols());
+            t.start();
+            loc::rt::spmm_into(1.0, *l, *x, 0.0, nullptr, y);
+            t.stop();
+        };
+        spmm.flops = 2.0 * nnz * 8;
+        spmm.bytes = nnz * (sizeof(double) + sizeof(std::uint32_t)) + 2.0 * n * 8 * sizeof(double);
+        spmm.large = g >= 512;
+        out.push_back(std::move(spmm));
+
+        Benchmark spgemm;
+        spgemm.name = "sparse/spgemm/" + size;
+        spgemm.iteration = [l](Timer& t) {
+            t.start();
+            loc::rt::SparseMatrix p = loc::rt::spgemm(1.0, *l, *l);
+            t.stop();
+        };
+        spgemm.flops = 2.0 * nnz * 5; // <= 5 nonzeros per row of l
+        spgemm.large = g >= 512;
+        out.push_back(std::move(spgemm));
+
+        Benchmark add;
+        add.name = "sparse/add/" + size;
+        add.iteration = [l](Timer& t) {
+            t.start();
+            loc::rt::SparseMatrix s = loc::rt::sparse_lincomb({1.0, 2.0}, {l.get(), l.get()});
+            t.stop();
+        };
+        add.flops = 2.0 * nnz;
+        add.large = g >= 512;
+        out.push_back(std::move(add));
+    }
+}
+
+void add_pass_benchmarks(std::vector<Benchmark>& out) {
+    for (std::size_t size : {100, 1000, 10000, 100000, 1000000}) {
+        auto prog = std::make_shared<loc::ast::Program>(generate_program(size, 42));
+        auto lowered = std::make_shared<loc::ir::Graph>(loc::ir::lower_program(*prog));
+        auto folded = std::make_shared<loc::ir::Graph>(*lowered);
+        loc::ir::passes::const_fold(*folded);
+        const std::string n = std::to_string(size);
+        const bool large = size >= 1000000;
+
+        Benchmark lower;
+        lower.name = "pass/lower/" + n;
+        lower.iteration = [prog](Timer& t) {
+            t.start();
+            loc::ir::Graph g = loc::ir::lower_program(*prog);
+            t.stop();
+        };
+        lower.counters["nodes"] = (double)lowered->nodes.size();
+        lower.large = large;
+        out.push_back(std::move(lower));
+
+        Benchmark fold;
+        fold.name = "pass/const_fold/" + n;
+        fold.iteration = [lowered](Timer& t) {
+            loc::ir::Graph g = *lowered;
+            t.start();
+            loc::ir::passes::const_fold(g);
+            t.stop();
+        };
+        fold.counters["nodes"] = (double)lowered->nodes.size();
+        fold.large = large;
+        out.push_back(std::move(fold));
+
+        Benchmark dce;
+        dce.name = "pass/dce/" + n;
+        dce.iteration = [folded](Timer& t) {
+            loc::ir::Graph g = *folded;
+            t.start();
+            loc::ir::passes::dead_code_elim(g);
+            t.stop();
+        };
+        dce.counters["nodes"] = (double)folded->nodes.size();
+        dce.large = large;
+        out.push_back(std::move(dce));
+
+        // Decoding a serialized graph: what a program cache hit does instead
+        // of lowering and the passes
+        auto bytes = std::make_shared<std::string>();
+        loc::ir::ByteWriter w(*bytes);
+        loc::ir::write_graph(w, *folded);
+        Benchmark read;
+        read.name = "pass/ir_read/" + n;
+        read.iteration = [bytes](Timer& t) {
+            t.start();
+            loc::ir::ByteReader r(bytes->data(), bytes->size());
+            loc::ir::Graph g = loc::ir::read_graph(r);
+            t.stop();
+        };
+        read.counters["nodes"] = (double)folded->nodes.size();
+        read.counters["bytes"] = (double)bytes->size();
+        read.large = large;
+        out.push_back(std::move(read));
+    }
+}
+
+std::string rate(double v) {
+    if (v <= 0) return "-";
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2) << v;
+    return oss.str();
+}
+
+bool parse_double(const std::string& s, double& out) {
+    char* end = nullptr;
+    out = std::strtod(s.c_str(), &end);
+    return !s.empty() && *end == '\0';
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        double v = 0.0;
+        loc::rt::simd::Isa isa;
+        if (arg.rfind("--filter=", 0) == 0) {
+            opt.filter = arg.substr(9);
+        } else if (arg == "--quick") {
+            opt.quick = true;
+            opt.min_time = 0.05;
+            opt.repetitions = 3;
+        } else if (arg.rfind("--min-time=", 0) == 0 && parse_double(arg.substr(11), v) && v > 0) {
+            opt.min_time = v;
+        } else if (arg.rfind("--repetitions=", 0) == 0 && parse_double(arg.substr(14), v) && v >= 1) {
+            opt.repetitions = (int)v;
+        } else if (arg.rfind("--runs=", 0) == 0 && parse_double(arg.substr(7), v) && v >= 1 && v <= 100) {
+            opt.runs = (int)v;
+        } else if (arg.rfind("--threads=", 0) == 0 && parse_double(arg.substr(10), v) && v >= 1 &&
+                   v <= (double)loc::rt::max_num_threads()) {
+            loc::rt::set_num_threads((std::size_t)v);
+        } else if (arg.rfind("--simd=", 0) == 0 && loc::rt::simd::parse_isa(arg.substr(7), isa)) {
+            loc::rt::simd::set_isa(isa);
+        } else if (arg.rfind("--json=", 0) == 0) {
+            opt.json = arg.substr(7);
+        } else if (arg.rfind("--baseline=", 0) == 0) {
+            opt.baseline = arg.substr(11);
+        } else if (arg.rfind("--tolerance=", 0) == 0 && parse_double(arg.substr(12), v) && v >= 0) {
+            opt.tolerance = v;
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--filter=S] [--quick] [--min-time=SEC] [--repetitions=N] [--runs=N]\n"
+                         "       [--threads=N] [--simd=ISA] [--json=FILE] [--baseline=FILE] [--tolerance=F]\n";
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    try {
+        // Workloads are built lazily per group, so --filter skips their setup
+        std::vector<Benchmark> all;
+        const std::pair<const char*, void (*)(std::vector<Benchmark>&)> groups[] = {
+            {"matmul power add scale", add_kernel_benchmarks},
+            {"executor", add_executor_benchmarks},
+            {"sparse", add_sparse_benchmarks},
+            {"pass", add_pass_benchmarks},
+        };
+        for (const auto& [prefixes, add] : groups) {
+            std::istringstream ps(prefixes);
+            std::string p;
+            bool wanted = opt.filter.empty();
+            while (!wanted && ps >> p) {
+                wanted = opt.filter.find(p) != std::string::npos || p.find(opt.filter) != std::string::npos;
+            }
+            if (wanted) add(all);
+        }
+
+        const Benchmark calibration = calibration_benchmark();
+        auto measure = [&](const Benchmark& b) {
+            const double calibration_ns = calibrate(calibration);
+            Result r = run_benchmark(b, opt);
+            r.calibration_ns = calibration_ns;
+            return r;
+        };
+
+        std::vector<const Benchmark*> ran;
+        for (const Benchmark& b : all) {
+            if (!opt.filter.empty() && b.name.find(opt.filter) == std::string::npos) continue;
+            if (opt.quick && b.large) continue;
+            ran.push_back(&b);
+        }
+
+        // Each run measures the whole suite, so the runs of one benchmark
+        // are spread over the suite's time rather than back to back
+        std::vector<std::vector<Result>> runs(ran.size());
+        for (int k = 0; k < opt.runs; ++k) {
+            if (opt.runs > 1) std::cout << "--- run " << k + 1 << " of " << opt.runs << " ---\n";
+            std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(14) << "time"
+                      << std::setw(12) << "iters" << std::setw(10) << "GFLOP/s" << std::setw(8) << "GB/s" << "\n";
+            for (std::size_t i = 0; i < ran.size(); ++i) {
+                Result r = measure(*ran[i]);
+                std::cout << std::left << std::setw(36) << r.name << std::right
+                          << std::setw(14) << format_time(r.median_ns) << std::setw(12) << r.iterations
+                          << std::setw(10) << rate(r.gflops) << std::setw(8) << rate(r.gbytes) << "\n"
+                          << std::flush;
+                runs[i].push_back(std::move(r));
+            }
+        }
+        std::vector<Result> results;
+        for (auto& rs : runs) results.push_back(combine_runs(std::move(rs)));
+
+        if (!opt.json.empty()) {
+            std::ofstream out(opt.json);
+            if (!out) throw std::runtime_error("could not write " + opt.json);
+            write_json(out, results, opt);
+        }
+        if (!opt.baseline.empty()) {
+            const auto base = read_baseline(opt.baseline);
+            // A benchmark over its margin is measured once more and counts
+            // only if that run is over it too, so one slow moment on a
+            // shared host doesn't fail the check
+            for (std::size_t i = 0; i < results.size(); ++i) {
+                auto it = base.find(results[i].name);
+                if (it == base.end() || !regressed(results[i], it->second, opt.tolerance)) continue;
+                Result again = measure(*ran[i]);
+                if (again.median_ns / expected_ns(again, it->second) <
+                    results[i].median_ns / expected_ns(results[i], it->second)) {
+                    results[i] = std::move(again);
+                }
+            }
+            const int regressions = compare(results, base, opt.tolerance);
+            if (regressions) {
+                std::cout << regressions << " regression(s)\n";
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "loc_bench: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <optional>
 
+#include "loc/runtime/matrix.hpp"
+
 namespace loc::ast {
 
 // -----------------------------
@@ -28,8 +31,12 @@ inline void indent(int n) {
 // -----------------------------
 // Matrix literal (for operator init)
 // -----------------------------
+// Row-major elements in one buffer, already in the runtime's storage type
+// so the registry adopts it without a copy. The parser checks that every
+// row is as long as the first.
 struct MatrixLiteral {
-    std::vector<std::vector<double>> rows; // must be rectangular
+    std::size_t rows = 0, cols = 0;
+    loc::rt::MatrixStorage values; // rows * cols elements
 };
 
 // -----------------------------
@@ -96,16 +103,64 @@ struct ComposeExpr : Expr {
     }
 };
 
+// Expr ^ k   (matrix power, k a non-negative integer)
+struct PowExpr : Expr {
+    NodePtr base;
+    std::uint64_t exponent;
+
+    PowExpr(NodePtr b, std::uint64_t k)
+        : base(std::move(b)), exponent(k) {}
+
+    void dump(int indent_lvl = 0) const override {
+        indent(indent_lvl);
+        std::cout << "Pow(" << exponent << ")\n";
+        base->dump(indent_lvl + 1);
+    }
+};
+
+// Expr'  or  transpose(Expr)
+struct TransposeExpr : Expr {
+    NodePtr expr;
+
+    explicit TransposeExpr(NodePtr e) : expr(std::move(e)) {}
+
+    void dump(int indent_lvl = 0) const override {
+        indent(indent_lvl);
+        std::cout << "Transpose\n";
+        expr->dump(indent_lvl + 1);
+    }
+};
+
+// apply(Expr, Expr)   (operator applied to a block of vectors, matrix-free)
+struct ApplyExpr : Expr {
+    NodePtr op;
+    NodePtr x;
+
+    ApplyExpr(NodePtr o, NodePtr v)
+        : op(std::move(o)), x(std::move(v)) {}
+
+    void dump(int indent_lvl = 0) const override {
+        indent(indent_lvl);
+        std::cout << "Apply\n";
+        op->dump(indent_lvl + 1);
+        x->dump(indent_lvl + 1);
+    }
+};
+
 // -----------------------------
 // Statements
 // -----------------------------
-struct Stmt : Node {};
+struct Stmt : Node {
+    int line = 0; // source line the statement ends on (0 = unknown)
+};
 
 // operator D;
 // operator D = [[0,1],[-1,0]];
+// operator D = load("d.bin");
 struct OperatorDecl : Stmt {
     std::string name;
     std::optional<MatrixLiteral> init; // NEW
+    std::optional<std::string> path;   // binary file to map (see matrix_file.hpp)
 
     explicit OperatorDecl(std::string n)
         : name(std::move(n)) {}
@@ -113,23 +168,30 @@ struct OperatorDecl : Stmt {
     OperatorDecl(std::string n, MatrixLiteral m)
         : name(std::move(n)), init(std::move(m)) {}
 
+    static std::unique_ptr<OperatorDecl> load(std::string n, std::string file) {
+        auto od = std::make_unique<OperatorDecl>(std::move(n));
+        od->path = std::move(file);
+        return od;
+    }
+
     void dump(int indent_lvl = 0) const override {
         indent(indent_lvl);
         std::cout << "OperatorDecl(" << name << ")";
 
         if (init) {
             std::cout << " = [";
-            for (size_t i = 0; i < init->rows.size(); ++i) {
+            for (size_t i = 0; i < init->rows; ++i) {
                 std::cout << "[";
-                for (size_t j = 0; j < init->rows[i].size(); ++j) {
-                    std::cout << init->rows[i][j];
-                    if (j + 1 < init->rows[i].size()) std::cout << ", ";
+                for (size_t j = 0; j < init->cols; ++j) {
+                    std::cout << init->values[i * init->cols + j];
+                    if (j + 1 < init->cols) std::cout << ", ";
                 }
                 std::cout << "]";
-                if (i + 1 < init->rows.size()) std::cout << ", ";
+                if (i + 1 < init->rows) std::cout << ", ";
             }
             std::cout << "]";
         }
+        if (path) std::cout << " = load(\"" << *path << "\")";
 
         std::cout << "\n";
     }
@@ -1,5 +1,8 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 
@@ -9,37 +12,205 @@ enum class NodeKind {
     Op,
     ScalarMul,
     Add,
-    Compose
+    Compose,
+    LinComb,  // sum_i coeffs[i] * inputs[i], fused elementwise (see fusion.hpp)
+    Gemm,     // alpha * (inputs[0] @ inputs[1]) [+ beta * inputs[2]] (see gemm_epilogue.hpp)
+    Zero,     // all-zero rows x cols, no inputs (const_fold); the shape is its payload
+    Pow,      // inputs[0] ^ exponent, by repeated squaring (exponent 0: identity)
+    Transpose // inputs[0]' (gemm_epilogue turns transposed factors into trans_a / trans_b)
 };
 
+// What is known about an operator's matrix beyond its shape, detected when
+// it is registered (see loc/runtime/structure.hpp). Drives the algebraic
+// rewrites in const_fold; the executor picks kernels from the registry.
+enum class Structure {
+    Dense,
+    Zero,
+    Identity,
+    ScaledIdentity, // scale * I
+    Diagonal,
+    Permutation,    // one 1 per row and column
+    Sparse          // stored as CSR/CSC (loc/runtime/sparse.hpp); density in `scalar`
+};
+const char* structure_name(Structure s);
+
 struct Node {
     int id = -1;
     NodeKind kind = NodeKind::Op;
 
-    // Op fields
+    // Op fields (ScaledIdentity keeps its factor in `scalar`, Sparse its
+    // fraction of nonzeros)
     std::string name;
+    Structure structure = Structure::Dense;
 
     // ScalarMul fields
     double scalar = 0.0;
 
+    // LinComb fields (one coefficient per input)
+    std::vector<double> coeffs;
+
+    // Gemm fields (beta only applies with a third input)
+    double alpha = 1.0, beta = 0.0;
+
+    // Compose / Gemm: read inputs[0] / inputs[1] transposed (in place, by
+    // the GEMM kernel)
+    bool trans_a = false, trans_b = false;
+
+    // Pow fields
+    std::uint64_t exponent = 0;
+
     // DAG inputs
     std::vector<int> inputs;
+
+    // Inferred shape (0 x 0 = unknown); filled in by infer_shapes (lowering
+    // fills in what apply() needs to price powers, see lower.hpp).
+    std::size_t rows = 0, cols = 0;
+
+    // Source line of the statement that produced the node (0 = unknown).
+    int line = 0;
+
+    // Estimated multiply-adds to evaluate this node alone (Compose / Pow
+    // only; 0 = unknown). Filled in by chain_order, shown in dump().
+    std::uint64_t cost = 0;
 };
 
+// Structural identity used for hash-consing: kind, payload (Op name,
+// ScalarMul scalar, LinComb coeffs, Gemm alpha/beta, Zero shape, Pow
+// exponent, product transpose flags; doubles compared by bit pattern) and
+// input ids. Shape (other than Zero's), line, cost and operator structure
+// are derived facts and not part of it.
+std::uint64_t structural_hash(const Node& n);
+bool same_structure(const Node& a, const Node& b);
+
+// Matrix products x ^ k takes by binary exponentiation: floor(log2 k)
+// squarings, plus one product per further set bit of k.
+inline std::uint64_t pow_products(std::uint64_t k) {
+    std::uint64_t n = 0;
+    for (std::uint64_t b = k; b > 1; b >>= 1) n += 1 + (b & 1);
+    return n;
+}
+
+// Whether A^k x, for an n x n A and an n x m x, is cheaper as k products of
+// x's width (k n^2 m multiply-adds) than as A^k by repeated squaring and
+// one product (pow_products(k) n^3 + n^2 m): chain_order's cost model for
+// dense factors. Ties unroll, which forms nothing n x n.
+inline bool unroll_power_apply(std::uint64_t n, std::uint64_t m, std::uint64_t k) {
+    return (double)k * (double)m <= (double)pow_products(k) * (double)n + (double)m;
+}
+
+// Hash -> node id table for hash-consing: open addressing with linear
+// probing, power-of-two capacity, at most half full. Several ids may share
+// a hash; find() asks the caller which one (if any) matches.
+class InternTable {
+public:
+    void clear() {
+        ids_.clear();
+        hashes_.clear();
+        size_ = 0;
+    }
+
+    void reserve(std::size_t n) {
+        if (2 * n > ids_.size()) rehash(capacity_for(n));
+    }
+
+    void insert(std::uint64_t h, int id) {
+        if (2 * (size_ + 1) > ids_.size()) rehash(capacity_for(size_ + 1));
+        std::size_t i = h & (ids_.size() - 1);
+        while (ids_[i] >= 0) i = (i + 1) & (ids_.size() - 1);
+        hashes_[i] = h;
+        ids_[i] = id;
+        ++size_;
+    }
+
+    // First id stored under `h` for which match(id) holds, else -1.
+    template <class Match>
+    int find(std::uint64_t h, Match&& match) const {
+        if (ids_.empty()) return -1;
+        for (std::size_t i = h & (ids_.size() - 1); ids_[i] >= 0; i = (i + 1) & (ids_.size() - 1)) {
+            if (hashes_[i] == h && match(ids_[i])) return ids_[i];
+        }
+        return -1;
+    }
+
+private:
+    static std::size_t capacity_for(std::size_t n) {
+        std::size_t cap = 16;
+        while (cap < 2 * n) cap *= 2;
+        return cap;
+    }
+
+    void rehash(std::size_t cap) {
+        std::vector<std::uint64_t> hashes(cap);
+        std::vector<int> ids(cap, -1);
+        for (std::size_t j = 0; j < ids_.size(); ++j) {
+            if (ids_[j] < 0) continue;
+            std::size_t i = hashes_[j] & (cap - 1);
+            while (ids[i] >= 0) i = (i + 1) & (cap - 1);
+            hashes[i] = hashes_[j];
+            ids[i] = ids_[j];
+        }
+        hashes_ = std::move(hashes);
+        ids_ = std::move(ids);
+    }
+
+    std::vector<std::uint64_t> hashes_;
+    std::vector<int> ids_; // -1 = empty slot
+    std::size_t size_ = 0;
+};
+
+// Operator shapes known at compile time (from operator declarations),
+// with the structure of their values.
+struct Shape {
+    std::size_t rows = 0, cols = 0;
+    Structure structure = Structure::Dense;
+    double scale = 1.0; // ScaledIdentity factor; Sparse: fraction of nonzeros
+};
+using ShapeMap = std::unordered_map<std::string, Shape>;
+
 struct Graph {
     struct Stmt {
         enum class Kind { Assign, Print };
         Kind kind = Kind::Print;
         std::string name; // for Assign
         int value = -1;   // node id
+        int line = 0;     // source line (0 = unknown)
     };
 
     std::vector<Node> nodes;
     std::vector<Stmt> program;
 
+    // Hash-consing table: structural hash -> ids of nodes added with it.
+    // Entries are checked against the node's current contents, so a pass
+    // that rewrites nodes in place only loses sharing, never correctness;
+    // a pass that replaces `nodes` wholesale must call reindex().
+    InternTable interned;
+
+    // Rebuilds `interned` after `nodes` was replaced wholesale (renumbered).
+    void reindex() {
+        interned.clear();
+        interned.reserve(nodes.size());
+        for (const auto& n : nodes) interned.insert(structural_hash(n), n.id);
+    }
+
+    // Appends `n` as a new node (even if an identical one exists).
     int add_node(Node n) {
+        const std::uint64_t h = structural_hash(n);
         n.id = (int)nodes.size();
         nodes.push_back(std::move(n));
+        interned.insert(h, nodes.back().id);
+        return nodes.back().id;
+    }
+
+    // Returns the id of a node structurally identical to `n` (the first one
+    // added keeps its line and shape), or appends `n`. One hash and one
+    // bucket probe: linear in the node's own payload, not its subtree.
+    int intern(Node n) {
+        const std::uint64_t h = structural_hash(n);
+        const int hit = interned.find(h, [&](int id) { return same_structure(nodes[id], n); });
+        if (hit >= 0) return hit;
+        n.id = (int)nodes.size();
+        nodes.push_back(std::move(n));
+        interned.insert(h, nodes.back().id);
         return nodes.back().id;
     }
 
@@ -51,7 +222,27 @@ struct Graph {
                 case NodeKind::Op:        std::cout << "Op(" << n.name << ")"; break;
                 case NodeKind::ScalarMul: std::cout << "ScalarMul(" << n.scalar << ")"; break;
                 case NodeKind::Add:       std::cout << "Add"; break;
-                case NodeKind::Compose:   std::cout << "Compose(@)"; break;
+                case NodeKind::Compose:
+                    std::cout << "Compose(@";
+                    if (n.trans_a || n.trans_b) std::cout << ", " << (n.trans_a ? 'T' : 'N') << (n.trans_b ? 'T' : 'N');
+                    std::cout << ")";
+                    break;
+                case NodeKind::LinComb:
+                    std::cout << "LinComb(";
+                    for (size_t i = 0; i < n.coeffs.size(); ++i) {
+                        std::cout << n.coeffs[i] << (i + 1 < n.coeffs.size() ? ", " : "");
+                    }
+                    std::cout << ")";
+                    break;
+                case NodeKind::Gemm:
+                    std::cout << "Gemm(alpha=" << n.alpha;
+                    if (n.inputs.size() > 2) std::cout << ", beta=" << n.beta;
+                    if (n.trans_a || n.trans_b) std::cout << ", " << (n.trans_a ? 'T' : 'N') << (n.trans_b ? 'T' : 'N');
+                    std::cout << ")";
+                    break;
+                case NodeKind::Zero:      std::cout << "Zero"; break;
+                case NodeKind::Pow:       std::cout << "Pow(" << n.exponent << ")"; break;
+                case NodeKind::Transpose: std::cout << "Transpose"; break;
             }
             if (!n.inputs.empty()) {
                 std::cout << " [";
@@ -61,6 +252,13 @@ struct Graph {
                 }
                 std::cout << "]";
             }
+            if (n.rows) std::cout << " : " << n.rows << "x" << n.cols;
+            if (n.cost) std::cout << "  ; cost=" << n.cost;
+            if (n.kind == NodeKind::Op && n.structure != Structure::Dense) {
+                std::cout << "  ; " << structure_name(n.structure);
+                if (n.structure == Structure::ScaledIdentity || n.structure == Structure::Sparse)
+                    std::cout << "(" << n.scalar << ")";
+            }
             std::cout << "\n";
         }
 
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+
+namespace loc::ir {
+
+// Heap accounting for plain `new` / `delete` across all threads (bytes
+// requested). Over-aligned allocations (matrix storage, see
+// loc::rt::matrix_mem_stats) are not included. Backed by replacements of
+// the global allocation functions in heap_stats.cpp.
+//
+// Counting is off by default (it costs an atomic update per allocation).
+// While off, nothing is counted; blocks allocated while on are uncounted
+// when freed, whenever that happens.
+//
+// The replacements are linked into every program built on loc_core
+// (`loc`, `loc_bench`), tracking or not: each block carries a header of
+// alignof(std::max_align_t) bytes (16 on x86-64) in front of it, so delete
+// can tell counted blocks from uncounted ones without a size. With
+// tracking off that header, and one relaxed atomic load per new, is the
+// whole cost; programs making many small allocations pay it in memory.
+struct HeapMemStats {
+    std::size_t live_bytes = 0;
+    std::size_t peak_bytes = 0;
+    std::size_t allocations = 0;
+};
+HeapMemStats heap_mem_stats();
+void reset_heap_mem_stats(); // peak := live, allocations := 0
+void set_heap_tracking(bool on);
+
+} // namespace loc::ir
@@ -4,7 +4,20 @@
 
 namespace loc::ir {
 
-// Lowers AST Program into IR Graph
-Graph lower_program(const loc::ast::Program& prog);
+// Lowers AST Program into IR Graph. `shapes` (the operator declarations,
+// as for infer_shapes) lets apply() price powers; without them a power of
+// more than a few factors is applied whole.
+Graph lower_program(const loc::ast::Program& prog, const ShapeMap& shapes = {});
+
+// Builds `op @ x` in `g` without forming op (what `apply(op, x)` lowers
+// to): products are pushed through op's DAG right to left, so A @ B
+// applied to x is A @ (B @ x), and sums and scalar multiples distribute
+// over the results. Every product then has x's width: O(n^2 k) for n x n
+// operators and k vectors. A power A^k is applied as k products only when
+// that is cheaper than forming A^k by repeated squaring
+// (unroll_power_apply, priced from `shapes`); otherwise it becomes
+// A^k @ x, O(n^3 log k). Other node kinds are treated as values (op @ x).
+// New nodes carry `line`; returns the result's id.
+int lower_apply(Graph& g, int op, int x, int line, const ShapeMap& shapes = {});
 
 } // namespace loc::ir
@@ -1,8 +1,9 @@
 #pragma once
 #include "loc/ir/graph.hpp"
 
+#include <cstddef>
 #include <functional>
-#include <iostream>
+#include <iosfwd>
 #include <string>
 #include <utility>
 #include <vector>
@@ -14,26 +15,43 @@ struct Pass {
     std::function<void(Graph&)> run;
 };
 
+// What one pass did to the graph and cost to run (see PassManager::collect_stats).
+struct PassStats {
+    std::string name;
+    double ms = 0.0;                      // wall time
+    std::size_t nodes_before = 0, nodes_after = 0;
+    std::size_t stmts_before = 0, stmts_after = 0;
+    std::size_t peak_heap_bytes = 0;      // heap high-water mark above the pass's start
+    std::size_t allocations = 0;          // heap allocations made by the pass
+};
+
 class PassManager {
 public:
     bool dump_after_each = false;
+    bool collect_stats = false; // fill stats() on run()
 
     void add(std::string name, std::function<void(Graph&)> fn) {
         passes_.push_back(Pass{std::move(name), std::move(fn)});
     }
 
-    void run(Graph& g) const {
-        for (const auto& p : passes_) {
-            // std::cout << "\n[pass] " << p.name << "\n";
-            p.run(g);
-            if (dump_after_each) {
-                g.dump();
-            }
-        }
-    }
+    // Pass names in order, comma-separated (part of the program cache key).
+    std::string pipeline() const;
+
+    // Runs every pass in order. If a pass throws, stats() covers the passes
+    // that completed.
+    void run(Graph& g);
+
+    const std::vector<PassStats>& stats() const { return stats_; }
+
+    // Human-readable table (one row per pass, plus a total).
+    void print_report(std::ostream& os) const;
+
+    // The same data as a JSON object: {"passes": [...], "total_ms": ...}.
+    void write_json(std::ostream& os) const;
 
 private:
     std::vector<Pass> passes_;
+    std::vector<PassStats> stats_;
 };
 
 } // namespace loc::ir
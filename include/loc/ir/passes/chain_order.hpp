@@ -0,0 +1,35 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+namespace loc::ir::passes {
+
+// Re-associates chains of Compose nodes to minimize multiply-adds.
+//
+// A chain is a maximal Compose tree whose interior nodes have a single
+// consumer and are not named by any statement; shared Compose nodes (and
+// everything else) are chain operands, so common subexpressions are never
+// duplicated. The best parenthesization is found with the classic
+// matrix-chain dynamic program over the operand shapes (from infer_shapes); ties keep the
+// original left-to-right order, so chains with nothing to gain (e.g. all
+// square) are left as written. Chains with unknown or mismatched shapes
+// are left untouched for the runtime to report. The DP is O(k^3) in the
+// chain length k, so chains of more than 256 operands are ordered in
+// windows of 256, and the windows' products then by the same DP.
+//
+// A product with a structured operator factor (diagonal, permutation, ...)
+// costs one multiply per output element, as the runtime's structured
+// kernels do; one with a sparse operator factor costs its density times
+// the dense count.
+//
+// A run of one square operand repeated (A @ A @ A @ A) may also become a
+// single Pow node, evaluated by repeated squaring (pow_products), when
+// that is strictly cheaper than both its products and applying it factor
+// by factor to the chain's thinner end; the same cost model decides, so
+// A @ A @ A @ v still runs as three products with the thin v. Runs are
+// found in one linear scan before the DP.
+//
+// Every Compose and Pow with a known shape gets its `cost` set. Rebuilds the graph
+// (like const_fold); nodes unreachable from the program are dropped.
+void chain_order(Graph& g);
+
+} // namespace loc::ir::passes
@@ -4,6 +4,14 @@
 namespace loc::ir::passes {
 
 // Rebuilds graph from roots, performing constant folding + canonicalization.
+// With shapes and operator structure known (infer_shapes), also folds
+// algebra on structured operators: I @ x and x @ I to x, (c*I) @ x to c*x,
+// and zeros (0 * x, an all-zero operator, anything composed with zero) to
+// a Zero node, which then drops out of sums. Powers fold too: x^1 to x,
+// (a*x)^k to a^k * x^k, (x^j)^k to x^(j*k), and x^i @ x^j to x^(i+j)
+// once either factor is a power. Transposes are pushed inward: (x')' to x,
+// (a @ b)' to b' @ a', (a*x)' to a*x', (x^k)' to (x')^k, and symmetric
+// structured operators (I, c*I, diagonal) drop theirs.
 void const_fold(Graph& g);
 
 } // namespace loc::ir::passes
@@ -0,0 +1,22 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+namespace loc::ir::passes {
+
+// Global value numbering: nodes computing the same value become one node.
+//
+// Two nodes get the same value number when
+//   - they are structurally identical after their inputs are numbered
+//     (hash-consing; Add operands are put in canonical order first), or
+//   - both are sums (Add / ScalarMul / LinComb trees) whose flattened
+//     terms agree: the same leaves with the same coefficients, in any
+//     association or order. So (X + C) + D, X + (C + D) and D + (C + X)
+//     are one node, and so is anything built on top of them.
+// Merged sums keep the first node's evaluation order; a later duplicate may
+// therefore round differently than it would have on its own.
+//
+// Can run anywhere in the pipeline. Rebuilds the graph from the program
+// roots (like const_fold); nodes unreachable from the program are dropped.
+void cse(Graph& g);
+
+} // namespace loc::ir::passes
@@ -0,0 +1,25 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+namespace loc::ir::passes {
+
+// Folds the elementwise work around a product into the GEMM epilogue:
+//   ScalarMul(a)[A @ B]                 -> Gemm(alpha=a) [A, B]
+//   Add / LinComb(a, b)[A @ B, C]       -> Gemm(alpha=a, beta=b) [A, B, C]
+//   LinComb(a, c1..cn)[A @ B, X1..Xn]   -> Gemm(alpha=a, beta=1) [A, B, <rest>]
+// where <rest> = sum c_i X_i is folded the same way (a further product in
+// it becomes the next Gemm down the accumulation chain), else a LinComb.
+// A Compose is folded only if it has no other consumer and is not printed. The runtime applies alpha and beta * C as
+// each output tile is stored, so the product never makes a separate pass.
+//
+// Transposed factors are absorbed the same way: A' @ B becomes a product
+// with trans_a set over A itself (likewise trans_b), which the kernel reads
+// in place (TN / NT / TT GEMM), so no transpose is ever materialized for
+// it. Products with a structured or sparse operator factor keep their
+// Transpose nodes, since those kernels read storage order only.
+//
+// Runs after fusion (it consumes LinComb nodes). Rebuilds the graph from
+// the program roots, like const_fold.
+void fuse_gemm_epilogue(Graph& g);
+
+} // namespace loc::ir::passes
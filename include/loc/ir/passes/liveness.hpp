@@ -0,0 +1,33 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+#include <vector>
+
+namespace loc::ir::passes {
+
+// Liveness of IR nodes under serial, program-order evaluation.
+struct Liveness {
+    // Live nodes in evaluation order (inputs before consumers), i.e. the
+    // order a recursive evaluator walking the program computes them in.
+    std::vector<int> order;
+
+    // References per node: one per consumer edge plus one per program
+    // statement naming it. A node is dead once all of them are done.
+    std::vector<int> uses;
+
+    // Index into `order` of the last step that reads the node (a consumer,
+    // or, for a statement naming it, the first step after that statement:
+    // it reads between steps, so no node computed before it may take over
+    // the value in place); -1 for nodes that are never read. May equal
+    // order.size() for the last statement.
+    std::vector<int> last_use;
+
+    // For each program statement, how many entries of `order` must have
+    // been computed before it runs (a prefix length of `order`).
+    std::vector<int> stmt_end;
+};
+
+// Analysis only: does not modify the graph. Throws on cycles or bad ids.
+Liveness compute_liveness(const Graph& g);
+
+} // namespace loc::ir::passes
@@ -0,0 +1,18 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+namespace loc::ir::passes {
+
+// Fills in every node's rows/cols, seeded from the operator declarations
+// (which also give Op nodes their structure), and rejects ill-shaped programs before anything runs:
+//   Add      - both sides must have the same shape
+//   Compose  - left cols must equal right rows (of each factor as read,
+//              i.e. after its trans_a / trans_b flag)
+//   Pow      - the base must be square
+// and a Transpose swaps its input's rows and cols.
+// Mismatches throw std::runtime_error("Shape error at line N: ...").
+// Operators missing from `shapes` stay unknown (0 x 0), as does everything
+// computed from them; the runtime reports those.
+void infer_shapes(Graph& g, const ShapeMap& shapes);
+
+} // namespace loc::ir::passes
@@ -0,0 +1,56 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace loc::ir {
+
+// Compact binary encoding for the compiled-program cache
+// (loc/runtime/program_cache.hpp): unsigned integers as LEB128 varints,
+// doubles as their 8 little-endian bytes, strings length-prefixed.
+class ByteWriter {
+public:
+    explicit ByteWriter(std::string& out) : out_(out) {}
+
+    void byte(std::uint8_t b) { out_.push_back((char)b); }
+    void varint(std::uint64_t v);
+    void f64(double x);
+    void str(const std::string& s);
+
+private:
+    std::string& out_;
+};
+
+// Reads what ByteWriter wrote; every read throws std::runtime_error past
+// the end of the buffer, so truncated input is always caught.
+class ByteReader {
+public:
+    ByteReader(const char* data, std::size_t size) : p_(data), end_(data + size) {}
+
+    std::uint8_t byte();
+    std::uint64_t varint();
+    // An element count (varint), checked against the bytes left (every
+    // element takes at least one), so corrupt input cannot force a huge
+    // allocation.
+    std::size_t count();
+    double f64();
+    std::string str();
+    bool done() const { return p_ == end_; }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+// A Graph: nodes in id order, each with only its kind's payload (what
+// dump() shows) plus inputs, shape, line and cost; then the program. The
+// intern table is rebuilt on read, so the result hash-conses like the
+// graph that was written.
+void write_graph(ByteWriter& w, const Graph& g);
+// Throws std::runtime_error on malformed input (unknown kinds, input or
+// statement ids out of range).
+Graph read_graph(ByteReader& r);
+
+} // namespace loc::ir
@@ -0,0 +1,24 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+namespace loc::passes {
+
+// Elementwise fusion over the IR: every maximal tree of Add / ScalarMul
+// nodes becomes one LinComb node, sum_i c_i * X_i, that the runtime
+// evaluates in a single sweep with no intermediate matrices.
+//
+// Tree interiors are Add / ScalarMul nodes with a single consumer (itself
+// Add / ScalarMul) that are not printed; anything else is a term X_i, so
+// shared values are still computed once. Assignments do not block fusion:
+// an assigned value used once is inlined into its consumer's sum. Scalars are distributed onto
+// the terms and repeated terms have their coefficients summed. Trees of a
+// single node are left alone.
+//
+// Numerics: terms are summed left to right, so left-deep sums such as
+// `2*A + 3*B + C` round exactly as unfused. Right-nested sums, distributed
+// scalars and merged terms may differ in the last bits.
+//
+// Rewrites in place; the absorbed nodes become dead (run dce afterwards).
+void fuse_elementwise(loc::ir::Graph& g);
+
+} // namespace loc::passes
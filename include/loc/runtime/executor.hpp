@@ -3,8 +3,20 @@
 #include "loc/ir/graph.hpp"
 #include "loc/runtime/registry.hpp"
 #include "loc/runtime/matrix.hpp"
+#include "loc/runtime/memory_plan.hpp"
+#include "loc/runtime/precision.hpp"
+#include "loc/runtime/profiler.hpp"
+#include "loc/runtime/sparse.hpp"
+#include "loc/runtime/structure.hpp"
 
-#include <optional>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace loc::rt {
@@ -13,15 +25,124 @@ class Executor {
 public:
     explicit Executor(const Registry& reg) : reg_(reg) {}
 
+    // How run() evaluates the graph:
+    //   Parallel - independent nodes run concurrently on the thread pool;
+    //              results live in a reference-counted cache.
+    //   Serial   - same cache, one node at a time (recursive evaluator).
+    //   Planned  - serial order over a static memory plan: one arena per
+    //              program, no per-node allocation once prepared.
+    //   Auto     - Parallel if the pool has more than one thread, else Planned.
+    // Prints always come out in program order. A graph reading a sparse
+    // operator runs Planned as Serial: how much a sparse intermediate fills
+    // in is only known once it is computed, so it cannot be planned.
+    enum class Schedule { Auto, Serial, Parallel, Planned };
+    Schedule schedule = Schedule::Auto;
+
+    // Optional: every node evaluation of run() is recorded here (restarted
+    // on each run). Costs two clock reads per node when set.
+    Profiler* profiler = nullptr;
+
+    // Where print statements are written; null discards them. `on_print`,
+    // if set, also receives each printed value, in program order.
+    std::ostream* print_stream = &std::cout;
+    std::function<void(const Matrix&)> on_print;
+
+    // Evaluates the program in precision() (precision.hpp). F32 and Mixed
+    // run the serial evaluator over MatrixF32 whatever `schedule` says,
+    // with structured operators treated as dense; printed values are the
+    // float results widened to double. A graph reading a sparse operator
+    // runs in F64.
     void run(const loc::ir::Graph& g);
 
+    // Matrix-free application: the operator computed by node `op` (or by
+    // the last assignment to `name`) applied to the columns of `x`, as
+    // `apply(op, x)` in the language. Products go right to left through
+    // op's DAG and sums and scalar multiples distribute, so nothing wider
+    // than x is formed, except a power whose k products would cost more
+    // than forming it (loc::ir::unroll_power_apply); operators use their
+    // dense, structured or sparse kernels. Throws std::runtime_error on
+    // shape mismatches.
+    Matrix apply(const loc::ir::Graph& g, int op, const Matrix& x);
+    Matrix apply(const loc::ir::Graph& g, const std::string& name, const Matrix& x);
+
+    // Plans memory for `g` and sizes the arena (run() does this on demand
+    // for a graph it has not seen). Call again if `g` or the registry change.
+    void prepare(const loc::ir::Graph& g);
+    const MemoryPlan* plan() const { return plan_.get(); }
+
 private:
     const Registry& reg_;
 
-    // NEW: memoization cache (one slot per IR node id)
-    mutable std::vector<std::optional<Matrix>> cache_;
+    // Memoization cache (one slot per IR node id). Slots share buffers with
+    // the registry and with each other; nothing is copied on a hit. A slot
+    // is released as soon as its last reader (see `remaining_`) is done.
+    mutable std::vector<MatrixPtr> cache_;
+    // Sparse-valued nodes have their slot here instead (cache_'s is empty).
+    mutable std::vector<SparsePtr> sparse_;
+
+    // Outstanding reads per node: consumer edges plus statements naming it,
+    // seeded from loc::ir::passes::compute_liveness().
+    std::unique_ptr<std::atomic<int>[]> remaining_;
+
+    void eval(const loc::ir::Graph& g, int id);
+
+    // Computes node `id` into its cache slot (compute() or compute_sparse()),
+    // timed into `profiler` when one is attached.
+    void compute_profiled(const loc::ir::Graph& g, int id);
+
+    // Computes node `id` from its cached inputs, then releases the inputs
+    // this was the last reader of. Add and ScalarMul reuse a dead input's
+    // buffer in place when it has the output's shape.
+    MatrixPtr compute(const loc::ir::Graph& g, int id);
+
+    // A node that is a sparse operator or reads a sparse value. Its value is
+    // computed by the kernels in sparse.hpp: sparse when every operand is
+    // (kept sparse unless it fills in past sparse_max_density()), else dense.
+    bool sparse_op(const loc::ir::Graph& g, int id) const;
+    bool reads_sparse(const loc::ir::Graph& g, int id) const;
+    void compute_sparse(const loc::ir::Graph& g, int id);
+
+    // Moves a dead input's buffer out of the cache for in-place reuse, if
+    // this is its last reader and nobody else (e.g. the registry) holds it.
+    std::shared_ptr<Matrix> take_if_dead(int id, std::size_t rows, std::size_t cols);
+    void release(int id);
+
+    // The registry structure of node `id` if it is a structured operator
+    // (not Dense), else null. Compose / Gemm / Add / LinComb reading one
+    // dispatch to the kernels in structure.hpp instead of dense ones.
+    const StructuredOp* structured(const loc::ir::Graph& g, int id) const;
+
+    // Add / LinComb with at least one structured input (else null): the
+    // dense terms are combined as usual, then each structured term is added
+    // over its nonzeros only.
+    std::shared_ptr<Matrix> structured_sum(const loc::ir::Graph& g, const loc::ir::Node& n);
+
+    // Planned schedule state: arena, per-node views into it, and the value
+    // each node reads as (its view, or the registry matrix for Op nodes).
+    std::unique_ptr<MemoryPlan> plan_;
+    const loc::ir::Graph* planned_for_ = nullptr;
+    std::vector<double, detail::KernelAllocator<double>> arena_;
+    std::vector<Matrix> views_;
+    std::vector<const Matrix*> values_;
+    std::vector<const StructuredOp*> structs_; // per node, see structured()
+    std::vector<const double*> ptrs_;          // LinComb input scratch
+    std::vector<double> coeffs_;               // LinComb coefficient scratch
+
+    // apply(): op @ x (op' @ x with `trans`), memoized per (node, trans, x)
+    // for shared subexpressions.
+    MatrixPtr apply_node(const loc::ir::Graph& g, int op, bool trans, const MatrixPtr& x,
+                         std::map<std::tuple<int, bool, const Matrix*>, MatrixPtr>& memo);
+
+    // run() in F32 / Mixed: operators are rounded to float once, as their
+    // Op node is evaluated, and intermediates are freed after their last
+    // reader as in the serial schedule.
+    void run_reduced(const loc::ir::Graph& g);
 
-    Matrix eval(const loc::ir::Graph& g, int id);
+    void run_planned(const loc::ir::Graph& g);
+    void planned_sum(const loc::ir::Node& n, Matrix& out);
+    void run_parallel(const loc::ir::Graph& g, const std::vector<int>& order);
+    void emit(const loc::ir::Graph::Stmt& s, const Matrix& v) const;
+    void emit_cached(const loc::ir::Graph::Stmt& s) const; // from cache_ / sparse_
 };
 
 } // namespace loc::rt
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace loc::rt {
+
+// GEMM backends selectable at runtime (CLI `--gemm=`, env `LOC_GEMM`).
+//
+//   Naive   - the original i-k-j triple loop (unchecked pointers).
+//   Blocked - L1/L2 cache-blocked kernel with packed A/B panels and an
+//             MR x NR register-tiled microkernel. The microkernel follows
+//             simd::active_isa() (so `--simd=` caps it too): AVX-512 and
+//             AVX2 FMA kernels with wide tiles, else a portable one.
+//
+// Tolerance: both kernels accumulate every C(i,j) over k in increasing order.
+// The blocked kernel restarts its register accumulator at each KC-sized
+// k-block and adds it into C, so for K <= KC (and alpha = 1, beta = 0) the
+// portable microkernel is bitwise identical to the naive loop; the FMA
+// kernels round each multiply-add once instead of twice, so they are not.
+// In every case the results agree to
+//     |C_blocked - C_naive| <= K * eps * sum_k |A(i,k)| |B(k,j)|
+// which is the usual forward error bound for a reordered dot product.
+enum class GemmKernel { Naive, Blocked };
+
+// Blocking parameters (doubles). MR x NR is the portable kernel's register
+// tile (the vector kernels' are wider); KC x NR B micro-panels stay in L1,
+// MC x KC A blocks stay in L2.
+constexpr std::size_t kGemmMR = 4;
+constexpr std::size_t kGemmNR = 8;
+constexpr std::size_t kGemmMC = 128;
+constexpr std::size_t kGemmKC = 256;
+constexpr std::size_t kGemmNC = 2048;
+
+void set_gemm_kernel(GemmKernel k);
+GemmKernel gemm_kernel(); // defaults to LOC_GEMM, else Blocked
+
+// Multithreading: calls with m*n*k >= this threshold (multiply-adds) are
+// split into 2D tiles of C and run on the runtime thread pool. Tiling does
+// not change the per-element summation order, so results are identical to
+// the single-threaded kernel. Default: LOC_GEMM_MT_MIN, else kGemmMtMinDefault.
+constexpr std::size_t kGemmMtMinDefault = std::size_t(1) << 21; // ~128^3
+void set_gemm_parallel_threshold(std::size_t mnk);
+std::size_t gemm_parallel_threshold();
+
+// Parses "naive" / "blocked". Returns false on unknown names.
+bool parse_gemm_kernel(const std::string& s, GemmKernel& out);
+const char* gemm_kernel_name(GemmKernel k);
+
+// C = alpha * A * B + beta * C   (row-major, leading dimensions in elements)
+// Dispatches to the selected kernel, multithreaded above the threshold.
+// A is m x k, B is k x n, C is m x n. When beta == 0, C is not read.
+// No shape or bounds checks: callers validate shapes.
+void gemm(std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const double* a, std::size_t lda,
+          const double* b, std::size_t ldb,
+          double beta, double* c, std::size_t ldc);
+
+// C = alpha * A * B + beta * C0, with C0 read from its own buffer (m x n,
+// leading dimension ldc0): dgemm with the accumulation operand kept apart
+// from the output, so it need not be copied into C first. C0 may be C
+// itself; otherwise the two must not overlap.
+void gemm(std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const double* a, std::size_t lda,
+          const double* b, std::size_t ldb,
+          double beta, const double* c0, std::size_t ldc0,
+          double* c, std::size_t ldc);
+
+// Operand layout for the overload below: Trans::T reads the stored matrix
+// as its transpose, in place (BLAS transa / transb).
+enum class Trans { N, T };
+
+// C = alpha * op(A) * op(B) + beta * C0, op(X) = X or X'. op(A) is m x k and
+// op(B) is k x n; lda / ldb are the leading dimensions of A and B as stored
+// (a transposed A is stored k x m). The transpose is folded into panel
+// packing, so the result is bitwise that of the NN call on a materialized
+// transpose. The overloads above are the NN case.
+void gemm(Trans ta, Trans tb, std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const double* a, std::size_t lda,
+          const double* b, std::size_t ldb,
+          double beta, const double* c0, std::size_t ldc0,
+          double* c, std::size_t ldc);
+
+// The same over floats (MatrixF32). Panels are packed, and products summed,
+// in float; with `accumulate_f64` they are packed to double instead and C
+// is accumulated in a double buffer, rounded to float once at the end
+// (mixed precision: float storage and bandwidth, double sums).
+void gemm(Trans ta, Trans tb, std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const float* a, std::size_t lda,
+          const float* b, std::size_t ldb,
+          double beta, const float* c0, std::size_t ldc0,
+          float* c, std::size_t ldc, bool accumulate_f64 = false);
+
+void gemm_naive(std::size_t m, std::size_t n, std::size_t k,
+                double alpha, const double* a, std::size_t lda,
+                const double* b, std::size_t ldb,
+                double beta, double* c, std::size_t ldc);
+
+void gemm_blocked(std::size_t m, std::size_t n, std::size_t k,
+                  double alpha, const double* a, std::size_t lda,
+                  const double* b, std::size_t ldb,
+                  double beta, double* c, std::size_t ldc);
+
+} // namespace loc::rt
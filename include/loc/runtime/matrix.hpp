@@ -1,38 +1,199 @@
 #pragma once
 #include <vector>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
 #include <ostream>
 
 namespace loc::rt {
 
-class Matrix {
+// Matrix storage accounting across all threads (bytes of element storage).
+struct MatrixMemStats {
+    std::size_t live_bytes = 0;
+    std::size_t peak_bytes = 0;
+    std::size_t allocations = 0;
+};
+MatrixMemStats matrix_mem_stats();
+void reset_matrix_mem_stats(); // peak := live, allocations := 0
+
+namespace detail {
+
+void track_alloc(std::size_t bytes);
+void track_free(std::size_t bytes);
+
+// 64-byte aligned allocator that default-initializes elements, so
+// `std::vector<double, ...>(n)` does not zero-fill storage that a kernel is
+// about to overwrite anyway.
+template <class T, std::size_t Align = 64>
+struct KernelAllocator {
+    using value_type = T;
+    template <class U> struct rebind { using other = KernelAllocator<U, Align>; };
+
+    KernelAllocator() = default;
+    template <class U> KernelAllocator(const KernelAllocator<U, Align>&) {}
+
+    T* allocate(std::size_t n) {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+        track_alloc(n * sizeof(T));
+        return p;
+    }
+    void deallocate(T* p, std::size_t n) noexcept {
+        track_free(n * sizeof(T));
+        ::operator delete(p, std::align_val_t{Align});
+    }
+
+    template <class U> void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <class U, class... Args> void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <class U> bool operator==(const KernelAllocator<U, Align>&) const { return true; }
+    template <class U> bool operator!=(const KernelAllocator<U, Align>&) const { return false; }
+};
+
+// Keeps a parameter out of template argument deduction (so `nullptr` binds).
+template <class T> struct NonDeduced { using type = T; };
+
+} // namespace detail
+
+// Dense row-major matrix over element type T (double or float; both are
+// instantiated in matrix.cpp). `Matrix` is the double one the compiler and
+// executor run on; `MatrixF32` backs the reduced-precision modes (see
+// precision.hpp). Scalars (fill values, coefficients, alpha / beta) are
+// double for either.
+template <class T>
+class BasicMatrix {
 public:
-    Matrix() = default;
-    Matrix(std::size_t r, std::size_t c, double fill = 0.0);
+    using value_type = T;
+    // Element storage of an owning matrix: row-major, 64-byte aligned.
+    using Storage = std::vector<T, detail::KernelAllocator<T>>;
+
+    BasicMatrix() = default;
+    BasicMatrix(std::size_t r, std::size_t c, double fill = 0.0);
+    // Adopts `data` (r * c row-major elements) without copying.
+    BasicMatrix(std::size_t r, std::size_t c, Storage&& data);
+
+    static BasicMatrix identity(std::size_t n);
+    // Storage is left uninitialized; the caller must write every element.
+    static BasicMatrix uninitialized(std::size_t r, std::size_t c);
+    // Non-owning view over caller-managed storage (e.g. an arena slot). The
+    // storage must outlive the view; copying a view yields an owning copy.
+    static BasicMatrix view(std::size_t r, std::size_t c, T* data);
 
-    static Matrix identity(std::size_t n);
+    BasicMatrix(const BasicMatrix& o);
+    BasicMatrix& operator=(const BasicMatrix& o);
+    BasicMatrix(BasicMatrix&&) noexcept = default;
+    BasicMatrix& operator=(BasicMatrix&&) noexcept = default;
 
     std::size_t rows() const { return r_; }
     std::size_t cols() const { return c_; }
+    std::size_t size() const { return r_ * c_; }
+    bool is_view() const { return view_ != nullptr; }
 
-    double& operator()(std::size_t i, std::size_t j);
-    double  operator()(std::size_t i, std::size_t j) const;
+    T& operator()(std::size_t i, std::size_t j);
+    T  operator()(std::size_t i, std::size_t j) const;
 
-    Matrix matmul(const Matrix& b) const;
+    // Unchecked row-major storage (rows() * cols() elements) for kernels.
+    T*       data()       { return view_ ? view_ : data_.data(); }
+    const T* data() const { return view_ ? view_ : data_.data(); }
 
-    // ops
-    friend Matrix operator+(const Matrix& a, const Matrix& b);
-    friend Matrix operator*(double s, const Matrix& a);
-    friend Matrix operator*(const Matrix& a, double s) { return s * a; }
+    BasicMatrix matmul(const BasicMatrix& b) const;
 
-    // (optional convenience wrapper)
-    friend Matrix matmul(const Matrix& a, const Matrix& b) { return a.matmul(b); }
+    // Writes into preallocated `out` (no allocation). Shapes are checked
+    // like matmul; `out` must not alias an input.
+    void matmul_into(const BasicMatrix& b, BasicMatrix& out) const;
 
-    friend std::ostream& operator<<(std::ostream& os, const Matrix& m);
+    // in-place ops (same SIMD kernels, output aliases this)
+    BasicMatrix& operator+=(const BasicMatrix& b);
+    BasicMatrix& operator*=(double s);
+
+    // a' (copied in cache-sized tiles).
+    BasicMatrix transpose() const;
 
 private:
     std::size_t r_{0}, c_{0};
-    std::vector<double> data_;
+    Storage data_;      // owned storage
+    T* view_ = nullptr; // or borrowed
 };
 
+using Matrix = BasicMatrix<double>;
+using MatrixF32 = BasicMatrix<float>;
+using MatrixStorage = Matrix::Storage;
+
+extern template class BasicMatrix<double>;
+extern template class BasicMatrix<float>;
+
+// ---------- Kernels ----------
+//
+// Declared for any T, defined (explicitly instantiated) for double and
+// float. The *_into versions write into preallocated `out` (no allocation)
+// and check shapes like the allocating ones; `out` may alias an input of
+// add_into / scale_into.
+
+template <class T>
+void add_into(const BasicMatrix<T>& a, const BasicMatrix<T>& b, BasicMatrix<T>& out);
+template <class T>
+void scale_into(double s, const BasicMatrix<T>& a, BasicMatrix<T>& out);
+
+template <class T>
+BasicMatrix<T> operator+(const BasicMatrix<T>& a, const BasicMatrix<T>& b);
+template <class T>
+BasicMatrix<T> operator*(double s, const BasicMatrix<T>& a);
+template <class T>
+BasicMatrix<T> operator*(const BasicMatrix<T>& a, double s) { return s * a; }
+// alpha * x + beta * y in one pass over memory
+template <class T>
+BasicMatrix<T> axpby(double alpha, const BasicMatrix<T>& x, double beta, const BasicMatrix<T>& y);
+
+// out = alpha * (a @ b) + beta * c, with the scale and accumulation done
+// in the GEMM epilogue. `c` may be null (beta ignored) or alias `out`;
+// `out` must not alias `a` or `b`. For float, the products accumulate in
+// double under Precision::Mixed (precision.hpp).
+template <class T>
+void gemm_into(double alpha, const BasicMatrix<T>& a, const BasicMatrix<T>& b,
+               double beta, const typename detail::NonDeduced<BasicMatrix<T>>::type* c,
+               BasicMatrix<T>& out);
+// The same with a and / or b read transposed in place (no copy).
+template <class T>
+void gemm_into(double alpha, const BasicMatrix<T>& a, bool trans_a,
+               const BasicMatrix<T>& b, bool trans_b,
+               double beta, const typename detail::NonDeduced<BasicMatrix<T>>::type* c,
+               BasicMatrix<T>& out);
+
+// out = sum_i coeffs[i] * xs[i] in one pass; every x must have out's
+// shape. `out` may alias any of them.
+template <class T>
+void lincomb_into(const std::vector<double>& coeffs,
+                  const std::vector<const BasicMatrix<T>*>& xs, BasicMatrix<T>& out);
+
+// a^k by repeated squaring: loc::ir::pow_products(k) matrix products
+// instead of k - 1 (k = 0: the identity). Throws unless `a` is square.
+template <class T>
+BasicMatrix<T> power(const BasicMatrix<T>& a, std::uint64_t k);
+// The same into `out`, which must not alias `a`; `scratch` holds
+// 2 * a.size() elements for the intermediate powers.
+template <class T>
+void power_into(const BasicMatrix<T>& a, std::uint64_t k, BasicMatrix<T>& out, T* scratch);
+
+// a' into `out`, which must not alias `a`.
+template <class T>
+void transpose_into(const BasicMatrix<T>& a, BasicMatrix<T>& out);
+
+// (optional convenience wrapper)
+template <class T>
+BasicMatrix<T> matmul(const BasicMatrix<T>& a, const BasicMatrix<T>& b) { return a.matmul(b); }
+
+// Element type conversion (rounded to nearest for double -> float).
+MatrixF32 to_f32(const Matrix& m);
+Matrix to_f64(const MatrixF32& m);
+
+template <class T>
+std::ostream& operator<<(std::ostream& os, const BasicMatrix<T>& m);
+
+// Shared, immutable, reference-counted matrix. The executor and registry hand
+// these out so cache hits and operator reads never copy element storage.
+using MatrixPtr = std::shared_ptr<const Matrix>;
+
 } // namespace loc::rt
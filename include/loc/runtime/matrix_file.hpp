@@ -0,0 +1,72 @@
+#pragma once
+#include "loc/runtime/matrix.hpp"
+#include "loc/runtime/sparse.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace loc::rt {
+
+// Binary operator files, as read by `operator A = load("a.bin");`.
+//
+// A 64-byte little-endian header followed by rows * cols IEEE doubles in
+// row-major order, so the elements start 64-byte aligned in the mapping:
+//
+//   offset  size  field
+//        0     8  magic "LOCMAT\0\0"
+//        8     4  version (1)
+//       12     4  element size in bytes (8)
+//       16     8  rows
+//       24     8  cols
+//       32    32  reserved (zero)
+struct MatrixFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t elem_size;
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint8_t reserved[32];
+};
+static_assert(sizeof(MatrixFileHeader) == 64, "header layout");
+
+// Maps `path` and returns a view over the mapped elements (no copy, no
+// parse); the mapping lives as long as the returned pointer. Where mmap is
+// unavailable the file is read into an owned matrix instead. Throws
+// std::runtime_error on I/O errors and malformed files.
+MatrixPtr load_matrix(const std::string& path);
+
+// Writes `m` in the format above (replacing `path`).
+void save_matrix(const std::string& path, const Matrix& m);
+
+// Sparse operator files (CSR), also read by load(): a 64-byte header, then
+// row_ptr as rows + 1 uint64, col_idx as nnz uint32 (zero-padded to a
+// multiple of 8 bytes) and values as nnz doubles:
+//
+//   offset  size  field
+//        0     8  magic "LOCCSR\0\0"
+//        8     4  version (1)
+//       12     4  element size in bytes (8)
+//       16     8  rows
+//       24     8  cols
+//       32     8  nnz
+//       40    24  reserved (zero)
+struct SparseFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t elem_size;
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t nnz;
+    std::uint8_t reserved[24];
+};
+static_assert(sizeof(SparseFileHeader) == 64, "header layout");
+
+// True if `path` starts with the sparse magic (false if it cannot be read).
+bool is_sparse_file(const std::string& path);
+
+// Reads a sparse file into memory (O(rows + nnz)); throws
+// std::runtime_error on I/O errors and malformed files.
+SparsePtr load_sparse_matrix(const std::string& path);
+void save_sparse_matrix(const std::string& path, const SparseMatrix& m);
+
+} // namespace loc::rt
@@ -0,0 +1,46 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+#include "loc/ir/passes/liveness.hpp"
+#include "loc/runtime/registry.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace loc::rt {
+
+// Static memory plan for one program: every intermediate result gets an
+// offset into a single 64-byte aligned arena, so a planned run allocates no
+// matrix storage of its own.
+//
+// Lifetimes come from the serial evaluation order (see compute_liveness):
+// a result is live from the step that computes it to its last read. Two
+// results may share arena bytes iff their lifetimes are disjoint, i.e. the
+// interval graph of lifetimes is coloured with byte ranges. Offsets are
+// assigned greedily, largest buffer first, at the lowest offset that does
+// not overlap any already-placed buffer with an intersecting lifetime.
+// Elementwise results (Add / ScalarMul / LinComb) are placed on top of an
+// input that dies at that step when sizes match (in-place), extending that
+// buffer's lifetime. A Pow also gets 2 * rows * cols doubles of scratch,
+// live only at its own step.
+//
+// Op nodes are not planned: they read the registry's buffers directly.
+struct MemoryPlan {
+    static constexpr std::size_t kNoSlot = SIZE_MAX;
+
+    loc::ir::passes::Liveness liveness;
+
+    std::vector<std::size_t> rows, cols;   // per node (0 x 0 if not live)
+    std::vector<std::size_t> offset;       // per node, in doubles; kNoSlot if unplanned
+    std::vector<std::size_t> scratch;      // Pow scratch (see power_into); else kNoSlot
+
+    std::size_t arena_elems = 0;           // planned arena size (doubles)
+    std::size_t naive_elems = 0;           // one buffer per intermediate (doubles)
+    std::size_t in_place = 0;              // results planned on top of a dead input
+};
+
+// Infers every live node's shape from the registry (throws the runtime's
+// shape-mismatch errors before anything executes) and plans the arena.
+MemoryPlan plan_memory(const loc::ir::Graph& g, const Registry& reg);
+
+} // namespace loc::rt
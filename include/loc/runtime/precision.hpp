@@ -0,0 +1,36 @@
+#pragma once
+#include "loc/runtime/matrix.hpp"
+
+#include <string>
+
+namespace loc::rt {
+
+// Element precision programs run in (CLI `--precision=`, env `LOC_PRECISION`).
+//
+//   F64   - every value is a Matrix (double); the default.
+//   F32   - operators are rounded to float once and every intermediate is a
+//           MatrixF32: half the memory and bandwidth, float arithmetic.
+//   Mixed - float storage as F32, but GEMMs pack their panels to double and
+//           accumulate in double, rounding each product once.
+//
+// The reduced modes run on Executor's serial evaluator; a program that
+// reads a sparse operator runs in F64 (see Executor::run).
+enum class Precision { F64, F32, Mixed };
+
+void set_precision(Precision p);
+Precision precision(); // defaults to LOC_PRECISION, else F64
+
+// Parses "f64" / "f32" / "mixed". Returns false on unknown names.
+bool parse_precision(const std::string& s, Precision& out);
+const char* precision_name(Precision p);
+
+// Error of a reduced-precision result against its f64 reference:
+// max |x - ref| and that divided by max |ref| (or by 1 when ref is 0).
+struct PrecisionError {
+    double max_abs = 0.0;
+    double rel = 0.0;
+};
+// Throws std::runtime_error if the shapes differ.
+PrecisionError precision_error(const Matrix& value, const Matrix& reference);
+
+} // namespace loc::rt
@@ -0,0 +1,71 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace loc::rt {
+
+// Opt-in per-node execution profile (see Executor::profiler).
+//
+// Every node evaluation is recorded with its wall time, output shape and
+// an analytic cost: FLOPs (2mnk for a product plus the epilogue, one per
+// element and term for elementwise nodes) and the minimum bytes moved
+// (each input read once, the output written once). Achieved GFLOP/s and
+// GB/s are those over the node's wall time. Cache hits are reads of an
+// already computed result; misses are evaluations.
+//
+// Thread safe: the parallel schedule records from pool workers.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct NodeStats {
+        std::string label;          // e.g. "Compose(@)", "LinComb(3)"
+        std::size_t rows = 0, cols = 0;
+        double ms = 0.0;            // total over evaluations
+        std::uint64_t flops = 0;    // per evaluation
+        std::uint64_t bytes = 0;    // per evaluation
+        std::size_t misses = 0;     // evaluations
+        std::size_t hits = 0;       // reads served from the cache
+    };
+
+    // Clears previous data and sizes the tables for `g`; Executor::run
+    // calls this when a profiler is attached.
+    void start(const loc::ir::Graph& g);
+
+    // Node `id` was evaluated on the calling thread over [t0, t1) and
+    // produced a rows x cols result. Inputs must have been recorded first.
+    void record(int id, Clock::time_point t0, Clock::time_point t1,
+                std::size_t rows, std::size_t cols);
+    void hit(int id, std::size_t n = 1);
+
+    const std::vector<NodeStats>& nodes() const { return nodes_; }
+
+    // Evaluated nodes, slowest first, with a total row.
+    void print_summary(std::ostream& os) const;
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto): one complete
+    // ("X") event per evaluation, one track per thread.
+    void write_trace(std::ostream& os) const;
+
+private:
+    struct Event {
+        int id;
+        int tid;
+        double ts_us, dur_us; // relative to start()
+    };
+
+    const loc::ir::Graph* g_ = nullptr;
+    Clock::time_point origin_;
+    std::vector<NodeStats> nodes_;
+    std::vector<Event> events_;
+    std::mutex mu_;
+};
+
+} // namespace loc::rt
@@ -0,0 +1,71 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+#include "loc/runtime/registry.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace loc::rt {
+
+// Compiled-program cache (CLI `--cache-dir=`, env `LOC_CACHE_DIR`): a
+// program's optimized IR and its operators, so a repeat run skips parsing,
+// lowering and the passes. An entry is keyed by program_cache_key() and
+// stored as
+//
+//   <dir>/<key>.locir    header, operator table, the graph (ir/serialize.hpp)
+//   <dir>/<key>.<i>.bin  operator i if it is a literal, dense (matrix_file.hpp)
+//
+// so literal operators are mapped, not parsed, on a hit; load() operators
+// are read from their own files as usual. The passes see the source and
+// each operator's shape and structure only, so an entry is used only if
+// every operator registers with the shape it was compiled against: an
+// edited load() file that changes any of those misses.
+//
+// Files are written under temporary names and renamed into place, the
+// .locir last, so concurrent runs see a complete entry or none.
+constexpr std::uint32_t kProgramCacheVersion = 1; // bump when the IR or a pass's output changes
+
+// How an operator declaration got its matrix, in declaration order.
+struct CachedOperator {
+    enum class Source : std::uint8_t { Literal, File, Default };
+    std::string name;
+    Source source = Source::Literal;
+    std::string path; // File: as written in load(), see operator_path()
+};
+
+// load("f") paths are relative to the source file's directory (`base_dir`,
+// with a trailing slash, or empty) unless absolute.
+std::string operator_path(const std::string& base_dir, const std::string& path);
+
+// Hash of the source text, the pass pipeline (e.g. PassManager::pipeline())
+// and kProgramCacheVersion.
+std::uint64_t program_cache_key(const std::string& source, const std::string& pipeline);
+
+class ProgramCache {
+public:
+    explicit ProgramCache(std::string dir) : dir_(std::move(dir)) {}
+    const std::string& dir() const { return dir_; }
+
+    // On a hit, registers the entry's operators in `reg` (load() paths
+    // resolved against `base_dir`) and returns its graph. Returns nullopt
+    // if there is no usable entry: missing, malformed, or an operator that
+    // no longer loads or changed shape; `reg` may then hold some of the
+    // operators.
+    std::optional<loc::ir::Graph> load(std::uint64_t key, const std::string& base_dir, Registry& reg) const;
+
+    // Writes the entry for `key`; literal operators are read from `reg`.
+    // Returns false if it could not be written (the cache is best-effort:
+    // nothing is left half-written under the entry's name).
+    bool store(std::uint64_t key, const loc::ir::Graph& g,
+               const std::vector<CachedOperator>& ops, const Registry& reg) const;
+
+private:
+    std::string dir_;
+
+    std::string entry_path(std::uint64_t key) const;
+    std::string operator_file(std::uint64_t key, std::size_t i) const;
+};
+
+} // namespace loc::rt
@@ -1,18 +1,44 @@
 #pragma once
+#include "loc/ir/graph.hpp"
 #include "loc/runtime/matrix.hpp"
+#include "loc/runtime/sparse.hpp"
+#include "loc/runtime/structure.hpp"
 #include <string>
 #include <unordered_map>
 
 namespace loc::rt {
 
-// Minimal operator registry: name -> Matrix
+// Minimal operator registry: name -> Matrix (held as a shared, immutable
+// buffer) and its structure, detected once when the operator is set.
+//
+// An operator that is mostly zeros (see sparsify()) is stored in sparse
+// form only, with structure Sparse; get() / get_shared() are for dense
+// operators, get_sparse() for sparse ones.
 class Registry {
 public:
     void set(std::string name, Matrix m);
+    void set_shared(std::string name, MatrixPtr m); // e.g. a mapped file view
+    void set_sparse(std::string name, SparsePtr m);
+    // The operator file at `path` (matrix_file.hpp): a sparse file is set
+    // with set_sparse(), a dense one mapped and set with set_shared().
+    void load(std::string name, const std::string& path);
     const Matrix& get(const std::string& name) const;
+    MatrixPtr get_shared(const std::string& name) const; // zero-copy
+    SparsePtr get_sparse(const std::string& name) const; // null if dense
+    const StructuredOp& structure(const std::string& name) const;
+    // Dimensions and structure (Sparse: scale is the density), as the IR
+    // passes see them.
+    loc::ir::Shape shape(const std::string& name) const;
 
 private:
-    std::unordered_map<std::string, Matrix> ops_;
+    struct Entry {
+        MatrixPtr m;
+        SparsePtr sp;
+        StructuredOp s;
+    };
+    std::unordered_map<std::string, Entry> ops_;
+
+    const Entry& find(const std::string& name) const;
 };
 
 } // namespace loc::rt
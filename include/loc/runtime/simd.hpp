@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace loc::rt::simd {
+
+// Instruction sets the elementwise kernels are compiled for. The best one the
+// CPU (and OS) supports is picked once at startup via CPUID; `LOC_SIMD` or
+// `--simd=` can lower it for benchmarking, never raise it past the hardware.
+// AVX2 implies FMA (the GEMM microkernels use it); AVX-512 is AVX-512F.
+enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+Isa detected_isa();      // what the hardware supports
+Isa active_isa();        // what the kernels currently dispatch to
+void set_isa(Isa isa);   // clamped to detected_isa()
+
+bool parse_isa(const std::string& s, Isa& out);
+const char* isa_name(Isa isa);
+
+// Outputs of at least this many elements are written with non-temporal
+// (streaming) stores: they will not fit in cache anyway, and bypassing it
+// avoids the read-for-ownership traffic on the destination.
+constexpr std::size_t kStreamMinElems = std::size_t(1) << 19; // 4 MiB of doubles
+
+// Elementwise kernels over contiguous buffers. `out` may alias `x` or `y`.
+void add(const double* x, const double* y, double* out, std::size_t n);           // x + y
+void scale(double a, const double* x, double* out, std::size_t n);                // a * x
+void axpby(double a, const double* x, double b, const double* y,
+           double* out, std::size_t n);                                           // a*x + b*y
+
+// The same over floats (MatrixF32), with the same dispatch.
+void add(const float* x, const float* y, float* out, std::size_t n);
+void scale(float a, const float* x, float* out, std::size_t n);
+void axpby(float a, const float* x, float b, const float* y, float* out, std::size_t n);
+
+// out = sum_i coeffs[i] * xs[i] over k >= 1 inputs, in one sweep: the sum is
+// built block by block in an L1-resident tile, so each input is read once and
+// `out` written once. Terms accumulate left to right, so a left-deep chain of
+// add / scale gives the same bits fused or not. `out` may alias any input.
+constexpr std::size_t kLinCombBlock = 512; // elements per tile (4 KiB of doubles)
+void lincomb(std::size_t k, const double* coeffs, const double* const* xs,
+             double* out, std::size_t n);
+void lincomb(std::size_t k, const float* coeffs, const float* const* xs,
+             float* out, std::size_t n);
+
+} // namespace loc::rt::simd
@@ -0,0 +1,112 @@
+#pragma once
+#include "loc/runtime/matrix.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace loc::rt {
+
+// Sparse operator in CSR form, with the same nonzeros also kept column-major
+// (CSC) so both sides of a product can be walked in storage order. Column
+// (row) indices are strictly increasing within a row (column) and no stored
+// value is zero. Memory is O(rows + cols + nnz).
+class SparseMatrix {
+public:
+    using Index = std::uint32_t;
+    // Counted in matrix_mem_stats() like dense storage
+    template <class T> using Array = std::vector<T, detail::KernelAllocator<T>>;
+
+    SparseMatrix() = default;
+    // Adopts CSR arrays (row_ptr has rows + 1 entries) and builds the CSC
+    // copy. Throws std::runtime_error if they are inconsistent.
+    SparseMatrix(std::size_t rows, std::size_t cols, Array<std::size_t> row_ptr,
+                 Array<Index> col_idx, Array<double> values);
+
+    // The nonzeros of `m` (exact zeros are dropped).
+    static SparseMatrix from_dense(const Matrix& m);
+    Matrix to_dense() const;
+    // a' in O(nnz): its CSR arrays are this matrix's CSC copy.
+    SparseMatrix transposed() const;
+
+    std::size_t rows() const { return r_; }
+    std::size_t cols() const { return c_; }
+    std::size_t nnz() const { return val_.size(); }
+    double density() const { return r_ && c_ ? (double)nnz() / ((double)r_ * (double)c_) : 0.0; }
+    std::size_t bytes() const; // storage of both layouts
+
+    // CSR: row i holds col_idx / values [row_ptr[i], row_ptr[i + 1])
+    const Array<std::size_t>& row_ptr() const { return row_ptr_; }
+    const Array<Index>& col_idx() const { return col_idx_; }
+    const Array<double>& values() const { return val_; }
+
+    // CSC: column j holds row_idx / col_values [col_ptr[j], col_ptr[j + 1])
+    const Array<std::size_t>& col_ptr() const { return col_ptr_; }
+    const Array<Index>& row_idx() const { return row_idx_; }
+    const Array<double>& col_values() const { return cval_; }
+
+private:
+    std::size_t r_ = 0, c_ = 0;
+    Array<std::size_t> row_ptr_;
+    Array<Index> col_idx_;
+    Array<double> val_;
+    Array<std::size_t> col_ptr_;
+    Array<Index> row_idx_;
+    Array<double> cval_;
+};
+
+using SparsePtr = std::shared_ptr<const SparseMatrix>;
+
+// ---------- Density policy ----------
+//
+// A value is kept sparse while at most this fraction of its entries are
+// nonzero: operators registered dense (literals, load()) with at least
+// kSparseMinElems entries are converted when they qualify, and a sparse
+// product or sum that fills in past it is converted back to dense.
+// Default: LOC_SPARSE_MAX_DENSITY, else kSparseMaxDensityDefault; 0 turns
+// sparse storage off for dense-registered operators.
+constexpr double kSparseMaxDensityDefault = 0.05;
+constexpr std::size_t kSparseMinElems = 64 * 64;
+void set_sparse_max_density(double d);
+double sparse_max_density();
+
+// `m` in sparse form if the policy above says it should be, else null.
+// Scanning stops once too many nonzeros are seen, so a dense matrix costs
+// about max_density of a pass.
+SparsePtr sparsify(const Matrix& m);
+
+// ---------- Kernels ----------
+//
+// Each sums a row's products in increasing k, as the dense kernels do
+// (skipping the zero terms), and runs rows / columns of the output on the
+// thread pool when the work is large enough.
+
+// out = alpha * (a @ b) + beta * c, sparse a. `c` may be null (beta
+// ignored) or alias `out`; `out` must not alias `b`. O(nnz(a) * b.cols).
+void spmm_into(double alpha, const SparseMatrix& a, const Matrix& b,
+               double beta, const Matrix* c, Matrix& out);
+
+// out = alpha * (a @ b) + beta * c, sparse b (walked by columns).
+// O(a.rows * nnz(b)).
+void dense_spmm_into(double alpha, const Matrix& a, const SparseMatrix& b,
+                     double beta, const Matrix* c, Matrix& out);
+
+// alpha * (a @ b), both sparse (Gustavson's row-by-row algorithm). Work is
+// proportional to the multiply-adds, memory to the result's nonzeros.
+SparseMatrix spgemm(double alpha, const SparseMatrix& a, const SparseMatrix& b);
+
+// sum_i coeffs[i] * xs[i], all sparse with one shape; entries that cancel
+// to zero are dropped.
+SparseMatrix sparse_lincomb(const std::vector<double>& coeffs,
+                            const std::vector<const SparseMatrix*>& xs);
+
+// out = a^k by repeated squaring with spgemm (k = 0: the identity).
+// Returns false, leaving `out` alone, as soon as a power it forms has more
+// than max_density nonzeros; the caller then finishes dense.
+bool sparse_power(const SparseMatrix& a, std::uint64_t k, double max_density, SparseMatrix& out);
+
+// out += coeff * s over s's nonzeros (O(nnz)).
+void sparse_axpy(double coeff, const SparseMatrix& s, Matrix& out);
+
+} // namespace loc::rt
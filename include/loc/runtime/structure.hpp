@@ -0,0 +1,41 @@
+#pragma once
+#include "loc/ir/graph.hpp"
+#include "loc/runtime/matrix.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace loc::rt {
+
+using loc::ir::Structure;
+
+// An operator's detected structure plus what its kernels need. The dense
+// matrix stays in the registry as well; these are an alternative way to
+// apply it.
+struct StructuredOp {
+    Structure kind = Structure::Dense;
+    double scale = 1.0;              // ScaledIdentity
+    std::vector<double> diag;        // Diagonal: entry (i, i)
+    std::vector<std::size_t> perm;   // Permutation: row i has its 1 in column perm[i]
+    std::vector<std::size_t> inv;    // Permutation: column j has its 1 in row inv[j]
+};
+
+// Classifies `m`: Zero (any shape); for square matrices Identity,
+// ScaledIdentity, Diagonal or Permutation (entries exactly 0 and 1); else
+// Dense. Stops at the first row with two nonzeros, so a dense matrix costs
+// about one row.
+StructuredOp detect_structure(const Matrix& m);
+
+// out = alpha * (a @ b) + beta * c, as gemm_into, where `sa` / `sb`
+// describe a / b (null or Dense = dense) and at least one is structured.
+// O(rows * cols) instead of O(m * n * k). `c` may be null (beta ignored)
+// or alias `out`; `out` must not alias `a` or `b`.
+void structured_gemm_into(double alpha, const Matrix& a, const StructuredOp* sa,
+                          const Matrix& b, const StructuredOp* sb,
+                          double beta, const Matrix* c, Matrix& out);
+
+// out += coeff * S for a structured S of out's shape: touches only S's
+// nonzeros (O(n)).
+void structured_axpy(double coeff, const StructuredOp& s, Matrix& out);
+
+} // namespace loc::rt
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace loc::rt {
+
+// Persistent work-stealing pool owned by the runtime.
+//
+// A pool of size N runs N-1 worker threads; the thread that calls
+// parallel_for() / help_until() works too, so N is the total parallelism.
+// N == 1 means everything runs inline on the caller.
+//
+// Each worker owns a deque: tasks it submits go to the back and it pops from
+// the back (LIFO, cache-warm), idle workers steal from the front of others'
+// deques. Tasks submitted from outside the pool go to a shared inject queue.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(std::size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t size() const { return workers_.size() + 1; }
+
+    // Fire-and-forget task (inline if there are no workers).
+    void submit(Task task);
+
+    // Runs f(i) for every i in [0, n) and returns when all calls finished.
+    // Indices are claimed dynamically, the caller included, so it is safe to
+    // call from inside a pool task. The first exception thrown is rethrown.
+    void parallel_for(std::size_t n, const std::function<void(std::size_t)>& f);
+
+    // Runs queued tasks on the calling thread until done() holds. done() is
+    // re-checked whenever a task finishes anywhere in the pool.
+    void help_until(const std::function<bool()>& done);
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<Task> tasks;
+    };
+
+    void worker_loop(std::size_t self);
+    bool pop_local(std::size_t self, Task& out);
+    bool pop_any(std::size_t self, Task& out); // inject queue, then steal
+    void run_task(Task& t);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Queue>> local_;   // one per worker
+    Queue inject_;
+
+    std::mutex mu_;                 // guards sleeping/waking
+    std::condition_variable cv_;    // workers: new task or stop
+    std::condition_variable done_cv_; // helpers: some task finished
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<int> helpers_waiting_{0};
+    bool stop_ = false;
+};
+
+// Upper bound on the runtime pool's size: kMaxThreadsPerCore threads per
+// hardware thread, at least kMaxThreadsFloor. Oversubscribing further only
+// costs thread creation and contention.
+inline constexpr std::size_t kMaxThreadsPerCore = 4;
+inline constexpr std::size_t kMaxThreadsFloor = 16;
+std::size_t max_num_threads();
+
+// Thread count from LOC_NUM_THREADS (clamped to max_num_threads()), else
+// std::thread::hardware_concurrency().
+std::size_t default_num_threads();
+
+// Runtime-wide pool. set_num_threads() replaces it, with n clamped to
+// [1, max_num_threads()]; call it before any work is in flight (e.g. from
+// option parsing).
+ThreadPool& global_pool();
+void set_num_threads(std::size_t n);
+std::size_t num_threads();
+
+} // namespace loc::rt
@@ -11,6 +11,8 @@
 }
 
 %{
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -21,33 +23,65 @@
 // Flex interface
 int yylex(void);
 void yyerror(const char* s);
+extern int yylineno;
+
+// Statements remember their source line for compile-time diagnostics.
+static loc::ast::Node* at_line(loc::ast::Stmt* s) {
+    s->line = yylineno;
+    return s;
+}
+
+// Ends the row being appended to `m`: the first row fixes the column
+// count, later rows must match it.
+static bool close_row(loc::ast::MatrixLiteral* m) {
+    const std::size_t n = m->values.size() - m->rows * m->cols;
+    if (m->rows == 0) m->cols = n;
+    else if (n != m->cols) {
+        std::cerr << "Parse error at line " << yylineno << ": non-rectangular matrix literal (row "
+                  << m->rows + 1 << " has " << n << " values, expected " << m->cols << ")" << std::endl;
+        return false;
+    }
+    ++m->rows;
+    return true;
+}
+
+// Matrix powers take a non-negative whole exponent.
+static bool exponent_of(double k, std::uint64_t& out) {
+    if (!(k >= 0.0) || k != std::floor(k) || k >= 18446744073709551616.0) {
+        std::cerr << "Parse error at line " << yylineno << ": exponent must be a non-negative integer, got "
+                  << k << std::endl;
+        return false;
+    }
+    out = (std::uint64_t)k;
+    return true;
+}
 
 // Expose the parsed AST program to main()
 loc::ast::Program* g_program = nullptr;
 %}
 
 %union {
-    char* str;                            // IDENT
+    char* str;                            // IDENT, STRING
     double num;                           // NUMBER
     loc::ast::Node* node;                 // Expr/Stmt as Node*
     loc::ast::Program* prog;              // Program*
 
-    loc::ast::MatrixLiteral* mat;         // matrix literal
-    std::vector<double>* drow;            // one row: [1,2,3]
-    std::vector<std::vector<double>>* drows; // rows: [[...],[...]]
+    loc::ast::MatrixLiteral* mat;         // matrix literal (possibly still open)
 }
 
 %token OPERATOR
 %token PRINT
-%token <str> IDENT
+%token LOAD
+%token APPLY
+%token TRANSPOSE
+%token <str> IDENT STRING
 %token <num> NUMBER
 
 %type <node> stmt expr
 %type <prog> program
 
-%type <mat>  matrix_lit
-%type <drows> rows
-%type <drow> row number_list
+%type <mat>  matrix_lit elems
+%destructor { delete $$; } <mat>
 
 %start program
 
@@ -55,6 +89,8 @@ loc::ast::Program* g_program = nullptr;
 %left '+'
 %left '@'
 %left '*'
+%left '^'
+%left '\''
 
 %%
 
@@ -75,25 +111,29 @@ program:
 stmt:
       OPERATOR IDENT ';'
       {
-        $$ = new loc::ast::OperatorDecl($2);
+        $$ = at_line(new loc::ast::OperatorDecl($2));
         free($2);
       }
     | OPERATOR IDENT '=' matrix_lit ';'
       {
-        loc::ast::MatrixLiteral m = std::move(*$4);
+        $$ = at_line(new loc::ast::OperatorDecl($2, std::move(*$4)));
         delete $4;
-
-        $$ = new loc::ast::OperatorDecl($2, std::move(m));
         free($2);
       }
+    | OPERATOR IDENT '=' LOAD '(' STRING ')' ';'
+      {
+        $$ = at_line(loc::ast::OperatorDecl::load($2, $6).release());
+        free($2);
+        free($6);
+      }
     | IDENT '=' expr ';'
       {
-        $$ = new loc::ast::AssignStmt($1, loc::ast::NodePtr($3));
+        $$ = at_line(new loc::ast::AssignStmt($1, loc::ast::NodePtr($3)));
         free($1);
       }
     | PRINT expr ';'
       {
-        $$ = new loc::ast::PrintStmt(loc::ast::NodePtr($2));
+        $$ = at_line(new loc::ast::PrintStmt(loc::ast::NodePtr($2)));
       }
     ;
 
@@ -119,59 +159,57 @@ expr:
       {
         $$ = new loc::ast::ScalarMulExpr($1, loc::ast::NodePtr($3));
       }
-    ;
-
-matrix_lit:
-      '[' rows ']'
+    | expr '^' NUMBER
       {
-        auto* m = new loc::ast::MatrixLiteral();
-        m->rows = std::move(*$2);
-        delete $2;
-        $$ = m;
+        std::uint64_t k;
+        if (!exponent_of($3, k)) { delete $1; YYABORT; }
+        $$ = new loc::ast::PowExpr(loc::ast::NodePtr($1), k);
       }
-    ;
-
-rows:
-      row
+    | expr '\''
       {
-        auto* rs = new std::vector<std::vector<double>>();
-        rs->push_back(std::move(*$1));
-        delete $1;
-        $$ = rs;
+        $$ = new loc::ast::TransposeExpr(loc::ast::NodePtr($1));
       }
-    | rows ',' row
+    | TRANSPOSE '(' expr ')'
       {
-        $1->push_back(std::move(*$3));
-        delete $3;
-        $$ = $1;
+        $$ = new loc::ast::TransposeExpr(loc::ast::NodePtr($3));
+      }
+    | APPLY '(' expr ',' expr ')'
+      {
+        $$ = new loc::ast::ApplyExpr(loc::ast::NodePtr($3), loc::ast::NodePtr($5));
       }
     ;
 
-row:
-      '[' number_list ']'
+// Numbers are appended straight to one flat row-major buffer as they are
+// reduced; each ']' that ends a row checks it against the first.
+matrix_lit:
+      elems ']' ']'
       {
-        $$ = $2;
+        if (!close_row($1)) { delete $1; YYABORT; }
+        $$ = $1;
       }
     ;
 
-number_list:
-      NUMBER
+elems:
+      '[' '[' NUMBER
+      {
+        $$ = new loc::ast::MatrixLiteral();
+        $$->values.push_back($3);
+      }
+    | elems ',' NUMBER
       {
-        auto* r = new std::vector<double>();
-        r->push_back($1);
-        $$ = r;
+        $1->values.push_back($3);
+        $$ = $1;
       }
-    | number_list ',' NUMBER
+    | elems ']' ',' '[' NUMBER
       {
-        $1->push_back($3);
+        if (!close_row($1)) { delete $1; YYABORT; }
+        $1->values.push_back($5);
         $$ = $1;
       }
     ;
 
 %%
 
-extern int yylineno;
-
 void yyerror(const char* s) {
     std::cerr << "Parse error at line " << yylineno << ": " << s << std::endl;
 }
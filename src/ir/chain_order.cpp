@@ -0,0 +1,272 @@
+#include "loc/ir/passes/chain_order.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace loc::ir::passes {
+
+namespace {
+
+struct ChainBuilder {
+    // Longest chain the matrix-chain DP runs on whole (O(k^3) time, O(k^2)
+    // tables); longer ones are ordered window by window.
+    static constexpr std::size_t kMaxDp = 256;
+
+    const Graph& in;
+    Graph out;
+
+    std::vector<int> uses; // consumer edges + statements, per input node
+    std::unordered_map<int, int> memo;
+
+    explicit ChainBuilder(const Graph& g) : in(g) {
+        uses.assign(in.nodes.size(), 0);
+        for (const auto& n : in.nodes) {
+            for (int v : n.inputs) {
+                if (v >= 0 && v < (int)uses.size()) ++uses[v];
+            }
+        }
+        for (const auto& st : in.program) {
+            if (st.value >= 0 && st.value < (int)uses.size()) ++uses[st.value];
+        }
+    }
+
+    // A structured operator (diagonal, permutation, ...) scales or moves
+    // whole rows / columns of its co-factor: one multiply per output element.
+    bool structured(int out_id) const {
+        if (out_id < 0) return false;
+        const Node& n = out.nodes[out_id];
+        return n.kind == NodeKind::Op && n.structure != Structure::Dense &&
+               n.structure != Structure::Sparse;
+    }
+
+    // A sparse operator factor only does its nonzeros' share of the
+    // multiply-adds.
+    double density(int out_id) const {
+        if (out_id < 0) return 1.0;
+        const Node& n = out.nodes[out_id];
+        return n.kind == NodeKind::Op && n.structure == Structure::Sparse ? n.scalar : 1.0;
+    }
+
+    // Multiply-adds of l @ r, an m x k by k x n product.
+    std::uint64_t product_cost(int l, int r, std::uint64_t m, std::uint64_t k, std::uint64_t n) const {
+        if (structured(l) || structured(r)) return m * n;
+        const double d = density(l) * density(r);
+        if (d == 1.0) return m * k * n;
+        return std::max<std::uint64_t>(1, (std::uint64_t)(d * (double)m * (double)k * (double)n));
+    }
+
+    // Multiply-adds of x^k by repeated squaring (x is n x n): the first
+    // product reads x itself, the rest only dense powers of it.
+    std::uint64_t pow_cost(int x, std::uint64_t n, std::uint64_t k) const {
+        const std::uint64_t products = pow_products(k);
+        if (!products) return 0;
+        return product_cost(x, x, n, n, n) + (products - 1) * product_cost(-1, -1, n, n, n);
+    }
+
+    int emit(Node n) {
+        n.cost = 0;
+        if (n.kind == NodeKind::Compose && n.rows) {
+            const Node& l = out.nodes[n.inputs[0]];
+            n.cost = product_cost(n.inputs[0], n.inputs[1], l.rows, l.cols, n.cols);
+        } else if (n.kind == NodeKind::Pow && n.rows) {
+            n.cost = pow_cost(n.inputs[0], n.rows, n.exponent);
+        }
+        return out.add_node(std::move(n));
+    }
+
+    // Interior chain nodes are folded into their consumer's chain.
+    bool interior(int id) const {
+        return in.nodes[id].kind == NodeKind::Compose && uses[id] == 1;
+    }
+
+    // Iterative: a chain may be as deep as it is long.
+    void flatten(int id, std::vector<int>& operands) const {
+        std::vector<int> stack{id};
+        while (!stack.empty()) {
+            const int v = stack.back();
+            stack.pop_back();
+            if (v != id && !interior(v)) {
+                operands.push_back(v);
+                continue;
+            }
+            const auto& ins = in.nodes[v].inputs;
+            for (auto it = ins.rbegin(); it != ins.rend(); ++it) stack.push_back(*it);
+        }
+    }
+
+    int build(int id) {
+        if (id < 0 || id >= (int)in.nodes.size()) {
+            throw std::runtime_error("chain_order: invalid node id");
+        }
+        if (auto it = memo.find(id); it != memo.end()) return it->second;
+
+        const Node& n = in.nodes[id];
+        int out_id = -1;
+
+        if (n.kind == NodeKind::Compose) {
+            std::vector<int> operands;
+            flatten(id, operands);
+            for (int& v : operands) v = build(v);
+            out_id = build_chain(operands, n.line);
+        } else {
+            Node nn = n;
+            for (int& v : nn.inputs) v = build(v);
+            out_id = emit(std::move(nn));
+        }
+
+        memo[id] = out_id;
+        return out_id;
+    }
+
+    // Operands are output-graph ids, in chain order; new products inherit
+    // the chain's source line.
+    int build_chain(std::vector<int> ops, int line) {
+        std::size_t k = ops.size();
+
+        // Dimensions p[0..k]: operand i is p[i] x p[i+1]
+        std::vector<std::uint64_t> p(k + 1);
+        bool known = true;
+        for (std::size_t i = 0; i < k && known; ++i) {
+            const Node& s = out.nodes[ops[i]];
+            if (!s.rows || (i > 0 && p[i] != s.rows)) known = false;
+            p[i] = s.rows;
+            p[i + 1] = s.cols;
+        }
+        if (!known || k < 3) return left_to_right(ops, line);
+
+        if (fold_powers(ops, p, line)) {
+            k = ops.size();
+            if (k < 3) return left_to_right(ops, line);
+        }
+
+        // Longer chains: the DP over windows of kMaxDp operands, then over
+        // their products; O(k kMaxDp^2) time instead of O(k^3)
+        if (k > kMaxDp) {
+            std::vector<int> parts;
+            for (std::size_t i = 0; i < k; i += kMaxDp) {
+                parts.push_back(build_chain({ops.begin() + i, ops.begin() + std::min(k, i + kMaxDp)}, line));
+            }
+            return build_chain(std::move(parts), line);
+        }
+
+        // cost[i][j]: cheapest product of operands i..j; split[i][j]: last
+        // operand of its left factor.
+        std::vector<std::vector<std::uint64_t>> cost(k, std::vector<std::uint64_t>(k, 0));
+        std::vector<std::vector<std::size_t>> split(k, std::vector<std::size_t>(k, 0));
+        for (std::size_t len = 2; len <= k; ++len) {
+            for (std::size_t i = 0; i + len <= k; ++i) {
+                const std::size_t j = i + len - 1;
+                cost[i][j] = std::numeric_limits<std::uint64_t>::max();
+                // Right-to-left with strict '<': ties favor the left-deep tree
+                for (std::size_t s = j; s-- > i;) {
+                    // Only a single-operand factor can be an operator (-1:
+                    // a product, dense)
+                    const int l = s == i ? ops[i] : -1;
+                    const int r = s + 1 == j ? ops[j] : -1;
+                    const std::uint64_t c = cost[i][s] + cost[s + 1][j] +
+                                            product_cost(l, r, p[i], p[s + 1], p[j + 1]);
+                    if (c < cost[i][j]) {
+                        cost[i][j] = c;
+                        split[i][j] = s;
+                    }
+                }
+            }
+        }
+        return emit_range(ops, split, 0, k - 1, line);
+    }
+
+    // Replaces each run of one square operand (ops[i..j], n x n) by a Pow
+    // node when repeated squaring beats both multiplying the run out and
+    // applying it factor by factor to the chain's thinner end (m columns),
+    // as for A @ A @ A @ v. One linear scan, ahead of the DP; updates `p`.
+    // Returns whether anything was folded.
+    bool fold_powers(std::vector<int>& ops, std::vector<std::uint64_t>& p, int line) {
+        const std::size_t k = ops.size();
+        const std::uint64_t m = std::min(p[0], p[k]);
+        std::vector<int> folded;
+        std::vector<std::uint64_t> q{p[0]};
+        for (std::size_t i = 0, j; i < k; i = j) {
+            for (j = i + 1; j < k && ops[j] == ops[i]; ++j) {}
+            const std::uint64_t r = j - i, n = p[i];
+            if (r > 1 && p[i] == p[i + 1]) {
+                const int x = ops[i];
+                const std::uint64_t powered = pow_cost(x, n, r);
+                const std::uint64_t chain = product_cost(x, x, n, n, n) + (r - 2) * product_cost(-1, x, n, n, n);
+                const std::uint64_t applied = r * product_cost(x, -1, n, n, m);
+                if (powered < chain && powered + product_cost(-1, -1, n, n, m) < applied) {
+                    folded.push_back(emit_pow(x, r, line));
+                    q.push_back(n);
+                    continue;
+                }
+            }
+            for (std::size_t t = i; t < j; ++t) {
+                folded.push_back(ops[t]);
+                q.push_back(p[t + 1]);
+            }
+        }
+        if (folded.size() == k) return false;
+        ops = std::move(folded);
+        p = std::move(q);
+        return true;
+    }
+
+    int emit_range(const std::vector<int>& ops,
+                   const std::vector<std::vector<std::size_t>>& split,
+                   std::size_t i, std::size_t j, int line) {
+        if (i == j) return ops[i];
+        const std::size_t s = split[i][j];
+        const int l = emit_range(ops, split, i, s, line);
+        const int r = emit_range(ops, split, s + 1, j, line);
+        return emit_compose(l, r, line);
+    }
+
+    int left_to_right(const std::vector<int>& ops, int line) {
+        int acc = ops[0];
+        for (std::size_t i = 1; i < ops.size(); ++i) acc = emit_compose(acc, ops[i], line);
+        return acc;
+    }
+
+    int emit_pow(int x, std::uint64_t k, int line) {
+        Node n;
+        n.kind = NodeKind::Pow;
+        n.exponent = k;
+        n.inputs = {x};
+        n.line = line;
+        n.rows = out.nodes[x].rows;
+        n.cols = out.nodes[x].cols;
+        return emit(std::move(n));
+    }
+
+    int emit_compose(int l, int r, int line) {
+        const Node& a = out.nodes[l];
+        const Node& b = out.nodes[r];
+        Node n;
+        n.kind = NodeKind::Compose;
+        n.inputs = {l, r};
+        n.line = line;
+        if (a.rows && b.rows && a.cols == b.rows) {
+            n.rows = a.rows;
+            n.cols = b.cols;
+        }
+        return emit(std::move(n));
+    }
+};
+
+} // namespace
+
+void chain_order(Graph& g) {
+    ChainBuilder b(g);
+
+    b.out.program.reserve(g.program.size());
+    for (auto s : g.program) {
+        s.value = b.build(s.value);
+        b.out.program.push_back(std::move(s));
+    }
+
+    g = std::move(b.out);
+}
+
+} // namespace loc::ir::passes
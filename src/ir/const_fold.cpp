@@ -1,120 +1,203 @@
 #include "loc/ir/passes/const_fold.hpp"
 
-#include <unordered_map>
-#include <sstream>
-#include <iomanip>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 #include <stdexcept>
+#include <vector>
 
 namespace loc::ir::passes {
 
 // static bool is_zero(double x) { return std::abs(x) < 1e-12; }
 static bool is_one(double x)  { return std::abs(x - 1.0) < 1e-12; }
 
-// stable scalar string to use in keys
-static std::string scalar_key(double s) {
-    std::ostringstream oss;
-    oss << std::setprecision(17) << s;
-    return oss.str();
+// A node standing for the same value as `src`: every rewrite below keeps the
+// value's shape, so shape and source line carry over.
+static loc::ir::Node derive(const loc::ir::Node& src, loc::ir::NodeKind kind) {
+    loc::ir::Node nn;
+    nn.kind = kind;
+    nn.rows = src.rows;
+    nn.cols = src.cols;
+    nn.line = src.line;
+    return nn;
 }
 
-// Build a structural key for an IR node (after folding inputs).
-static std::string make_key(const loc::ir::Node& n) {
-    std::ostringstream oss;
-    oss << (int)n.kind << "|";
-    if (n.kind == loc::ir::NodeKind::Op) {
-        oss << "name=" << n.name;
-    } else if (n.kind == loc::ir::NodeKind::ScalarMul) {
-        oss << "s=" << scalar_key(n.scalar) << "|";
-        oss << "in=" << (n.inputs.empty() ? -1 : n.inputs[0]);
-    } else {
-        for (size_t i = 0; i < n.inputs.size(); ++i) {
-            oss << n.inputs[i];
-            if (i + 1 < n.inputs.size()) oss << ",";
-        }
+// I or c*I (an operator's detected structure); its factor goes to `s`.
+static bool scaled_identity(const loc::ir::Node& n, double& s) {
+    if (n.kind != loc::ir::NodeKind::Op) return false;
+    if (n.structure == loc::ir::Structure::Identity) { s = 1.0; return true; }
+    if (n.structure == loc::ir::Structure::ScaledIdentity) { s = n.scalar; return true; }
+    return false;
+}
+
+// The all-zero value with `src`'s shape; -1 if that shape is unknown.
+static int zero_like(const loc::ir::Node& src, loc::ir::Graph& out) {
+    if (!src.rows) return -1;
+    return out.intern(derive(src, loc::ir::NodeKind::Zero));
+}
+
+// a * x with `src`'s shape, folded:
+//   1*x -> x,  a*0 -> 0,  0*x -> 0 (shape known),  a*(b*x) -> (a*b)*x
+static int scaled(const loc::ir::Node& src, double a, int x, loc::ir::Graph& out) {
+    if (is_one(a)) return x;
+
+    const loc::ir::Node& xn = out.nodes[x];
+    if (xn.kind == loc::ir::NodeKind::Zero) return x;
+    if (xn.kind == loc::ir::NodeKind::ScalarMul) {
+        a *= xn.scalar;
+        x = xn.inputs[0];
+        if (is_one(a)) return x;
+    }
+    if (a == 0.0) {
+        if (int z = zero_like(src, out); z >= 0) return z;
     }
-    return oss.str();
+
+    loc::ir::Node nn = derive(src, loc::ir::NodeKind::ScalarMul);
+    nn.scalar = a;
+    nn.inputs = { x };
+    return out.intern(std::move(nn));
 }
 
-// Intern node into out-graph using a key-cache (CSE).
-static int intern_node(loc::ir::Graph& out,
-                       std::unordered_map<std::string,int>& intern,
-                       loc::ir::Node node) {
-    std::string k = make_key(node);
-    auto it = intern.find(k);
-    if (it != intern.end()) return it->second;
-    int id = out.add_node(std::move(node));
-    intern[k] = id;
-    return id;
+// x^k with `src`'s shape, folded:
+//   x^1 -> x,  0^k -> 0 and (c*I)^k -> c^k * I (k >= 1),
+//   (a*x)^k -> a^k * x^k,  (x^j)^k -> x^(j*k)
+static int powered(const loc::ir::Node& src, std::uint64_t k, int x, loc::ir::Graph& out) {
+    if (k == 1) return x;
+
+    const loc::ir::Node& xn = out.nodes[x];
+    double c;
+    if (k > 0 && xn.kind == loc::ir::NodeKind::Zero) return x;
+    if (k > 0 && scaled_identity(xn, c)) return scaled(src, std::pow(c, (double)(k - 1)), x, out);
+    if (xn.kind == loc::ir::NodeKind::ScalarMul) {
+        const double a = std::pow(xn.scalar, (double)k);
+        const int y = xn.inputs[0];
+        return scaled(src, a, powered(src, k, y, out), out);
+    }
+    if (xn.kind == loc::ir::NodeKind::Pow &&
+        (xn.exponent == 0 || k <= std::numeric_limits<std::uint64_t>::max() / xn.exponent)) {
+        return powered(src, k * xn.exponent, xn.inputs[0], out);
+    }
+
+    loc::ir::Node nn = derive(src, loc::ir::NodeKind::Pow);
+    nn.exponent = k;
+    nn.inputs = { x };
+    return out.intern(std::move(nn));
 }
 
+// x' (line from `src`), folded:
+//   (x')' -> x,  0' -> 0,  (a*x)' -> a*x',  (x^k)' -> (x')^k,
+//   (l @ r)' -> r' @ l',  and I, c*I and diagonal operators are their own
+//   transpose. What remains is a Transpose of an operator or a sum, and a
+//   product's transposed factors are read in place by GEMM (gemm_epilogue).
+static int transposed(const loc::ir::Node& src, int x, loc::ir::Graph& out) {
+    const loc::ir::Node& xn = out.nodes[x];
+    loc::ir::Node t = derive(src, loc::ir::NodeKind::Transpose);
+    t.rows = xn.cols;
+    t.cols = xn.rows;
+
+    double c;
+    switch (xn.kind) {
+    case loc::ir::NodeKind::Transpose:
+        return xn.inputs[0];
+    case loc::ir::NodeKind::Zero:
+        return zero_like(t, out);
+    case loc::ir::NodeKind::Op:
+        if (scaled_identity(xn, c) || xn.structure == loc::ir::Structure::Diagonal) return x;
+        break;
+    case loc::ir::NodeKind::ScalarMul: {
+        const double a = xn.scalar;
+        return scaled(t, a, transposed(t, xn.inputs[0], out), out);
+    }
+    case loc::ir::NodeKind::Pow: {
+        const std::uint64_t k = xn.exponent;
+        return powered(t, k, transposed(t, xn.inputs[0], out), out);
+    }
+    case loc::ir::NodeKind::Compose: {
+        const int l = xn.inputs[0], r = xn.inputs[1];
+        loc::ir::Node comp = derive(t, loc::ir::NodeKind::Compose);
+        const int rt = transposed(t, r, out);
+        comp.inputs = { rt, transposed(t, l, out) };
+        return out.intern(std::move(comp));
+    }
+    default:
+        break;
+    }
+
+    t.inputs = { x };
+    return out.intern(std::move(t));
+}
+
+// `v` as base^k: a Pow node's operands, else v^1.
+static std::uint64_t as_power(const loc::ir::Graph& out, int v, int& base) {
+    const loc::ir::Node& vn = out.nodes[v];
+    if (vn.kind != loc::ir::NodeKind::Pow) {
+        base = v;
+        return 1;
+    }
+    base = vn.inputs[0];
+    return vn.exponent;
+}
+
+// Folds node `id` of `in` into `out`, which hash-conses every result (CSE).
 static int fold_node(int id,
                      const loc::ir::Graph& in,
                      loc::ir::Graph& out,
-                     std::unordered_map<int,int>& memo,
-                     std::unordered_map<std::string,int>& intern) {
+                     std::vector<int>& memo) {
     if (id < 0) return -1;
-    if (auto it = memo.find(id); it != memo.end()) return it->second;
+    if (memo[id] >= 0) return memo[id];
 
     const auto& n = in.nodes[id];
 
     // ---- Fold recursively depending on kind ----
     if (n.kind == loc::ir::NodeKind::Op) {
-        loc::ir::Node nn;
-        nn.kind = loc::ir::NodeKind::Op;
-        nn.name = n.name;
-        int out_id = intern_node(out, intern, std::move(nn));
+        // Rule: an all-zero operator is the zero value
+        int out_id = n.structure == loc::ir::Structure::Zero ? zero_like(n, out) : -1;
+        if (out_id < 0) {
+            loc::ir::Node nn = derive(n, loc::ir::NodeKind::Op);
+            nn.name = n.name;
+            nn.structure = n.structure;
+            nn.scalar = n.scalar;
+            out_id = out.intern(std::move(nn));
+        }
         memo[id] = out_id;
         return out_id;
     }
 
-    if (n.kind == loc::ir::NodeKind::ScalarMul) {
-        int x = fold_node(n.inputs[0], in, out, memo, intern);
-        double a = n.scalar;
-
-        // Rule: 1*x -> x
-        if (is_one(a)) {
-            memo[id] = x;
-            return x;
-        }
-
-        // Rule: a*(b*x) -> (a*b)*x
-        const auto& xn = out.nodes[x];
-        if (xn.kind == loc::ir::NodeKind::ScalarMul) {
-            double b = xn.scalar;
-            int inner = xn.inputs[0];
-
-            loc::ir::Node nn;
-            nn.kind = loc::ir::NodeKind::ScalarMul;
-            nn.scalar = a * b;
-            nn.inputs = { inner };
-
-            int out_id = intern_node(out, intern, std::move(nn));
-            memo[id] = out_id;
-            return out_id;
-        }
+    if (n.kind == loc::ir::NodeKind::Zero) {
+        int out_id = out.intern(derive(n, loc::ir::NodeKind::Zero));
+        memo[id] = out_id;
+        return out_id;
+    }
 
-        loc::ir::Node nn;
-        nn.kind = loc::ir::NodeKind::ScalarMul;
-        nn.scalar = a;
-        nn.inputs = { x };
+    if (n.kind == loc::ir::NodeKind::ScalarMul) {
+        int x = fold_node(n.inputs[0], in, out, memo);
 
-        int out_id = intern_node(out, intern, std::move(nn));
+        // Rules: 1*x -> x, 0*x -> 0, a*(b*x) -> (a*b)*x
+        int out_id = scaled(n, n.scalar, x, out);
         memo[id] = out_id;
         return out_id;
     }
 
     if (n.kind == loc::ir::NodeKind::Add) {
-        int a = fold_node(n.inputs[0], in, out, memo, intern);
-        int b = fold_node(n.inputs[1], in, out, memo, intern);
+        int a = fold_node(n.inputs[0], in, out, memo);
+        int b = fold_node(n.inputs[1], in, out, memo);
+
+        // Rule: x + 0 -> x, 0 + x -> x
+        if (out.nodes[b].kind == loc::ir::NodeKind::Zero) {
+            memo[id] = a;
+            return a;
+        }
+        if (out.nodes[a].kind == loc::ir::NodeKind::Zero) {
+            memo[id] = b;
+            return b;
+        }
 
         // Rule: x + x -> 2*x
         if (a == b) {
-            loc::ir::Node nn;
-            nn.kind = loc::ir::NodeKind::ScalarMul;
+            loc::ir::Node nn = derive(n, loc::ir::NodeKind::ScalarMul);
             nn.scalar = 2.0;
             nn.inputs = { a };
-            int out_id = intern_node(out, intern, std::move(nn));
+            int out_id = out.intern(std::move(nn));
             memo[id] = out_id;
             return out_id;
         }
@@ -131,11 +214,10 @@ static int fold_node(int id,
         double sa, sb;
         int xa, xb;
         if (is_smul(a, sa, xa) && is_smul(b, sb, xb) && xa == xb) {
-            loc::ir::Node nn;
-            nn.kind = loc::ir::NodeKind::ScalarMul;
+            loc::ir::Node nn = derive(n, loc::ir::NodeKind::ScalarMul);
             nn.scalar = sa + sb;
             nn.inputs = { xa };
-            int out_id = intern_node(out, intern, std::move(nn));
+            int out_id = out.intern(std::move(nn));
             memo[id] = out_id;
             return out_id;
         }
@@ -143,17 +225,25 @@ static int fold_node(int id,
         // Canonical order for better CSE: keep inputs sorted by id
         if (b < a) std::swap(a, b);
 
-        loc::ir::Node nn;
-        nn.kind = loc::ir::NodeKind::Add;
+        loc::ir::Node nn = derive(n, loc::ir::NodeKind::Add);
         nn.inputs = { a, b };
-        int out_id = intern_node(out, intern, std::move(nn));
+        int out_id = out.intern(std::move(nn));
         memo[id] = out_id;
         return out_id;
     }
 
     if (n.kind == loc::ir::NodeKind::Compose) {
-        int L = fold_node(n.inputs[0], in, out, memo, intern);
-        int R = fold_node(n.inputs[1], in, out, memo, intern);
+        int L = fold_node(n.inputs[0], in, out, memo);
+        int R = fold_node(n.inputs[1], in, out, memo);
+
+        // Rule: 0 @ x -> 0, x @ 0 -> 0
+        if (out.nodes[L].kind == loc::ir::NodeKind::Zero ||
+            out.nodes[R].kind == loc::ir::NodeKind::Zero) {
+            if (int z = zero_like(n, out); z >= 0) {
+                memo[id] = z;
+                return z;
+            }
+        }
 
         // Pull scalars out of composition:
         // (a*L) @ R -> a*(L@R)
@@ -166,40 +256,49 @@ static int fold_node(int id,
             return true;
         };
 
-        double a, b;
-        int Lin, Rin;
-        bool Ls = peel_scalar(L, a, Lin);
-        bool Rs = peel_scalar(R, b, Rin);
-
-        if (Ls || Rs) {
-            double s = 1.0;
-            if (Ls) { s *= a; L = Lin; }
-            if (Rs) { s *= b; R = Rin; }
-
-            loc::ir::Node comp;
-            comp.kind = loc::ir::NodeKind::Compose;
+        double s = 1.0, a;
+        int inner;
+        if (peel_scalar(L, a, inner)) { s *= a; L = inner; }
+        if (peel_scalar(R, a, inner)) { s *= a; R = inner; }
+
+        // Rule: (c*I) @ x -> c*x, x @ (c*I) -> c*x  (I: detected identity)
+        // Rule: x^i @ x^j -> x^(i+j), once either side is a power (a chain
+        // of plain factors is left to chain_order, which prices the power)
+        int prod, bl, br;
+        const std::uint64_t kl = as_power(out, L, bl), kr = as_power(out, R, br);
+        if (scaled_identity(out.nodes[L], a)) {
+            s *= a;
+            prod = R;
+        } else if (scaled_identity(out.nodes[R], a)) {
+            s *= a;
+            prod = L;
+        } else if (bl == br && (L != bl || R != br)) {
+            prod = powered(n, kl + kr, bl, out);
+        } else {
+            loc::ir::Node comp = derive(n, loc::ir::NodeKind::Compose);
             comp.inputs = { L, R };
-            int comp_id = intern_node(out, intern, std::move(comp));
+            prod = out.intern(std::move(comp));
+        }
 
-            if (is_one(s)) {
-                memo[id] = comp_id;
-                return comp_id;
-            }
+        int out_id = scaled(n, s, prod, out);
+        memo[id] = out_id;
+        return out_id;
+    }
 
-            loc::ir::Node sm;
-            sm.kind = loc::ir::NodeKind::ScalarMul;
-            sm.scalar = s;
-            sm.inputs = { comp_id };
-            int out_id = intern_node(out, intern, std::move(sm));
+    if (n.kind == loc::ir::NodeKind::Pow) {
+        int x = fold_node(n.inputs[0], in, out, memo);
 
-            memo[id] = out_id;
-            return out_id;
-        }
+        // Rules: x^1 -> x, 0^k -> 0, (c*I)^k -> c^k*I, (a*x)^k -> a^k * x^k
+        int out_id = powered(n, n.exponent, x, out);
+        memo[id] = out_id;
+        return out_id;
+    }
+
+    if (n.kind == loc::ir::NodeKind::Transpose) {
+        int x = fold_node(n.inputs[0], in, out, memo);
 
-        loc::ir::Node nn;
-        nn.kind = loc::ir::NodeKind::Compose;
-        nn.inputs = { L, R };
-        int out_id = intern_node(out, intern, std::move(nn));
+        // Rules: (x')' -> x, (l @ r)' -> r' @ l', (a*x)' -> a*x', ...
+        int out_id = transposed(n, x, out);
         memo[id] = out_id;
         return out_id;
     }
@@ -210,15 +309,14 @@ static int fold_node(int id,
 void const_fold(loc::ir::Graph& g) {
     loc::ir::Graph out;
 
-    std::unordered_map<int,int> memo;
-    std::unordered_map<std::string,int> intern;
+    std::vector<int> memo(g.nodes.size(), -1);
 
     // Rebuild program: fold each statement value, but keep statement list.
     // Note: DCE will remove dead assigns afterwards.
     out.program.reserve(g.program.size());
 
     for (auto s : g.program) {
-        int nv = fold_node(s.value, g, out, memo, intern);
+        int nv = fold_node(s.value, g, out, memo);
         s.value = nv;
         out.program.push_back(std::move(s));
     }
@@ -0,0 +1,132 @@
+#include "loc/ir/passes/cse.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace loc::ir::passes {
+
+namespace {
+
+// Sums flattening to more terms than this are numbered structurally only;
+// keeps the pass linear on long accumulation chains.
+constexpr std::size_t kMaxTerms = 64;
+
+using Terms = std::vector<std::pair<int, double>>; // (leaf id, coeff), sorted by leaf
+
+bool is_sum(NodeKind k) {
+    return k == NodeKind::Add || k == NodeKind::ScalarMul || k == NodeKind::LinComb;
+}
+
+struct CseBuilder {
+    const Graph& in;
+    Graph out;
+
+    std::vector<int> memo;    // input id -> output id
+    std::vector<Terms> terms; // output id -> flattened sum (empty: not a sum)
+    InternTable sums;         // hash of terms -> output id
+
+    explicit CseBuilder(const Graph& g) : in(g), memo(g.nodes.size(), -1) {}
+
+    // Adds c * (value of output node v) to acc.
+    void add_terms(int v, double c, Terms& acc) const {
+        if (v < (int)terms.size() && !terms[v].empty()) {
+            for (const auto& [leaf, k] : terms[v]) acc.emplace_back(leaf, c * k);
+        } else {
+            acc.emplace_back(v, c);
+        }
+    }
+
+    // Flattened terms of a sum node over output ids; empty if too large.
+    Terms flatten(const Node& n) const {
+        Terms acc;
+        switch (n.kind) {
+        case NodeKind::Add:
+            add_terms(n.inputs[0], 1.0, acc);
+            add_terms(n.inputs[1], 1.0, acc);
+            break;
+        case NodeKind::ScalarMul:
+            add_terms(n.inputs[0], n.scalar, acc);
+            break;
+        case NodeKind::LinComb:
+            for (std::size_t i = 0; i < n.inputs.size(); ++i) add_terms(n.inputs[i], n.coeffs[i], acc);
+            break;
+        default:
+            break;
+        }
+
+        // Sort by leaf and merge repeats (stable, so coefficients of one
+        // leaf are summed in a fixed order).
+        std::stable_sort(acc.begin(), acc.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        Terms merged;
+        for (const auto& t : acc) {
+            if (!merged.empty() && merged.back().first == t.first) merged.back().second += t.second;
+            else merged.push_back(t);
+        }
+        if (merged.size() > kMaxTerms) merged.clear();
+        return merged;
+    }
+
+    static std::uint64_t hash_terms(const Terms& t) {
+        std::uint64_t h = 0xcbf29ce484222325ULL;
+        for (const auto& [leaf, k] : t) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &k, sizeof bits);
+            h = (h ^ (std::uint64_t)(std::uint32_t)leaf) * 0x100000001b3ULL;
+            h = (h ^ bits) * 0x100000001b3ULL;
+        }
+        return h ^ (h >> 29);
+    }
+
+    int build(int id) {
+        if (id < 0 || id >= (int)in.nodes.size()) {
+            throw std::runtime_error("cse: invalid node id");
+        }
+        if (memo[id] >= 0) return memo[id];
+
+        Node n = in.nodes[id];
+        for (int& v : n.inputs) v = build(v);
+        // IEEE addition is commutative: either operand order gives the same bits
+        if (n.kind == NodeKind::Add && n.inputs[1] < n.inputs[0]) {
+            std::swap(n.inputs[0], n.inputs[1]);
+        }
+
+        // A sum equal to an earlier one up to association / order is that one
+        Terms t;
+        std::uint64_t h = 0;
+        if (is_sum(n.kind)) {
+            t = flatten(n);
+            if (!t.empty()) {
+                h = hash_terms(t);
+                const int hit = sums.find(h, [&](int v) { return terms[v] == t; });
+                if (hit >= 0) return memo[id] = hit;
+            }
+        }
+
+        const std::size_t before = out.nodes.size();
+        const int out_id = out.intern(std::move(n));
+        if (out.nodes.size() > before && !t.empty()) {
+            terms.resize(out.nodes.size());
+            terms[out_id] = std::move(t);
+            sums.insert(h, out_id);
+        }
+        return memo[id] = out_id;
+    }
+};
+
+} // namespace
+
+void cse(Graph& g) {
+    CseBuilder b(g);
+    for (const auto& s : g.program) b.build(s.value);
+
+    b.out.program = g.program;
+    for (auto& s : b.out.program) s.value = b.memo[s.value];
+    g = std::move(b.out);
+}
+
+} // namespace loc::ir::passes
@@ -70,6 +70,7 @@ void dead_code_elim(Graph& g) {
 
     g.nodes = std::move(new_nodes);
     g.program = std::move(new_prog);
+    g.reindex();
 }
 
 } // namespace loc::ir::passes
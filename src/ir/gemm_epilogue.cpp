@@ -0,0 +1,172 @@
+#include "loc/ir/passes/gemm_epilogue.hpp"
+
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace loc::ir::passes {
+
+namespace {
+
+struct EpilogueBuilder {
+    const Graph& in;
+    Graph out;
+
+    std::vector<int> uses; // consumer edges from print-live nodes + prints
+    std::unordered_map<int, int> memo;
+
+    // Only consumers live from a print count: earlier in-place passes
+    // (fusion) leave absorbed nodes behind, still named by assignments,
+    // until dce.
+    explicit EpilogueBuilder(const Graph& g) : in(g) {
+        uses.assign(in.nodes.size(), 0);
+        std::vector<char> live(in.nodes.size(), 0);
+        std::vector<int> stack;
+        for (const auto& s : in.program) {
+            if (s.kind != Graph::Stmt::Kind::Print || s.value < 0) continue;
+            ++uses[s.value];
+            stack.push_back(s.value);
+        }
+        while (!stack.empty()) {
+            const int id = stack.back();
+            stack.pop_back();
+            if (id < 0 || id >= (int)live.size() || live[id]) continue;
+            live[id] = 1;
+            for (int v : in.nodes[id].inputs) {
+                ++uses[v];
+                stack.push_back(v);
+            }
+        }
+    }
+
+    bool foldable(int id) const {
+        return in.nodes[id].kind == NodeKind::Compose && uses[id] == 1;
+    }
+
+    int emit(Node n) { return out.add_node(std::move(n)); }
+
+    // A value the GEMM kernel can read with a stride flag: anything but a
+    // structured or sparse operator, whose kernels take no transpose
+    bool strided(int id) const {
+        const Node& n = in.nodes[id];
+        return n.kind != NodeKind::Op || n.structure == Structure::Dense;
+    }
+
+    int under_transpose(int id) const {
+        const Node& n = in.nodes[id];
+        return n.kind == NodeKind::Transpose ? n.inputs[0] : id;
+    }
+
+    // Product factors of `prod` into `p` (a Compose or Gemm): a Transpose
+    // factor is dropped for the matching trans flag, so the kernel reads
+    // its input in place instead of a transposed copy
+    void set_factors(Node& p, const Node& prod) {
+        const int a = prod.inputs[0], b = prod.inputs[1];
+        const int ua = under_transpose(a), ub = under_transpose(b);
+        const bool absorb = strided(ua) && strided(ub);
+        p.trans_a = prod.trans_a != (absorb && ua != a);
+        p.trans_b = prod.trans_b != (absorb && ub != b);
+        p.inputs = {build(absorb ? ua : a), build(absorb ? ub : b)};
+    }
+
+    // Gemm standing for `src`, from the product node `prod`
+    Node gemm_from(const Node& src, const Node& prod, double alpha) {
+        Node g;
+        g.kind = NodeKind::Gemm;
+        g.alpha = alpha;
+        set_factors(g, prod);
+        g.rows = src.rows;
+        g.cols = src.cols;
+        g.line = src.line;
+        g.cost = prod.cost;
+        return g;
+    }
+
+    int build(int id) {
+        if (id < 0 || id >= (int)in.nodes.size()) {
+            throw std::runtime_error("gemm_epilogue: invalid node id");
+        }
+        if (auto it = memo.find(id); it != memo.end()) return it->second;
+
+        const Node& n = in.nodes[id];
+        int out_id = -1;
+
+        if (n.kind == NodeKind::ScalarMul && foldable(n.inputs[0])) {
+            out_id = emit(gemm_from(n, in.nodes[n.inputs[0]], n.scalar));
+        } else if (n.kind == NodeKind::Add || n.kind == NodeKind::LinComb) {
+            out_id = build_sum(n);
+        } else if (n.kind == NodeKind::Compose) {
+            Node nn = n;
+            set_factors(nn, n);
+            out_id = emit(std::move(nn));
+        } else {
+            Node nn = n;
+            for (int& v : nn.inputs) v = build(v);
+            out_id = emit(std::move(nn));
+        }
+
+        memo[id] = out_id;
+        return out_id;
+    }
+
+    int build_sum(const Node& n) {
+        const std::vector<double> cs =
+            (n.kind == NodeKind::Add) ? std::vector<double>{1.0, 1.0} : n.coeffs;
+        return fold_terms(n, n.inputs, cs);
+    }
+
+    // sum_i cs[i] * terms[i] (input-graph ids) standing for `src`: the first
+    // foldable product becomes a Gemm accumulating onto the rest, which is
+    // folded the same way (so several products chain through their C).
+    int fold_terms(const Node& src, const std::vector<int>& terms,
+                   const std::vector<double>& cs) {
+        std::size_t t = 0;
+        while (t < terms.size() && !foldable(terms[t])) ++t;
+
+        if (t == terms.size()) {
+            Node sum = src; // untouched sums keep their kind (Add / LinComb)
+            if (terms.size() != src.inputs.size()) {
+                sum.kind = NodeKind::LinComb;
+                sum.coeffs = cs;
+            }
+            sum.inputs.clear();
+            for (int v : terms) sum.inputs.push_back(build(v));
+            return emit(std::move(sum));
+        }
+
+        Node g = gemm_from(src, in.nodes[terms[t]], cs[t]);
+
+        std::vector<int> rest;
+        std::vector<double> rest_cs;
+        for (std::size_t i = 0; i < terms.size(); ++i) {
+            if (i == t) continue;
+            rest.push_back(terms[i]);
+            rest_cs.push_back(cs[i]);
+        }
+
+        if (rest.size() == 1) {
+            g.beta = rest_cs[0];
+            g.inputs.push_back(build(rest[0]));
+        } else {
+            g.beta = 1.0;
+            g.inputs.push_back(fold_terms(src, rest, rest_cs));
+        }
+        return emit(std::move(g));
+    }
+};
+
+} // namespace
+
+void fuse_gemm_epilogue(Graph& g) {
+    EpilogueBuilder b(g);
+
+    b.out.program.reserve(g.program.size());
+    for (auto s : g.program) {
+        s.value = b.build(s.value);
+        b.out.program.push_back(std::move(s));
+    }
+
+    g = std::move(b.out);
+}
+
+} // namespace loc::ir::passes
@@ -1,96 +1,342 @@
 #include "loc/ir/lower.hpp"
 
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <unordered_map>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace loc::ir {
 
-// Create a structural key for an AST expression.
-// Minimal but effective for our current node types.
-static std::string key_of(const loc::ast::Node& e) {
-    if (auto id = dynamic_cast<const loc::ast::IdentExpr*>(&e)) {
-        return "id:" + id->name;
+const char* structure_name(Structure s) {
+    switch (s) {
+    case Structure::Dense:          return "dense";
+    case Structure::Zero:           return "zero";
+    case Structure::Identity:       return "identity";
+    case Structure::ScaledIdentity: return "scaled identity";
+    case Structure::Diagonal:       return "diagonal";
+    case Structure::Permutation:    return "permutation";
+    case Structure::Sparse:         return "sparse";
     }
-    if (auto sm = dynamic_cast<const loc::ast::ScalarMulExpr*>(&e)) {
-        return "sm:" + std::to_string(sm->scalar) + "(" + key_of(*sm->expr) + ")";
+    return "?";
+}
+
+// ---------- Hash-consing ----------
+
+static std::uint64_t bits_of(double x) {
+    std::uint64_t b;
+    std::memcpy(&b, &x, sizeof b);
+    return b;
+}
+
+// splitmix64 finalizer folded into a running hash
+static std::uint64_t mix(std::uint64_t h, std::uint64_t v) {
+    std::uint64_t z = h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+std::uint64_t structural_hash(const Node& n) {
+    std::uint64_t h = mix(0, (std::uint64_t)n.kind);
+    switch (n.kind) {
+    case NodeKind::Op:        h = mix(h, std::hash<std::string>{}(n.name)); break;
+    case NodeKind::ScalarMul: h = mix(h, bits_of(n.scalar)); break;
+    case NodeKind::LinComb:
+        for (double c : n.coeffs) h = mix(h, bits_of(c));
+        break;
+    case NodeKind::Gemm:
+        h = mix(mix(h, bits_of(n.alpha)), bits_of(n.beta));
+        h = mix(h, (std::uint64_t)n.trans_a << 1 | (std::uint64_t)n.trans_b);
+        break;
+    case NodeKind::Compose:
+        h = mix(h, (std::uint64_t)n.trans_a << 1 | (std::uint64_t)n.trans_b);
+        break;
+    case NodeKind::Zero:
+        h = mix(mix(h, n.rows), n.cols);
+        break;
+    case NodeKind::Pow:
+        h = mix(h, n.exponent);
+        break;
+    case NodeKind::Add:
+    case NodeKind::Transpose:
+        break;
     }
-    if (auto add = dynamic_cast<const loc::ast::AddExpr*>(&e)) {
-        return "add(" + key_of(*add->lhs) + "," + key_of(*add->rhs) + ")";
+    for (int in : n.inputs) h = mix(h, (std::uint64_t)(std::uint32_t)in);
+    return h;
+}
+
+bool same_structure(const Node& a, const Node& b) {
+    if (a.kind != b.kind || a.inputs != b.inputs) return false;
+    switch (a.kind) {
+    case NodeKind::Op:        return a.name == b.name;
+    case NodeKind::ScalarMul: return bits_of(a.scalar) == bits_of(b.scalar);
+    case NodeKind::LinComb:
+        if (a.coeffs.size() != b.coeffs.size()) return false;
+        for (std::size_t i = 0; i < a.coeffs.size(); ++i) {
+            if (bits_of(a.coeffs[i]) != bits_of(b.coeffs[i])) return false;
+        }
+        return true;
+    case NodeKind::Gemm:
+        return bits_of(a.alpha) == bits_of(b.alpha) && bits_of(a.beta) == bits_of(b.beta) &&
+               a.trans_a == b.trans_a && a.trans_b == b.trans_b;
+    case NodeKind::Compose:
+        return a.trans_a == b.trans_a && a.trans_b == b.trans_b;
+    case NodeKind::Zero:
+        return a.rows == b.rows && a.cols == b.cols;
+    case NodeKind::Pow:
+        return a.exponent == b.exponent;
+    case NodeKind::Add:
+    case NodeKind::Transpose:
+        return true;
     }
-    if (auto comp = dynamic_cast<const loc::ast::ComposeExpr*>(&e)) {
-        return "comp(" + key_of(*comp->lhs) + "," + key_of(*comp->rhs) + ")";
+    return false;
+}
+
+// ---------- Matrix-free application ----------
+
+namespace {
+
+// Interns `n` with its shape filled in from its (already shaped) inputs
+// and the operator shapes, as infer_shapes will: what apply() prices
+// powers with. Unknown or ill-shaped stays 0 x 0, for infer_shapes to
+// report.
+int intern_shaped(Graph& g, Node n, const ShapeMap& shapes) {
+    auto in = [&](std::size_t i) -> const Node& { return g.nodes[n.inputs[i]]; };
+    switch (n.kind) {
+    case NodeKind::Op:
+        if (auto it = shapes.find(n.name); it != shapes.end()) {
+            n.rows = it->second.rows;
+            n.cols = it->second.cols;
+        }
+        break;
+    case NodeKind::ScalarMul:
+        n.rows = in(0).rows;
+        n.cols = in(0).cols;
+        break;
+    case NodeKind::Add:
+        if (in(0).rows == in(1).rows && in(0).cols == in(1).cols) {
+            n.rows = in(0).rows;
+            n.cols = in(0).cols;
+        }
+        break;
+    case NodeKind::Compose:
+        if (in(0).rows && in(1).rows && in(0).cols == in(1).rows) {
+            n.rows = in(0).rows;
+            n.cols = in(1).cols;
+        }
+        break;
+    case NodeKind::Pow:
+        if (in(0).rows == in(0).cols) {
+            n.rows = in(0).rows;
+            n.cols = in(0).cols;
+        }
+        break;
+    case NodeKind::Transpose:
+        n.rows = in(0).cols;
+        n.cols = in(0).rows;
+        break;
+    default:
+        break;
     }
-    throw std::runtime_error("key_of: unsupported AST expr node");
+    return g.intern(std::move(n));
 }
 
-static int lower_expr(const loc::ast::Node& e,
-                      Graph& g,
-                      std::unordered_map<std::string,int>& op_cache,
-                      std::unordered_map<std::string,int>& expr_cache) {
-    // CSE: reuse if we've already lowered an identical AST expression
-    std::string k = key_of(e);
-    if (auto it = expr_cache.find(k); it != expr_cache.end()) {
-        return it->second;
+struct ApplyBuilder {
+    Graph& g;
+    int line;
+    const ShapeMap& shapes;
+    std::unordered_map<std::uint64_t, int> memo; // (op, x) -> op @ x
+
+    int node(NodeKind kind, std::vector<int> inputs, double scalar = 0.0) {
+        Node n;
+        n.kind = kind;
+        n.line = line;
+        n.scalar = scalar;
+        n.inputs = std::move(inputs);
+        return intern_shaped(g, std::move(n), shapes);
+    }
+
+    int pow(int base, std::uint64_t k) {
+        Node n;
+        n.kind = NodeKind::Pow;
+        n.line = line;
+        n.exponent = k;
+        n.inputs = {base};
+        return intern_shaped(g, std::move(n), shapes);
+    }
+
+    // Whether base^k x is cheaper as k products than as base^k @ x; an
+    // unknown shape is priced as if x were square.
+    bool unroll(int x, std::uint64_t k) const {
+        const Node& v = g.nodes[x];
+        return v.rows ? unroll_power_apply(v.rows, v.cols, k) : unroll_power_apply(1, 1, k);
     }
 
-    int nid = -1;
+    int apply(int op, int x) {
+        const std::uint64_t key = (std::uint64_t)(std::uint32_t)op << 32 | (std::uint32_t)x;
+        if (auto it = memo.find(key); it != memo.end()) return it->second;
+
+        // Copy what is needed: interning may grow g.nodes
+        const NodeKind kind = g.nodes[op].kind;
+        const std::vector<int> in = g.nodes[op].inputs;
+        const double scalar = g.nodes[op].scalar;
+        const std::uint64_t exponent = g.nodes[op].exponent;
 
+        int out;
+        switch (kind) {
+        case NodeKind::Compose:   // (A @ B) x = A (B x)
+            out = apply(in[0], apply(in[1], x));
+            break;
+        case NodeKind::Add:       // (A + B) x = A x + B x
+            out = node(NodeKind::Add, {apply(in[0], x), apply(in[1], x)});
+            break;
+        case NodeKind::ScalarMul: // (s A) x = s (A x)
+            out = node(NodeKind::ScalarMul, {apply(in[0], x)}, scalar);
+            break;
+        case NodeKind::Pow:       // A^k x = A (... (A x)), k products of x's width, if cheaper
+            if (!unroll(x, exponent)) {
+                out = node(NodeKind::Compose, {op, x});
+                break;
+            }
+            out = x;
+            for (std::uint64_t i = 0; i < exponent; ++i) out = apply(in[0], out);
+            break;
+        case NodeKind::Transpose: // pushed into the operand: the same rules on A'
+            out = apply_transposed(op, in[0], x);
+            break;
+        default:
+            out = node(NodeKind::Compose, {op, x});
+            break;
+        }
+        memo[key] = out;
+        return out;
+    }
+
+    // A' x for t = A', with (A @ B)' = B' A' and the transpose distributed
+    // over sums, scalings and powers (each piece memoized through apply);
+    // anything else is applied as A' @ x
+    int apply_transposed(int t, int a, int x) {
+        const NodeKind kind = g.nodes[a].kind;
+        const std::vector<int> in = g.nodes[a].inputs;
+        const double scalar = g.nodes[a].scalar;
+        const std::uint64_t exponent = g.nodes[a].exponent;
+        auto tr = [&](int v) { return node(NodeKind::Transpose, {v}); };
+
+        switch (kind) {
+        case NodeKind::Compose:
+            return apply(tr(in[1]), apply(tr(in[0]), x));
+        case NodeKind::Add:
+            return node(NodeKind::Add, {apply(tr(in[0]), x), apply(tr(in[1]), x)});
+        case NodeKind::ScalarMul:
+            return node(NodeKind::ScalarMul, {apply(tr(in[0]), x)}, scalar);
+        case NodeKind::Pow: {
+            const int b = tr(in[0]);
+            if (!unroll(x, exponent)) return node(NodeKind::Compose, {pow(b, exponent), x});
+            for (std::uint64_t i = 0; i < exponent; ++i) x = apply(b, x);
+            return x;
+        }
+        case NodeKind::Transpose:
+            return apply(in[0], x);
+        default:
+            return node(NodeKind::Compose, {t, x});
+        }
+    }
+};
+
+} // namespace
+
+int lower_apply(Graph& g, int op, int x, int line, const ShapeMap& shapes) {
+    ApplyBuilder b{g, line, shapes, {}};
+    return b.apply(op, x);
+}
+
+// ---------- Lowering ----------
+
+// Lowers inputs first, then interns the node itself: identical
+// subexpressions (CSE) fall out of hash-consing on input ids, so every AST
+// node costs O(1) regardless of expression depth.
+static int lower_expr(const loc::ast::Node& e,
+                      int line,
+                      Graph& g,
+                      std::unordered_map<std::string,int>& op_cache,
+                      const ShapeMap& shapes) {
     if (auto id = dynamic_cast<const loc::ast::IdentExpr*>(&e)) {
         auto it = op_cache.find(id->name);
-        if (it != op_cache.end()) {
-            nid = it->second;
-        } else {
-            Node n;
-            n.kind = NodeKind::Op;
-            n.name = id->name;
-            nid = g.add_node(std::move(n));
-            op_cache[id->name] = nid;
-        }
-        expr_cache[k] = nid;
+        if (it != op_cache.end()) return it->second;
+
+        Node n;
+        n.kind = NodeKind::Op;
+        n.name = id->name;
+        n.line = line;
+        const int nid = intern_shaped(g, std::move(n), shapes);
+        op_cache[id->name] = nid;
         return nid;
     }
 
     if (auto sm = dynamic_cast<const loc::ast::ScalarMulExpr*>(&e)) {
-        int x = lower_expr(*sm->expr, g, op_cache, expr_cache);
+        int x = lower_expr(*sm->expr, line, g, op_cache, shapes);
         Node n;
         n.kind = NodeKind::ScalarMul;
+        n.line = line;
         n.scalar = sm->scalar;
         n.inputs = {x};
-        nid = g.add_node(std::move(n));
-        expr_cache[k] = nid;
-        return nid;
+        return intern_shaped(g, std::move(n), shapes);
     }
 
     if (auto add = dynamic_cast<const loc::ast::AddExpr*>(&e)) {
-        int a = lower_expr(*add->lhs, g, op_cache, expr_cache);
-        int b = lower_expr(*add->rhs, g, op_cache, expr_cache);
+        int a = lower_expr(*add->lhs, line, g, op_cache, shapes);
+        int b = lower_expr(*add->rhs, line, g, op_cache, shapes);
         Node n;
         n.kind = NodeKind::Add;
+        n.line = line;
         n.inputs = {a, b};
-        nid = g.add_node(std::move(n));
-        expr_cache[k] = nid;
-        return nid;
+        return intern_shaped(g, std::move(n), shapes);
     }
 
     if (auto comp = dynamic_cast<const loc::ast::ComposeExpr*>(&e)) {
-        int a = lower_expr(*comp->lhs, g, op_cache, expr_cache);
-        int b = lower_expr(*comp->rhs, g, op_cache, expr_cache);
+        int a = lower_expr(*comp->lhs, line, g, op_cache, shapes);
+        int b = lower_expr(*comp->rhs, line, g, op_cache, shapes);
         Node n;
         n.kind = NodeKind::Compose;
+        n.line = line;
         n.inputs = {a, b};
-        nid = g.add_node(std::move(n));
-        expr_cache[k] = nid;
-        return nid;
+        return intern_shaped(g, std::move(n), shapes);
+    }
+
+    if (auto pw = dynamic_cast<const loc::ast::PowExpr*>(&e)) {
+        int x = lower_expr(*pw->base, line, g, op_cache, shapes);
+        Node n;
+        n.kind = NodeKind::Pow;
+        n.line = line;
+        n.exponent = pw->exponent;
+        n.inputs = {x};
+        return intern_shaped(g, std::move(n), shapes);
+    }
+
+    if (auto tr = dynamic_cast<const loc::ast::TransposeExpr*>(&e)) {
+        int x = lower_expr(*tr->expr, line, g, op_cache, shapes);
+        Node n;
+        n.kind = NodeKind::Transpose;
+        n.line = line;
+        n.inputs = {x};
+        return intern_shaped(g, std::move(n), shapes);
+    }
+
+    if (auto ap = dynamic_cast<const loc::ast::ApplyExpr*>(&e)) {
+        int op = lower_expr(*ap->op, line, g, op_cache, shapes);
+        int x = lower_expr(*ap->x, line, g, op_cache, shapes);
+        return lower_apply(g, op, x, line, shapes);
     }
 
     throw std::runtime_error("lower_expr: unsupported AST expr node");
 }
 
-Graph lower_program(const loc::ast::Program& prog) {
+Graph lower_program(const loc::ast::Program& prog, const ShapeMap& shapes) {
     Graph g;
     std::unordered_map<std::string,int> op_cache;
-    std::unordered_map<std::string,int> expr_cache;
 
     for (const auto& st_ptr : prog.statements) {
         const loc::ast::Node& st = *st_ptr;
@@ -100,32 +346,32 @@ Graph lower_program(const loc::ast::Program& prog) {
                 Node n;
                 n.kind = NodeKind::Op;
                 n.name = od->name;
-                int nid = g.add_node(std::move(n));
-                op_cache[od->name] = nid;
-                expr_cache["id:" + od->name] = nid;
+                n.line = od->line;
+                op_cache[od->name] = intern_shaped(g, std::move(n), shapes);
             }
             continue;
         }
 
         if (auto asn = dynamic_cast<const loc::ast::AssignStmt*>(&st)) {
-            int v = lower_expr(*asn->expr, g, op_cache, expr_cache);
+            int v = lower_expr(*asn->expr, asn->line, g, op_cache, shapes);
             Graph::Stmt s;
             s.kind = Graph::Stmt::Kind::Assign;
             s.name = asn->name;
             s.value = v;
+            s.line = asn->line;
             g.program.push_back(std::move(s));
             
             // Allow variable reuse in subsequent statements
             op_cache[asn->name] = v;
-            expr_cache["id:" + asn->name] = v;
             continue;
         }
 
         if (auto pr = dynamic_cast<const loc::ast::PrintStmt*>(&st)) {
-            int v = lower_expr(*pr->expr, g, op_cache, expr_cache);
+            int v = lower_expr(*pr->expr, pr->line, g, op_cache, shapes);
             Graph::Stmt s;
             s.kind = Graph::Stmt::Kind::Print;
             s.value = v;
+            s.line = pr->line;
             g.program.push_back(std::move(s));
             continue;
         }
@@ -0,0 +1,93 @@
+#include "loc/ir/heap_stats.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace loc::ir {
+
+static std::atomic<std::size_t> g_live_bytes{0};
+static std::atomic<std::size_t> g_peak_bytes{0};
+static std::atomic<std::size_t> g_allocations{0};
+static std::atomic<bool> g_tracking{false};
+
+void set_heap_tracking(bool on) {
+    g_tracking.store(on, std::memory_order_relaxed);
+}
+
+HeapMemStats heap_mem_stats() {
+    HeapMemStats s;
+    s.live_bytes = g_live_bytes.load(std::memory_order_relaxed);
+    s.peak_bytes = g_peak_bytes.load(std::memory_order_relaxed);
+    s.allocations = g_allocations.load(std::memory_order_relaxed);
+    return s;
+}
+
+void reset_heap_mem_stats() {
+    g_peak_bytes.store(g_live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    g_allocations.store(0, std::memory_order_relaxed);
+}
+
+} // namespace loc::ir
+
+// ---------- Global allocation functions ----------
+//
+// Every block starts with a header the size of max_align_t, so the pointer
+// handed out keeps malloc's alignment. The header holds the counted size
+// (0 if the block was allocated with tracking off), so delete needs no size.
+
+namespace {
+
+constexpr std::size_t kHeader = alignof(std::max_align_t);
+static_assert(kHeader >= sizeof(std::size_t), "header must hold a size");
+
+void* counted_alloc(std::size_t n) noexcept {
+    if (n > SIZE_MAX - kHeader) return nullptr; // n + kHeader would wrap
+    void* raw = std::malloc(n + kHeader);
+    if (!raw) return nullptr;
+
+    using namespace loc::ir;
+    const bool on = g_tracking.load(std::memory_order_relaxed);
+    *static_cast<std::size_t*>(raw) = on ? n : 0;
+    if (!on) return static_cast<char*>(raw) + kHeader;
+
+    const std::size_t live = g_live_bytes.fetch_add(n, std::memory_order_relaxed) + n;
+    std::size_t peak = g_peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !g_peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<char*>(raw) + kHeader;
+}
+
+void counted_free(void* p) noexcept {
+    if (!p) return;
+    void* raw = static_cast<char*>(p) - kHeader;
+    if (const std::size_t n = *static_cast<std::size_t*>(raw)) {
+        loc::ir::g_live_bytes.fetch_sub(n, std::memory_order_relaxed);
+    }
+    std::free(raw);
+}
+
+void* counted_alloc_or_throw(std::size_t n) {
+    for (;;) {
+        if (void* p = counted_alloc(n)) return p;
+        std::new_handler h = std::get_new_handler();
+        if (!h) throw std::bad_alloc();
+        h();
+    }
+}
+
+} // namespace
+
+void* operator new(std::size_t n) { return counted_alloc_or_throw(n); }
+void* operator new[](std::size_t n) { return counted_alloc_or_throw(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n); }
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
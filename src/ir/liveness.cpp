@@ -0,0 +1,63 @@
+#include "loc/ir/passes/liveness.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+namespace loc::ir::passes {
+
+static void check_id(const Graph& g, int id) {
+    if (id < 0 || id >= (int)g.nodes.size()) {
+        throw std::runtime_error("liveness: invalid node id");
+    }
+}
+
+Liveness compute_liveness(const Graph& g) {
+    Liveness lv;
+    lv.uses.assign(g.nodes.size(), 0);
+    lv.last_use.assign(g.nodes.size(), -1);
+
+    std::vector<int> pos(g.nodes.size(), -1);        // position in order
+    std::vector<char> state(g.nodes.size(), 0);      // 0 new, 1 open, 2 done
+    std::vector<std::pair<int, size_t>> stack;
+
+    for (const auto& s : g.program) {
+        check_id(g, s.value);
+
+        // 1) Post-order DFS from the statement root: inputs before consumers
+        if (!state[s.value]) {
+            stack.push_back({s.value, 0});
+            state[s.value] = 1;
+        }
+        while (!stack.empty()) {
+            auto& [u, next] = stack.back();
+            const auto& ins = g.nodes[u].inputs;
+            if (next < ins.size()) {
+                int v = ins[next++];
+                check_id(g, v);
+                if (state[v] == 1) throw std::runtime_error("liveness: cycle in IR");
+                if (state[v] == 0) {
+                    state[v] = 1;
+                    stack.push_back({v, 0});
+                }
+                continue;
+            }
+            state[u] = 2;
+            pos[u] = (int)lv.order.size();
+            lv.order.push_back(u);
+            for (int v : ins) {
+                ++lv.uses[v];
+                lv.last_use[v] = pos[u];
+            }
+            stack.pop_back();
+        }
+
+        // 2) The statement reads its value after everything so far ran
+        ++lv.uses[s.value];
+        lv.last_use[s.value] = (int)lv.order.size();
+        lv.stmt_end.push_back((int)lv.order.size());
+    }
+
+    return lv;
+}
+
+} // namespace loc::ir::passes
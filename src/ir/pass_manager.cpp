@@ -0,0 +1,134 @@
+#include "loc/ir/pass_manager.hpp"
+#include "loc/ir/heap_stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+namespace loc::ir {
+
+std::string PassManager::pipeline() const {
+    std::string s;
+    for (const auto& p : passes_) {
+        if (!s.empty()) s += ',';
+        s += p.name;
+    }
+    return s;
+}
+
+void PassManager::run(Graph& g) {
+    stats_.clear();
+    // Heap counting only while this run collects stats (also on throw)
+    struct Tracking {
+        bool on;
+        explicit Tracking(bool b) : on(b) { if (on) set_heap_tracking(true); }
+        ~Tracking() { if (on) set_heap_tracking(false); }
+    } tracking(collect_stats);
+
+    for (const auto& p : passes_) {
+        if (!collect_stats) {
+            p.run(g);
+        } else {
+            PassStats st;
+            st.name = p.name;
+            st.nodes_before = g.nodes.size();
+            st.stmts_before = g.program.size();
+
+            reset_heap_mem_stats();
+            const std::size_t live0 = heap_mem_stats().live_bytes;
+            const auto t0 = std::chrono::steady_clock::now();
+            p.run(g);
+            const auto t1 = std::chrono::steady_clock::now();
+            const HeapMemStats hs = heap_mem_stats();
+
+            st.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            st.nodes_after = g.nodes.size();
+            st.stmts_after = g.program.size();
+            st.peak_heap_bytes = hs.peak_bytes - live0;
+            st.allocations = hs.allocations;
+            stats_.push_back(std::move(st));
+        }
+
+        if (dump_after_each) {
+            std::cout << "\n[pass] " << p.name << "\n";
+            g.dump();
+        }
+    }
+}
+
+void PassManager::print_report(std::ostream& os) const {
+    double total = 0.0;
+    std::size_t peak = 0;
+    for (const auto& s : stats_) {
+        total += s.ms;
+        peak = std::max(peak, s.peak_heap_bytes);
+    }
+
+    const auto flags = os.flags();
+    const auto prec = os.precision();
+    os << "=== Pass timing ===\n"
+       << std::left << std::setw(16) << "pass" << std::right
+       << std::setw(11) << "ms" << std::setw(7) << "%"
+       << std::setw(19) << "nodes" << std::setw(15) << "stmts"
+       << std::setw(13) << "peak KiB" << std::setw(11) << "allocs" << "\n";
+    os << std::fixed;
+    for (const auto& s : stats_) {
+        const std::string nodes = std::to_string(s.nodes_before) + " -> " + std::to_string(s.nodes_after);
+        const std::string stmts = std::to_string(s.stmts_before) + " -> " + std::to_string(s.stmts_after);
+        os << std::left << std::setw(16) << s.name << std::right
+           << std::setw(11) << std::setprecision(3) << s.ms
+           << std::setw(7) << std::setprecision(1) << (total > 0 ? 100.0 * s.ms / total : 0.0)
+           << std::setw(19) << nodes << std::setw(15) << stmts
+           << std::setw(13) << std::setprecision(1) << s.peak_heap_bytes / 1024.0
+           << std::setw(11) << s.allocations << "\n";
+    }
+    os << std::left << std::setw(16) << "total" << std::right
+       << std::setw(11) << std::setprecision(3) << total
+       << std::setw(7) << std::setprecision(1) << (total > 0 ? 100.0 : 0.0)
+       << std::setw(34) << ""
+       << std::setw(13) << std::setprecision(1) << peak / 1024.0 << "\n";
+    os.flags(flags);
+    os.precision(prec);
+}
+
+// Pass names are plain identifiers in practice; escape the JSON specials
+// anyway so the output always parses.
+static void write_json_string(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof buf, "\\u%04x", (unsigned)c);
+            os << buf;
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+void PassManager::write_json(std::ostream& os) const {
+    double total = 0.0;
+    for (const auto& s : stats_) total += s.ms;
+
+    const auto prec = os.precision(17);
+    os << "{\n  \"passes\": [";
+    for (std::size_t i = 0; i < stats_.size(); ++i) {
+        const auto& s = stats_[i];
+        os << (i ? ",\n" : "\n") << "    {\"name\": ";
+        write_json_string(os, s.name);
+        os << ", \"ms\": " << s.ms
+           << ", \"nodes_before\": " << s.nodes_before << ", \"nodes_after\": " << s.nodes_after
+           << ", \"stmts_before\": " << s.stmts_before << ", \"stmts_after\": " << s.stmts_after
+           << ", \"peak_heap_bytes\": " << s.peak_heap_bytes
+           << ", \"allocations\": " << s.allocations << "}";
+    }
+    os << (stats_.empty() ? "" : "\n  ") << "],\n  \"total_ms\": " << total << "\n}\n";
+    os.precision(prec);
+}
+
+} // namespace loc::ir
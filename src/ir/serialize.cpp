@@ -0,0 +1,204 @@
+#include "loc/ir/serialize.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace loc::ir {
+
+// ---------- Encoding ----------
+
+void ByteWriter::varint(std::uint64_t v) {
+    while (v >= 0x80) {
+        byte((std::uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    byte((std::uint8_t)v);
+}
+
+void ByteWriter::f64(double x) {
+    std::uint64_t b;
+    std::memcpy(&b, &x, sizeof b);
+    for (int i = 0; i < 8; ++i) byte((std::uint8_t)(b >> (8 * i)));
+}
+
+void ByteWriter::str(const std::string& s) {
+    varint(s.size());
+    out_.append(s);
+}
+
+static void truncated() {
+    throw std::runtime_error("IR decode: unexpected end of data");
+}
+
+std::uint8_t ByteReader::byte() {
+    if (p_ == end_) truncated();
+    return (std::uint8_t)*p_++;
+}
+
+std::uint64_t ByteReader::varint() {
+    std::uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const std::uint8_t b = byte();
+        v |= (std::uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    throw std::runtime_error("IR decode: varint too long");
+}
+
+std::size_t ByteReader::count() {
+    const std::uint64_t n = varint();
+    if (n > (std::uint64_t)(end_ - p_)) truncated();
+    return (std::size_t)n;
+}
+
+double ByteReader::f64() {
+    if (end_ - p_ < 8) truncated();
+    std::uint64_t b = 0;
+    for (int i = 0; i < 8; ++i) b |= (std::uint64_t)(std::uint8_t)p_[i] << (8 * i);
+    p_ += 8;
+    double x;
+    std::memcpy(&x, &b, sizeof x);
+    return x;
+}
+
+std::string ByteReader::str() {
+    const std::uint64_t n = varint();
+    if (n > (std::uint64_t)(end_ - p_)) truncated();
+    std::string s(p_, (std::size_t)n);
+    p_ += n;
+    return s;
+}
+
+// ---------- Graph ----------
+
+void write_graph(ByteWriter& w, const Graph& g) {
+    w.varint(g.nodes.size());
+    for (const Node& n : g.nodes) {
+        w.byte((std::uint8_t)n.kind);
+        switch (n.kind) {
+        case NodeKind::Op:
+            w.str(n.name);
+            w.byte((std::uint8_t)n.structure);
+            w.f64(n.scalar);
+            break;
+        case NodeKind::ScalarMul:
+            w.f64(n.scalar);
+            break;
+        case NodeKind::LinComb:
+            w.varint(n.coeffs.size());
+            for (double c : n.coeffs) w.f64(c);
+            break;
+        case NodeKind::Gemm:
+            w.f64(n.alpha);
+            w.f64(n.beta);
+            w.byte((std::uint8_t)(n.trans_a << 1 | n.trans_b));
+            break;
+        case NodeKind::Compose:
+            w.byte((std::uint8_t)(n.trans_a << 1 | n.trans_b));
+            break;
+        case NodeKind::Pow:
+            w.varint(n.exponent);
+            break;
+        case NodeKind::Add:
+        case NodeKind::Zero:
+        case NodeKind::Transpose:
+            break;
+        }
+        w.varint(n.inputs.size());
+        for (int in : n.inputs) w.varint((std::uint64_t)in);
+        w.varint(n.rows);
+        w.varint(n.cols);
+        w.varint((std::uint64_t)n.line);
+        w.varint(n.cost);
+    }
+
+    w.varint(g.program.size());
+    for (const Graph::Stmt& s : g.program) {
+        w.byte((std::uint8_t)s.kind);
+        if (s.kind == Graph::Stmt::Kind::Assign) w.str(s.name);
+        w.varint((std::uint64_t)s.value);
+        w.varint((std::uint64_t)s.line);
+    }
+}
+
+Graph read_graph(ByteReader& r) {
+    Graph g;
+    const std::size_t count = r.count();
+    auto node_id = [&](std::uint64_t v) {
+        if (v >= count) throw std::runtime_error("IR decode: node id out of range");
+        return (int)v;
+    };
+
+    g.nodes.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        Node n;
+        n.id = (int)i;
+        const std::uint8_t kind = r.byte();
+        if (kind > (std::uint8_t)NodeKind::Transpose) throw std::runtime_error("IR decode: unknown node kind");
+        n.kind = (NodeKind)kind;
+        switch (n.kind) {
+        case NodeKind::Op: {
+            n.name = r.str();
+            const std::uint8_t s = r.byte();
+            if (s > (std::uint8_t)Structure::Sparse) throw std::runtime_error("IR decode: unknown structure");
+            n.structure = (Structure)s;
+            n.scalar = r.f64();
+            break;
+        }
+        case NodeKind::ScalarMul:
+            n.scalar = r.f64();
+            break;
+        case NodeKind::LinComb: {
+            n.coeffs.resize(r.count());
+            for (double& c : n.coeffs) c = r.f64();
+            break;
+        }
+        case NodeKind::Gemm: {
+            n.alpha = r.f64();
+            n.beta = r.f64();
+            const std::uint8_t t = r.byte();
+            n.trans_a = t & 2;
+            n.trans_b = t & 1;
+            break;
+        }
+        case NodeKind::Compose: {
+            const std::uint8_t t = r.byte();
+            n.trans_a = t & 2;
+            n.trans_b = t & 1;
+            break;
+        }
+        case NodeKind::Pow:
+            n.exponent = r.varint();
+            break;
+        case NodeKind::Add:
+        case NodeKind::Zero:
+        case NodeKind::Transpose:
+            break;
+        }
+        n.inputs.resize(r.count());
+        for (int& in : n.inputs) in = node_id(r.varint());
+        n.rows = (std::size_t)r.varint();
+        n.cols = (std::size_t)r.varint();
+        n.line = (int)r.varint();
+        n.cost = r.varint();
+        g.nodes.push_back(std::move(n));
+    }
+
+    const std::size_t stmts = r.count();
+    g.program.reserve(stmts);
+    for (std::size_t i = 0; i < stmts; ++i) {
+        Graph::Stmt s;
+        const std::uint8_t kind = r.byte();
+        if (kind > (std::uint8_t)Graph::Stmt::Kind::Print) throw std::runtime_error("IR decode: unknown statement kind");
+        s.kind = (Graph::Stmt::Kind)kind;
+        if (s.kind == Graph::Stmt::Kind::Assign) s.name = r.str();
+        s.value = node_id(r.varint());
+        s.line = (int)r.varint();
+        g.program.push_back(std::move(s));
+    }
+
+    g.reindex();
+    return g;
+}
+
+} // namespace loc::ir
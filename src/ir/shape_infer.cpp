@@ -0,0 +1,132 @@
+#include "loc/ir/passes/shape_infer.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace loc::ir::passes {
+
+static std::string shape_str(std::size_t rows, std::size_t cols) {
+    return std::to_string(rows) + "x" + std::to_string(cols);
+}
+
+static std::string shape_str(const Node& n) { return shape_str(n.rows, n.cols); }
+
+[[noreturn]] static void shape_error(const Node& n, const std::string& what) {
+    std::ostringstream oss;
+    oss << "Shape error";
+    if (n.line > 0) oss << " at line " << n.line;
+    oss << ": " << what;
+    throw std::runtime_error(oss.str());
+}
+
+void infer_shapes(Graph& g, const ShapeMap& shapes) {
+    // Producers append nodes after their inputs, so id order is topological.
+    for (auto& n : g.nodes) {
+        for (int in : n.inputs) {
+            if (in < 0 || in >= n.id) {
+                throw std::runtime_error("infer_shapes: inputs must precede their consumers");
+            }
+        }
+
+        if (n.kind == NodeKind::Zero) continue; // carries its own shape
+
+        n.rows = n.cols = 0;
+        switch (n.kind) {
+        case NodeKind::Op:
+            n.structure = Structure::Dense;
+            if (auto it = shapes.find(n.name); it != shapes.end()) {
+                n.rows = it->second.rows;
+                n.cols = it->second.cols;
+                n.structure = it->second.structure;
+                n.scalar = it->second.structure == Structure::ScaledIdentity ||
+                                   it->second.structure == Structure::Sparse
+                               ? it->second.scale
+                               : 0.0;
+            }
+            break;
+
+        case NodeKind::ScalarMul: {
+            const Node& a = g.nodes[n.inputs.at(0)];
+            n.rows = a.rows;
+            n.cols = a.cols;
+            break;
+        }
+
+        case NodeKind::Add: {
+            const Node& a = g.nodes[n.inputs.at(0)];
+            const Node& b = g.nodes[n.inputs.at(1)];
+            if (!a.rows || !b.rows) break;
+            if (a.rows != b.rows || a.cols != b.cols) {
+                shape_error(n, "cannot add " + shape_str(a) + " and " + shape_str(b));
+            }
+            n.rows = a.rows;
+            n.cols = a.cols;
+            break;
+        }
+
+        case NodeKind::LinComb: {
+            const Node& a = g.nodes[n.inputs.at(0)];
+            bool known = a.rows != 0;
+            for (int in : n.inputs) {
+                const Node& b = g.nodes[in];
+                if (!b.rows) { known = false; continue; }
+                if (a.rows && (a.rows != b.rows || a.cols != b.cols)) {
+                    shape_error(n, "cannot add " + shape_str(a) + " and " + shape_str(b));
+                }
+            }
+            if (known) {
+                n.rows = a.rows;
+                n.cols = a.cols;
+            }
+            break;
+        }
+
+        case NodeKind::Compose:
+        case NodeKind::Gemm: {
+            const Node& a = g.nodes[n.inputs.at(0)];
+            const Node& b = g.nodes[n.inputs.at(1)];
+            if (!a.rows || !b.rows) break;
+            // Transpose flags: the factor as the product reads it
+            const std::size_t ar = n.trans_a ? a.cols : a.rows, ac = n.trans_a ? a.rows : a.cols;
+            const std::size_t br = n.trans_b ? b.cols : b.rows, bc = n.trans_b ? b.rows : b.cols;
+            if (ac != br) {
+                shape_error(n, "cannot compose " + shape_str(ar, ac) + " @ " + shape_str(br, bc));
+            }
+            if (n.inputs.size() > 2) {
+                const Node& c = g.nodes[n.inputs[2]];
+                if (!c.rows) break;
+                if (c.rows != ar || c.cols != bc) {
+                    shape_error(n, "cannot add " + shape_str(ar, bc) + " and " + shape_str(c));
+                }
+            }
+            n.rows = ar;
+            n.cols = bc;
+            break;
+        }
+
+        case NodeKind::Transpose: {
+            const Node& a = g.nodes[n.inputs.at(0)];
+            n.rows = a.cols;
+            n.cols = a.rows;
+            break;
+        }
+
+        case NodeKind::Pow: {
+            const Node& a = g.nodes[n.inputs.at(0)];
+            if (!a.rows) break;
+            if (a.rows != a.cols) {
+                shape_error(n, "cannot raise " + shape_str(a) + " to a power (not square)");
+            }
+            n.rows = a.rows;
+            n.cols = a.cols;
+            break;
+        }
+
+        case NodeKind::Zero:
+            break;
+        }
+    }
+}
+
+} // namespace loc::ir::passes
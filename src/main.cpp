@@ -1,104 +1,377 @@
 // MINIMAL PRINT + RUNTIME (matrix literals enabled)
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "loc/frontend/ast.hpp"
+#include "loc/passes/fusion.hpp"
 #include "loc/passes/simplify.hpp"
 #include "loc/passes/resolve_prints.hpp"
 
 #include "loc/ir/lower.hpp"
 #include "loc/ir/pass_manager.hpp"
+#include "loc/ir/passes/chain_order.hpp"
 #include "loc/ir/passes/const_fold.hpp"
+#include "loc/ir/passes/cse.hpp"
 #include "loc/ir/passes/dce.hpp"
+#include "loc/ir/passes/gemm_epilogue.hpp"
+#include "loc/ir/passes/shape_infer.hpp"
 
 // RUNTIME (matrix backend)
 #include "loc/runtime/registry.hpp"
 #include "loc/runtime/executor.hpp"
 #include "loc/runtime/matrix.hpp"
+#include "loc/runtime/matrix_file.hpp"
+#include "loc/runtime/gemm.hpp"
+#include "loc/runtime/precision.hpp"
+#include "loc/runtime/profiler.hpp"
+#include "loc/runtime/program_cache.hpp"
+#include "loc/runtime/simd.hpp"
+#include "loc/runtime/sparse.hpp"
+#include "loc/runtime/thread_pool.hpp"
 
 int yyparse();
 extern loc::ast::Program* g_program;
 extern FILE* yyin;
 
-// Convert AST MatrixLiteral -> runtime Matrix
-static loc::rt::Matrix to_matrix(const loc::ast::MatrixLiteral& lit) {
-    const auto& r = lit.rows;
-    if (r.empty() || r[0].empty()) {
-        throw std::runtime_error("Empty matrix literal");
-    }
+// Parses a non-negative integer option value; false on garbage or past
+// SIZE_MAX.
+static bool parse_size(const std::string& s, size_t& out) {
+    const char* end = s.data() + s.size();
+    const auto [p, ec] = std::from_chars(s.data(), end, out);
+    return !s.empty() && ec == std::errc() && p == end;
+}
 
-    const size_t R = r.size();
-    const size_t C = r[0].size();
+static void usage(const char* argv0) {
+    std::cerr << "usage: " << argv0 << " [options] [file.loc]\n"
+              << "  --gemm=naive|blocked   matmul kernel (default: $LOC_GEMM or blocked)\n"
+              << "  --simd=scalar|sse2|avx2|avx512\n"
+              << "                         cap the elementwise ISA (default: $LOC_SIMD or best detected)\n"
+              << "  --threads=N            runtime thread pool size, at most " << loc::rt::max_num_threads()
+              << "\n                         (default: $LOC_NUM_THREADS or all cores)\n"
+              << "  --schedule=parallel|serial|planned\n"
+              << "                         parallel: independent IR nodes run concurrently\n"
+              << "                         serial:   one node at a time, reference-counted cache\n"
+              << "                         planned:  serial over one preplanned arena\n"
+              << "                         (default: parallel with >1 thread, else planned)\n"
+              << "  --precision=f64|f32|mixed\n"
+              << "                         element precision; f32 / mixed (float storage, double GEMM sums)\n"
+              << "                         also run the f64 reference and report each printed value's\n"
+              << "                         error against it on stderr (default: $LOC_PRECISION or f64)\n"
+              << "  --stats                print run time and matrix memory to stderr\n"
+              << "  --profile              print a per-node time / FLOP / bandwidth profile to stderr\n"
+              << "  --profile-trace=F      write a Chrome trace-event JSON of the run to file F\n"
+              << "  --cache-dir=DIR        reuse compiled programs (optimized IR and operators) from DIR,\n"
+              << "                         keyed by the source text (default: $LOC_CACHE_DIR, else off)\n"
+              << "  --no-cache             compile even if a cache directory is set\n"
+              << "  --time-passes          print per-pass time, node/statement counts and peak heap to stderr\n"
+              << "  --time-passes-json=F   write the same report as JSON to file F\n"
+              << "  --gemm-mt-min=N        multithread matmuls with m*n*k >= N (default: $LOC_GEMM_MT_MIN or "
+              << loc::rt::kGemmMtMinDefault << ")\n"
+              << "  --sparse-max-density=F store operators and intermediates sparse up to this fraction\n"
+              << "                         of nonzeros (default: $LOC_SPARSE_MAX_DENSITY or "
+              << loc::rt::kSparseMaxDensityDefault << "; 0: only sparse files)\n";
+}
 
-    for (size_t i = 0; i < R; ++i) {
-        if (r[i].size() != C) {
-            throw std::runtime_error("Non-rectangular matrix literal");
+int main(int argc, char** argv) {
+    // 0) Handle options + input
+    const char* path = nullptr;
+    auto schedule = loc::rt::Executor::Schedule::Auto;
+    bool stats = false;
+    bool profile = false;
+    std::string profile_trace;
+    bool time_passes = false;
+    std::string time_passes_json;
+    const char* cache_env = std::getenv("LOC_CACHE_DIR");
+    std::string cache_dir = cache_env ? cache_env : "";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--gemm=", 0) == 0) {
+            loc::rt::GemmKernel k;
+            if (!loc::rt::parse_gemm_kernel(arg.substr(7), k)) {
+                std::cerr << "Error: unknown gemm kernel '" << arg.substr(7) << "'\n";
+                return 1;
+            }
+            loc::rt::set_gemm_kernel(k);
+        } else if (arg.rfind("--simd=", 0) == 0) {
+            loc::rt::simd::Isa isa;
+            if (!loc::rt::simd::parse_isa(arg.substr(7), isa)) {
+                std::cerr << "Error: unknown simd isa '" << arg.substr(7) << "'\n";
+                return 1;
+            }
+            loc::rt::simd::set_isa(isa);
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            size_t n = 0;
+            if (!parse_size(arg.substr(10), n) || n == 0 || n > loc::rt::max_num_threads()) {
+                std::cerr << "Error: --threads expects an integer from 1 to " << loc::rt::max_num_threads() << "\n";
+                return 1;
+            }
+            loc::rt::set_num_threads(n);
+        } else if (arg.rfind("--gemm-mt-min=", 0) == 0) {
+            size_t n = 0;
+            if (!parse_size(arg.substr(14), n)) {
+                std::cerr << "Error: --gemm-mt-min expects a non-negative integer below 2^64\n";
+                return 1;
+            }
+            loc::rt::set_gemm_parallel_threshold(n);
+        } else if (arg.rfind("--sparse-max-density=", 0) == 0) {
+            const std::string v = arg.substr(21);
+            char* end = nullptr;
+            const double d = std::strtod(v.c_str(), &end);
+            if (v.empty() || *end != '\0' || !(d >= 0.0 && d <= 1.0)) {
+                std::cerr << "Error: --sparse-max-density expects a number in [0, 1]\n";
+                return 1;
+            }
+            loc::rt::set_sparse_max_density(d);
+        } else if (arg.rfind("--schedule=", 0) == 0) {
+            const std::string v = arg.substr(11);
+            if (v == "parallel")     schedule = loc::rt::Executor::Schedule::Parallel;
+            else if (v == "serial")  schedule = loc::rt::Executor::Schedule::Serial;
+            else if (v == "planned") schedule = loc::rt::Executor::Schedule::Planned;
+            else {
+                std::cerr << "Error: unknown schedule '" << v << "'\n";
+                return 1;
+            }
+        } else if (arg.rfind("--precision=", 0) == 0) {
+            loc::rt::Precision p;
+            if (!loc::rt::parse_precision(arg.substr(12), p)) {
+                std::cerr << "Error: unknown precision '" << arg.substr(12) << "'\n";
+                return 1;
+            }
+            loc::rt::set_precision(p);
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg.rfind("--profile-trace=", 0) == 0) {
+            profile_trace = arg.substr(16);
+            if (profile_trace.empty()) {
+                std::cerr << "Error: --profile-trace expects a file name\n";
+                return 1;
+            }
+        } else if (arg == "--time-passes") {
+            time_passes = true;
+        } else if (arg.rfind("--time-passes-json=", 0) == 0) {
+            time_passes_json = arg.substr(19);
+            if (time_passes_json.empty()) {
+                std::cerr << "Error: --time-passes-json expects a file name\n";
+                return 1;
+            }
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            cache_dir = arg.substr(12);
+            if (cache_dir.empty()) {
+                std::cerr << "Error: --cache-dir expects a directory\n";
+                return 1;
+            }
+        } else if (arg == "--no-cache") {
+            cache_dir.clear();
+        } else if (arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            return 0;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Error: unknown option " << arg << "\n";
+            usage(argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
         }
     }
 
-    loc::rt::Matrix M(R, C);
-    for (size_t i = 0; i < R; ++i) {
-        for (size_t j = 0; j < C; ++j) {
-            M(i, j) = r[i][j];
-        }
+    // Pass pipeline (its names are part of the program cache key)
+    loc::rt::Registry reg;
+    loc::ir::ShapeMap shapes;
+    loc::ir::PassManager pm;
+    pm.collect_stats = time_passes || !time_passes_json.empty();
+    pm.add("shapes",        [&](loc::ir::Graph& g) { loc::ir::passes::infer_shapes(g, shapes); });
+    pm.add("const_fold",    loc::ir::passes::const_fold);
+    pm.add("chain_order",   loc::ir::passes::chain_order);
+    pm.add("cse",           loc::ir::passes::cse);
+    pm.add("fusion",        loc::passes::fuse_elementwise);
+    pm.add("gemm_epilogue", loc::ir::passes::fuse_gemm_epilogue);
+    pm.add("dce",           loc::ir::passes::dead_code_elim);
+
+    // load("f") paths are relative to the source file's directory
+    std::string base_dir;
+    if (path) {
+        const std::string p = path;
+        const auto slash = p.find_last_of('/');
+        if (slash != std::string::npos) base_dir = p.substr(0, slash + 1);
     }
-    return M;
-}
 
-int main(int argc, char** argv) {
-    // 0) Handle Input
-    if (argc > 1) {
-        FILE* f = fopen(argv[1], "r");
+    // Programs read from a file may come from the cache: keyed by the
+    // source text, so it is read once up front. --time-passes always
+    // compiles (there would be nothing to time).
+    std::optional<loc::rt::ProgramCache> cache;
+    if (path && !cache_dir.empty()) cache.emplace(cache_dir);
+    std::uint64_t cache_key = 0;
+    std::optional<loc::ir::Graph> cached;
+    if (path) {
+        FILE* f = fopen(path, "r");
         if (!f) {
-            std::cerr << "Error: could not open file " << argv[1] << "\n";
+            std::cerr << "Error: could not open file " << path << "\n";
             return 1;
         }
         yyin = f;
+        if (cache) {
+            std::string source;
+            char buf[1 << 16];
+            for (std::size_t n; (n = fread(buf, 1, sizeof buf, f)) > 0;) source.append(buf, n);
+            rewind(f);
+            cache_key = loc::rt::program_cache_key(source, pm.pipeline());
+            if (!pm.collect_stats) cached = cache->load(cache_key, base_dir, reg);
+        }
     }
 
-    // 1) Parse
-    if (yyparse() != 0) {
-        return 1;
-    }
-    if (!g_program) return 1;
-
-    // 2) AST passes
-    loc::passes::simplify_program(*g_program);
-    loc::passes::resolve_prints(*g_program);
+    loc::ir::Graph ir;
+    if (cached) {
+        ir = std::move(*cached);
+    } else {
+        reg = loc::rt::Registry{}; // drop operators a rejected entry registered
 
-    // 3) Lower to IR
-    auto ir = loc::ir::lower_program(*g_program);
+        // 1) Parse
+        if (yyparse() != 0) {
+            return 1;
+        }
+        if (!g_program) return 1;
 
-    // 4) IR passes
-    loc::ir::PassManager pm;
-    pm.add("const_fold", loc::ir::passes::const_fold);
-    pm.add("dce",        loc::ir::passes::dead_code_elim);
-    pm.run(ir);
+        // 2) AST passes
+        loc::passes::simplify_program(*g_program);
+        loc::passes::resolve_prints(*g_program);
 
-    // 5) Dump IR (debug)
-    ir.dump();
+        // 3) Runtime: build registry from operator declarations (their shapes
+        //    also drive the IR passes)
+        std::vector<loc::rt::CachedOperator> ops;
 
-    // 6) Runtime: build registry from operator declarations
-    loc::rt::Registry reg;
+        // Default size for fallback identity (only used if operator has no init)
+        const size_t DEFAULT_N = 2;
 
-    // Default size for fallback identity (only used if operator has no init)
-    const size_t DEFAULT_N = 2;
+        try {
+            for (const auto& st : g_program->statements) {
+                if (auto* od = dynamic_cast<loc::ast::OperatorDecl*>(st.get())) {
+                    loc::rt::CachedOperator op;
+                    op.name = od->name;
+                    if (od->init) {
+                        // The literal's buffer becomes the operator's storage
+                        auto& lit = *od->init;
+                        reg.set(od->name, loc::rt::Matrix(lit.rows, lit.cols, std::move(lit.values)));
+                        od->init.reset();
+                    } else if (od->path) {
+                        op.source = loc::rt::CachedOperator::Source::File;
+                        op.path = *od->path;
+                        reg.load(od->name, loc::rt::operator_path(base_dir, *od->path));
+                    } else {
+                        // Optional fallback: operator declared but not defined
+                        op.source = loc::rt::CachedOperator::Source::Default;
+                        reg.set(od->name, loc::rt::Matrix::identity(DEFAULT_N));
+                    }
+                    shapes[od->name] = reg.shape(od->name);
+                    ops.push_back(std::move(op));
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
 
-    for (const auto& st : g_program->statements) {
-        if (auto* od = dynamic_cast<loc::ast::OperatorDecl*>(st.get())) {
-            if (od->init) {
-                reg.set(od->name, to_matrix(*od->init));
-            } else {
-                // Optional fallback: operator declared but not defined
-                reg.set(od->name, loc::rt::Matrix::identity(DEFAULT_N));
+        // 4) Lower to IR, 5) IR passes
+        // Reports cover the passes that completed, also when one fails.
+        auto report_passes = [&] {
+            if (time_passes) pm.print_report(std::cerr);
+            if (!time_passes_json.empty()) {
+                std::ofstream out(time_passes_json);
+                if (!out) {
+                    std::cerr << "Error: could not write " << time_passes_json << "\n";
+                    return false;
+                }
+                pm.write_json(out);
             }
+            return true;
+        };
+        try {
+            ir = loc::ir::lower_program(*g_program, shapes);
+            pm.run(ir);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            report_passes();
+            return 1;
         }
+        if (!report_passes()) return 1;
+
+        if (cache) cache->store(cache_key, ir, ops, reg);
     }
 
+    // 6) Dump IR (debug)
+    ir.dump();
+
     // 7) Execute (catch runtime errors so tests don't "Abort")
     try {
         loc::rt::Executor ex(reg);
+        ex.schedule = schedule;
+        loc::rt::Profiler profiler;
+        if (profile || !profile_trace.empty()) ex.profiler = &profiler;
+
+        // Reduced precision: an f64 run, printing nothing, is the reference
+        // every printed value is compared against.
+        const auto precision = loc::rt::precision();
+        std::vector<loc::rt::Matrix> reference, reduced;
+        if (precision != loc::rt::Precision::F64) {
+            loc::rt::set_precision(loc::rt::Precision::F64);
+            loc::rt::Executor ref(reg);
+            ref.schedule = schedule;
+            ref.print_stream = nullptr;
+            ref.on_print = [&](const loc::rt::Matrix& v) { reference.push_back(v); };
+            ref.run(ir);
+            loc::rt::set_precision(precision);
+            ex.on_print = [&](const loc::rt::Matrix& v) { reduced.push_back(v); };
+        }
+
+        loc::rt::reset_matrix_mem_stats();
+        const auto live_before = loc::rt::matrix_mem_stats().live_bytes;
+        const auto t0 = std::chrono::steady_clock::now();
         ex.run(ir);
+        const auto t1 = std::chrono::steady_clock::now();
+
+        if (stats) {
+            const auto ms = loc::rt::matrix_mem_stats();
+            std::cerr << "[stats] run time:            "
+                      << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms\n"
+                      << "[stats] IR nodes:            " << ir.nodes.size() << "\n"
+                      << "[stats] program cache:       " << (!cache ? "off" : cached ? "hit" : "miss") << "\n"
+                      << "[stats] matrix allocations:  " << ms.allocations << "\n"
+                      << "[stats] peak matrix memory:  " << (ms.peak_bytes - live_before)
+                      << " bytes above operators\n";
+            if (const auto* plan = ex.plan()) {
+                std::cerr << "[stats] planned arena:       " << plan->arena_elems * sizeof(double)
+                          << " bytes (naive sum " << plan->naive_elems * sizeof(double)
+                          << " bytes, " << plan->in_place << " in-place)\n";
+            }
+        }
+        if (profile) profiler.print_summary(std::cerr);
+        if (!profile_trace.empty()) {
+            std::ofstream out(profile_trace);
+            if (!out) {
+                std::cerr << "Error: could not write " << profile_trace << "\n";
+                return 1;
+            }
+            profiler.write_trace(out);
+        }
+        if (precision != loc::rt::Precision::F64) {
+            std::cerr << std::scientific << std::setprecision(2);
+            for (std::size_t i = 0; i < reduced.size() && i < reference.size(); ++i) {
+                const auto e = loc::rt::precision_error(reduced[i], reference[i]);
+                std::cerr << "[precision] " << loc::rt::precision_name(precision) << " print " << i + 1
+                          << ": max abs error " << e.max_abs << ", relative " << e.rel << "\n";
+            }
+            std::cerr << std::defaultfloat;
+        }
     } catch (const std::exception& e) {
         std::cerr << "[runtime error] " << e.what() << "\n";
         return 2; // clean nonzero exit (useful for expected-fail tests)
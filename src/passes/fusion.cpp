@@ -0,0 +1,100 @@
+#include "loc/passes/fusion.hpp"
+
+#include <vector>
+
+namespace loc::passes {
+using loc::ir::Graph;
+using loc::ir::Node;
+using loc::ir::NodeKind;
+
+namespace {
+
+bool is_elementwise(const Node& n) {
+    return n.kind == NodeKind::Add || n.kind == NodeKind::ScalarMul;
+}
+
+struct Fuser {
+    Graph& g;
+    std::vector<int> uses;     // consumer edges + prints
+    std::vector<int> consumer; // the consumer, for nodes with one use
+
+    explicit Fuser(Graph& graph) : g(graph) {
+        const std::size_t n = g.nodes.size();
+        uses.assign(n, 0);
+        consumer.assign(n, -1);
+        for (const auto& node : g.nodes) {
+            for (int in : node.inputs) {
+                ++uses[in];
+                consumer[in] = node.id;
+            }
+        }
+        // Assignments only bind names (no runtime effect); prints need the value.
+        for (const auto& s : g.program) {
+            if (s.kind == Graph::Stmt::Kind::Print && s.value >= 0) ++uses[s.value];
+        }
+    }
+
+    // Absorbed into its consumer's tree (never a root itself)
+    bool interior(int id) const {
+        return is_elementwise(g.nodes[id]) && uses[id] == 1 &&
+               consumer[id] >= 0 && is_elementwise(g.nodes[consumer[id]]);
+    }
+
+    void collect(int id, double c, std::vector<int>& xs, std::vector<double>& cs,
+                 int& absorbed) const {
+        const Node& n = g.nodes[id];
+        for (int in : n.inputs) {
+            const double ci = (n.kind == NodeKind::ScalarMul) ? c * n.scalar : c;
+            if (interior(in)) {
+                ++absorbed;
+                collect(in, ci, xs, cs, absorbed);
+                continue;
+            }
+            bool merged = false;
+            for (std::size_t i = 0; i < xs.size(); ++i) {
+                if (xs[i] == in) {
+                    cs[i] += ci;
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) {
+                xs.push_back(in);
+                cs.push_back(ci);
+            }
+        }
+    }
+};
+
+} // namespace
+
+void fuse_elementwise(Graph& g) {
+    Fuser f(g);
+
+    std::vector<int> xs;
+    std::vector<double> cs;
+    for (auto& n : g.nodes) {
+        if (!is_elementwise(n) || f.interior(n.id)) continue;
+
+        xs.clear();
+        cs.clear();
+        int absorbed = 0;
+        f.collect(n.id, 1.0, xs, cs, absorbed);
+        if (absorbed == 0) continue;
+
+        // Interiors are not roots, so the nodes collect() reads are never
+        // rewritten here; rewriting `n` in place keeps ids topological.
+        if (xs.size() == 1) {
+            n.kind = NodeKind::ScalarMul;
+            n.scalar = cs[0];
+            n.coeffs.clear();
+        } else {
+            n.kind = NodeKind::LinComb;
+            n.scalar = 0.0;
+            n.coeffs = cs;
+        }
+        n.inputs = xs;
+    }
+}
+
+} // namespace loc::passes
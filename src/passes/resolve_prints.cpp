@@ -22,10 +22,22 @@ static NodePtr clone_node(const Node& n) {
     if (auto comp = dynamic_cast<const ComposeExpr*>(&n)) {
         return std::make_unique<ComposeExpr>(clone_node(*comp->lhs), clone_node(*comp->rhs));
     }
+    if (auto pw = dynamic_cast<const PowExpr*>(&n)) {
+        return std::make_unique<PowExpr>(clone_node(*pw->base), pw->exponent);
+    }
+    if (auto tr = dynamic_cast<const TransposeExpr*>(&n)) {
+        return std::make_unique<TransposeExpr>(clone_node(*tr->expr));
+    }
+    if (auto ap = dynamic_cast<const ApplyExpr*>(&n)) {
+        return std::make_unique<ApplyExpr>(clone_node(*ap->op), clone_node(*ap->x));
+    }
 
     // Statements (usually not cloned here)
     if (auto od = dynamic_cast<const OperatorDecl*>(&n)) {
-        return std::make_unique<OperatorDecl>(od->name);
+        auto out = std::make_unique<OperatorDecl>(od->name);
+        out->init = od->init;
+        out->path = od->path;
+        return out;
     }
     if (auto asn = dynamic_cast<const AssignStmt*>(&n)) {
         return std::make_unique<AssignStmt>(asn->name, clone_node(*asn->expr));
@@ -120,9 +120,35 @@ static NodePtr simplify_compose(std::unique_ptr<ComposeExpr> c) {
     return c;
 }
 
+static NodePtr simplify_pow(std::unique_ptr<PowExpr> p) {
+    p->base = simplify_expr(std::move(p->base));
+
+    // Pull the scalar out of the power: (a*L)^k -> a^k * L^k
+    if (auto sm = dynamic_cast<ScalarMulExpr*>(p->base.get())) {
+        const double a = std::pow(sm->scalar, (double)p->exponent);
+        NodePtr L = std::move(sm->expr);
+        return simplify_expr(
+            std::make_unique<ScalarMulExpr>(a, std::make_unique<PowExpr>(std::move(L), p->exponent))
+        );
+    }
+
+    return p;
+}
+
 static NodePtr simplify_expr(NodePtr e) {
     if (!e) return e;
 
+    if (auto ap = dynamic_cast<ApplyExpr*>(e.get())) {
+        ap->op = simplify_expr(std::move(ap->op));
+        ap->x = simplify_expr(std::move(ap->x));
+        return e;
+    }
+
+    if (auto tr = dynamic_cast<TransposeExpr*>(e.get())) {
+        tr->expr = simplify_expr(std::move(tr->expr));
+        return e;
+    }
+
     if (dynamic_cast<AddExpr*>(e.get())) {
         NodePtr base = std::move(e);
         auto derived = std::unique_ptr<AddExpr>(static_cast<AddExpr*>(base.release()));
@@ -141,6 +167,12 @@ static NodePtr simplify_expr(NodePtr e) {
         return simplify_compose(std::move(derived));
     }
 
+    if (dynamic_cast<PowExpr*>(e.get())) {
+        NodePtr base = std::move(e);
+        auto derived = std::unique_ptr<PowExpr>(static_cast<PowExpr*>(base.release()));
+        return simplify_pow(std::move(derived));
+    }
+
     return e;
 }
 
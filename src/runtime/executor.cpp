@@ -1,77 +1,910 @@
 #include "loc/runtime/executor.hpp"
+#include "loc/ir/passes/liveness.hpp"
+#include "loc/runtime/gemm.hpp"
+#include "loc/runtime/simd.hpp"
+#include "loc/runtime/thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 
 namespace loc::rt {
 
+using Stmt = loc::ir::Graph::Stmt;
 
 void Executor::run(const loc::ir::Graph& g) {
+    bool has_sparse = false;
+    for (std::size_t id = 0; id < g.nodes.size() && !has_sparse; ++id) {
+        has_sparse = sparse_op(g, (int)id);
+    }
+    Schedule mode = schedule;
+    if (mode == Schedule::Auto) {
+        mode = global_pool().size() > 1 ? Schedule::Parallel : Schedule::Planned;
+    }
+    if (mode == Schedule::Planned && has_sparse) mode = Schedule::Serial;
+    if (profiler) profiler->start(g);
+    if (precision() != Precision::F64 && !has_sparse) {
+        run_reduced(g);
+        return;
+    }
+    if (mode == Schedule::Planned) {
+        if (planned_for_ != &g) prepare(g);
+        run_planned(g);
+        return;
+    }
+
+    const auto lv = loc::ir::passes::compute_liveness(g);
+
     // Resize and clear cache for the new run
-    cache_.assign(g.nodes.size(), std::nullopt);
+    cache_.assign(g.nodes.size(), nullptr);
+    sparse_.assign(g.nodes.size(), nullptr);
+    remaining_.reset(new std::atomic<int>[g.nodes.size()]);
+    for (size_t i = 0; i < g.nodes.size(); ++i) remaining_[i] = lv.uses[i];
+
+    if (mode == Schedule::Parallel) {
+        run_parallel(g, lv.order);
+        // Each node ran once; every further read was served from the cache
+        if (profiler) {
+            for (int id : lv.order) profiler->hit(id, lv.uses[id] > 1 ? lv.uses[id] - 1 : 0);
+        }
+        return;
+    }
 
     for (const auto& s : g.program) {
-        if (s.kind == loc::ir::Graph::Stmt::Kind::Assign) {
-            (void)eval(g, s.value);
-        } else if (s.kind == loc::ir::Graph::Stmt::Kind::Print) {
-            Matrix v = eval(g, s.value);
-            std::cout << "\n[print]\n" << v << "\n";
-        } else {
+        if (s.kind != Stmt::Kind::Assign && s.kind != Stmt::Kind::Print) {
             throw std::runtime_error("Executor: unknown stmt kind");
         }
+        eval(g, s.value);
+        emit_cached(s);
+        release(s.value);
+    }
+}
+
+void Executor::emit(const Stmt& s, const Matrix& v) const {
+    if (s.kind == Stmt::Kind::Print) {
+        if (print_stream) *print_stream << "\n[print]\n" << v << "\n";
+        if (on_print) on_print(v);
     }
 }
 
-Matrix Executor::eval(const loc::ir::Graph& g, int id) {
+void Executor::emit_cached(const Stmt& s) const {
+    if (const auto& sp = sparse_[s.value]) {
+        if (s.kind == Stmt::Kind::Print) emit(s, sp->to_dense());
+        return;
+    }
+    emit(s, *cache_[s.value]);
+}
+
+void Executor::eval(const loc::ir::Graph& g, int id) {
     if (id < 0 || id >= (int)g.nodes.size()) {
         throw std::runtime_error("Executor: invalid node id");
     }
 
     // Check cache
-    if (cache_[id].has_value()) {
-        // std::cout << "Computing node (cached) " << id << "\n"; // DEBUG
-        return *cache_[id];
+    if (cache_[id] || sparse_[id]) {
+        if (profiler) profiler->hit(id);
+        return;
     }
-    
-    // std::cout << "Computing node (fresh) " << id << "\n"; // DEBUG
 
+    for (int in : g.nodes[id].inputs) eval(g, in);
+
+    // Store in cache
+    compute_profiled(g, id);
+}
+
+void Executor::compute_profiled(const loc::ir::Graph& g, int id) {
+    const auto t0 = profiler ? Profiler::Clock::now() : Profiler::Clock::time_point{};
+    if (reads_sparse(g, id)) compute_sparse(g, id);
+    else cache_[id] = compute(g, id);
+    if (profiler) {
+        const auto t1 = Profiler::Clock::now();
+        if (const auto& sp = sparse_[id]) profiler->record(id, t0, t1, sp->rows(), sp->cols());
+        else profiler->record(id, t0, t1, cache_[id]->rows(), cache_[id]->cols());
+    }
+}
+
+std::shared_ptr<Matrix> Executor::take_if_dead(int id, std::size_t rows, std::size_t cols) {
+    const MatrixPtr& p = cache_[id];
+    if (remaining_[id].load() != 1 || p.use_count() != 1) return nullptr;
+    if (p->rows() != rows || p->cols() != cols) return nullptr;
+    // Cache slots are created from non-const Matrix objects, so casting the
+    // constness away on the sole owner is sound.
+    return std::const_pointer_cast<Matrix>(std::move(cache_[id]));
+}
+
+void Executor::release(int id) {
+    if (remaining_[id].fetch_sub(1) == 1) {
+        cache_[id].reset();
+        sparse_[id].reset();
+    }
+}
+
+const StructuredOp* Executor::structured(const loc::ir::Graph& g, int id) const {
     const auto& n = g.nodes[id];
-    using K = loc::ir::NodeKind; 
+    if (n.kind != loc::ir::NodeKind::Op) return nullptr;
+    const StructuredOp& s = reg_.structure(n.name);
+    return s.kind == Structure::Dense || s.kind == Structure::Sparse ? nullptr : &s;
+}
+
+std::shared_ptr<Matrix> Executor::structured_sum(const loc::ir::Graph& g, const loc::ir::Node& n) {
+    const bool add = n.kind == loc::ir::NodeKind::Add;
+    std::vector<double> dense_cs, struct_cs;
+    std::vector<int> dense;
+    std::vector<const StructuredOp*> structs;
+    for (std::size_t i = 0; i < n.inputs.size(); ++i) {
+        const double c = add ? 1.0 : n.coeffs[i];
+        if (const StructuredOp* s = structured(g, n.inputs[i])) {
+            structs.push_back(s);
+            struct_cs.push_back(c);
+        } else {
+            dense.push_back(n.inputs[i]);
+            dense_cs.push_back(c);
+        }
+    }
+    if (structs.empty()) return nullptr;
+
+    const Matrix& a = *cache_[n.inputs[0]];
+    for (int in : n.inputs) {
+        if (cache_[in]->rows() != a.rows() || cache_[in]->cols() != a.cols())
+            throw std::runtime_error("Matrix add: shape mismatch");
+    }
+
+    std::shared_ptr<Matrix> m;
+    if (dense.empty()) {
+        m = std::make_shared<Matrix>(a.rows(), a.cols(), 0.0);
+    } else {
+        std::vector<const Matrix*> xs;
+        for (int in : dense) xs.push_back(cache_[in].get());
+        int taken = -1;
+        for (int in : dense) {
+            if ((m = take_if_dead(in, a.rows(), a.cols()))) {
+                taken = in;
+                break;
+            }
+        }
+        if (!m) m = std::make_shared<Matrix>(Matrix::uninitialized(a.rows(), a.cols()));
+        // x + S with x dead: S is added to x's own buffer, O(n) in all
+        if (!(dense.size() == 1 && dense_cs[0] == 1.0 && taken == dense[0])) {
+            lincomb_into(dense_cs, xs, *m);
+        }
+    }
+    for (std::size_t i = 0; i < structs.size(); ++i) structured_axpy(struct_cs[i], *structs[i], *m);
+    return m;
+}
 
-    Matrix result;
+MatrixPtr Executor::compute(const loc::ir::Graph& g, int id) {
+    using K = loc::ir::NodeKind;
+    const auto& n = g.nodes[id];
 
+    MatrixPtr out;
     switch (n.kind) {
     case K::Op:
-        result = reg_.get(n.name);
+        out = reg_.get_shared(n.name); // zero-copy
         break;
 
     case K::ScalarMul: {
-        Matrix a = eval(g, n.inputs.at(0));
-        result = a * n.scalar;
+        const Matrix& a = *cache_[n.inputs.at(0)];
+        if (auto m = take_if_dead(n.inputs[0], a.rows(), a.cols())) {
+            *m *= n.scalar;
+            out = std::move(m);
+        } else {
+            out = std::make_shared<Matrix>(a * n.scalar);
+        }
         break;
     }
 
+    case K::Zero:
+        out = std::make_shared<Matrix>(n.rows, n.cols, 0.0);
+        break;
+
     case K::Add: {
-        Matrix a = eval(g, n.inputs.at(0));
-        Matrix b = eval(g, n.inputs.at(1));
-        result = a + b;
+        if (auto m = structured_sum(g, n)) {
+            out = std::move(m);
+            break;
+        }
+        const int x = n.inputs.at(0), y = n.inputs.at(1);
+        const Matrix& a = *cache_[x];
+        const Matrix& b = *cache_[y];
+        // Only reuse when shapes agree; a mismatch falls through to the
+        // checked operator+ below, which reports it.
+        const bool same = a.rows() == b.rows() && a.cols() == b.cols();
+        if (auto m = same ? take_if_dead(x, a.rows(), a.cols()) : nullptr) {
+            *m += *cache_[y];
+            out = std::move(m);
+        } else if (auto m2 = same ? take_if_dead(y, b.rows(), b.cols()) : nullptr) {
+            *m2 += *cache_[x]; // IEEE addition is commutative: same bits as a + b
+            out = std::move(m2);
+        } else {
+            out = std::make_shared<Matrix>(a + b);
+        }
         break;
     }
 
     case K::Compose: {
-        Matrix a = eval(g, n.inputs.at(0));
-        Matrix b = eval(g, n.inputs.at(1));
-        result = a.matmul(b);
+        const StructuredOp* sa = structured(g, n.inputs.at(0));
+        const StructuredOp* sb = structured(g, n.inputs.at(1));
+        if (sa || sb) {
+            const Matrix& a = *cache_[n.inputs[0]];
+            const Matrix& b = *cache_[n.inputs[1]];
+            auto m = std::make_shared<Matrix>(Matrix::uninitialized(a.rows(), b.cols()));
+            structured_gemm_into(1.0, a, sa, b, sb, 0.0, nullptr, *m);
+            out = std::move(m);
+        } else if (n.trans_a || n.trans_b) {
+            const Matrix& a = *cache_[n.inputs[0]];
+            const Matrix& b = *cache_[n.inputs[1]];
+            auto m = std::make_shared<Matrix>(Matrix::uninitialized(n.trans_a ? a.cols() : a.rows(),
+                                                                    n.trans_b ? b.rows() : b.cols()));
+            gemm_into(1.0, a, n.trans_a, b, n.trans_b, 0.0, nullptr, *m);
+            out = std::move(m);
+        } else {
+            out = std::make_shared<Matrix>(cache_[n.inputs[0]]->matmul(*cache_[n.inputs[1]]));
+        }
+        break;
+    }
+
+    case K::Gemm: {
+        const Matrix& a = *cache_[n.inputs.at(0)];
+        const Matrix& b = *cache_[n.inputs.at(1)];
+        const Matrix* c = n.inputs.size() > 2 ? cache_[n.inputs[2]].get() : nullptr;
+        const std::size_t rows = n.trans_a ? a.cols() : a.rows(), cols = n.trans_b ? b.rows() : b.cols();
+        // Accumulate into a dying C in place (dgemm style), else a new buffer
+        std::shared_ptr<Matrix> m;
+        if (c) m = take_if_dead(n.inputs[2], rows, cols);
+        if (!m) m = std::make_shared<Matrix>(Matrix::uninitialized(rows, cols));
+        // Transposed factors are never structured (gemm_epilogue)
+        const StructuredOp* sa = structured(g, n.inputs[0]);
+        const StructuredOp* sb = structured(g, n.inputs[1]);
+        if (sa || sb) structured_gemm_into(n.alpha, a, sa, b, sb, n.beta, c, *m);
+        else gemm_into(n.alpha, a, n.trans_a, b, n.trans_b, n.beta, c, *m);
+        out = std::move(m);
+        break;
+    }
+
+    case K::Transpose:
+        out = std::make_shared<Matrix>(cache_[n.inputs.at(0)]->transpose());
+        break;
+
+    case K::LinComb: {
+        if (auto m = structured_sum(g, n)) {
+            out = std::move(m);
+            break;
+        }
+        std::vector<const Matrix*> xs;
+        xs.reserve(n.inputs.size());
+        for (int in : n.inputs) xs.push_back(cache_[in].get());
+
+        const Matrix& a = *xs.at(0);
+        std::shared_ptr<Matrix> m;
+        for (int in : n.inputs) {
+            if ((m = take_if_dead(in, a.rows(), a.cols()))) break;
+        }
+        if (!m) m = std::make_shared<Matrix>(Matrix::uninitialized(a.rows(), a.cols()));
+        lincomb_into(n.coeffs, xs, *m); // `xs` stay valid: taking only moves ownership
+        out = std::move(m);
         break;
     }
-    
+
+    case K::Pow:
+        out = std::make_shared<Matrix>(power(*cache_[n.inputs.at(0)], n.exponent));
+        break;
+
     default:
         throw std::runtime_error("Executor: unreachable");
     }
 
-    // Store in cache
-    cache_[id] = result;
-    return result;
+    for (int in : n.inputs) release(in);
+    return out;
 }
 
-} // namespace loc::rt
+// ---------- Matrix-free application ----------
 
+Matrix Executor::apply(const loc::ir::Graph& g, int op, const Matrix& x) {
+    if (op < 0 || op >= (int)g.nodes.size()) {
+        throw std::runtime_error("Executor: invalid node id");
+    }
+    // Every x reaching apply_node() is the caller's or a memoized result,
+    // so the memo's pointer keys stay valid
+    std::map<std::tuple<int, bool, const Matrix*>, MatrixPtr> memo;
+    MatrixPtr out = apply_node(g, op, false, MatrixPtr(&x, [](const Matrix*) {}), memo);
+    memo.clear();
+    if (out.get() == &x) return x; // e.g. A^0
+    if (out.use_count() == 1) return std::move(*std::const_pointer_cast<Matrix>(out));
+    return *out;
+}
+
+Matrix Executor::apply(const loc::ir::Graph& g, const std::string& name, const Matrix& x) {
+    for (auto it = g.program.rbegin(); it != g.program.rend(); ++it) {
+        if (it->kind == Stmt::Kind::Assign && it->name == name) return apply(g, it->value, x);
+    }
+    for (const auto& n : g.nodes) {
+        if (n.kind == loc::ir::NodeKind::Op && n.name == name) return apply(g, n.id, x);
+    }
+    throw std::runtime_error("Executor: no operator or assignment named '" + name + "'");
+}
+
+MatrixPtr Executor::apply_node(const loc::ir::Graph& g, int op, bool trans, const MatrixPtr& x,
+                               std::map<std::tuple<int, bool, const Matrix*>, MatrixPtr>& memo) {
+    using K = loc::ir::NodeKind;
+    const auto key = std::make_tuple(op, trans, x.get());
+    if (auto it = memo.find(key); it != memo.end()) return it->second;
+
+    const auto& n = g.nodes[op];
+    auto sub = [&](int in, bool t, const MatrixPtr& v) { return apply_node(g, in, t, v, memo); };
+    auto uninit = [](std::size_t r, std::size_t c) {
+        return std::make_shared<Matrix>(Matrix::uninitialized(r, c));
+    };
+
+    MatrixPtr out;
+    switch (n.kind) {
+    case K::Op: {
+        std::shared_ptr<Matrix> m;
+        if (SparsePtr sp = reg_.get_sparse(n.name)) {
+            if (trans) sp = std::make_shared<const SparseMatrix>(sp->transposed());
+            m = uninit(sp->rows(), x->cols());
+            spmm_into(1.0, *sp, *x, 0.0, nullptr, *m);
+        } else {
+            const Matrix& a = reg_.get(n.name);
+            const StructuredOp* s = structured(g, op);
+            if (s && s->kind == Structure::Zero && trans) {
+                // The transpose of a zero operator (not necessarily square)
+                // is the zero of the swapped shape; x is not read
+                if (a.rows() != x->rows()) throw std::runtime_error("Matrix matmul: shape mismatch");
+                m = std::make_shared<Matrix>(a.cols(), x->cols(), 0.0);
+            } else {
+                m = uninit(trans ? a.cols() : a.rows(), x->cols());
+                // Of the other structured kinds only a permutation differs from its transpose
+                if (s && !(trans && s->kind == Structure::Permutation)) structured_gemm_into(1.0, a, s, *x, nullptr, 0.0, nullptr, *m);
+                else gemm_into(1.0, a, trans, *x, false, 0.0, nullptr, *m);
+            }
+        }
+        out = std::move(m);
+        break;
+    }
+
+    case K::Zero: {
+        const std::size_t rows = trans ? n.cols : n.rows, cols = trans ? n.rows : n.cols;
+        if (cols != x->rows()) throw std::runtime_error("Matrix matmul: shape mismatch");
+        out = std::make_shared<Matrix>(rows, x->cols(), 0.0);
+        break;
+    }
+
+    case K::ScalarMul:
+        out = std::make_shared<Matrix>(n.scalar * *sub(n.inputs.at(0), trans, x));
+        break;
+
+    case K::Add:
+        out = std::make_shared<Matrix>(*sub(n.inputs.at(0), trans, x) + *sub(n.inputs.at(1), trans, x));
+        break;
+
+    case K::LinComb: {
+        std::vector<MatrixPtr> ys;
+        std::vector<const Matrix*> xs;
+        for (int in : n.inputs) {
+            ys.push_back(sub(in, trans, x));
+            xs.push_back(ys.back().get());
+        }
+        auto m = uninit(xs.at(0)->rows(), xs[0]->cols());
+        lincomb_into(n.coeffs, xs, *m);
+        out = std::move(m);
+        break;
+    }
+
+    case K::Compose:
+    case K::Gemm: {
+        // op(A) op(B) x = op(A) (op(B) x); transposed, op(B)' (op(A)' x)
+        const int a = n.inputs.at(0), b = n.inputs.at(1);
+        const MatrixPtr p = trans ? sub(b, !n.trans_b, sub(a, !n.trans_a, x))
+                                  : sub(a, n.trans_a, sub(b, n.trans_b, x));
+        if (n.kind == K::Compose) out = p;
+        else if (n.inputs.size() > 2) out = std::make_shared<Matrix>(axpby(n.alpha, *p, n.beta, *sub(n.inputs[2], trans, x)));
+        else out = std::make_shared<Matrix>(n.alpha * *p);
+        break;
+    }
+
+    case K::Pow: {
+        // k products of x's width, or op(A)^k by repeated squaring when
+        // that is cheaper (unroll_power_apply); op(A) is then formed by
+        // applying it to the identity
+        if (loc::ir::unroll_power_apply(x->rows(), x->cols(), n.exponent)) {
+            out = x;
+            for (std::uint64_t i = 0; i < n.exponent; ++i) out = sub(n.inputs.at(0), trans, out);
+            break;
+        }
+        // Kept alive with the memo: its address keys the products below
+        auto eye = std::make_shared<Matrix>(Matrix::identity(x->rows()));
+        memo[std::make_tuple(-1, false, eye.get())] = eye;
+        const Matrix p = power(*sub(n.inputs.at(0), trans, eye), n.exponent);
+        auto m = uninit(p.rows(), x->cols());
+        gemm_into(1.0, p, false, *x, false, 0.0, nullptr, *m);
+        out = std::move(m);
+        break;
+    }
+
+    case K::Transpose:
+        out = sub(n.inputs.at(0), !trans, x);
+        break;
+
+    default:
+        throw std::runtime_error("Executor: unreachable");
+    }
+
+    memo[key] = out;
+    return out;
+}
+
+// ---------- Sparse operands ----------
+
+bool Executor::sparse_op(const loc::ir::Graph& g, int id) const {
+    const auto& n = g.nodes[id];
+    return n.kind == loc::ir::NodeKind::Op && reg_.structure(n.name).kind == Structure::Sparse;
+}
+
+bool Executor::reads_sparse(const loc::ir::Graph& g, int id) const {
+    if (sparse_op(g, id)) return true;
+    for (int in : g.nodes[id].inputs) {
+        if (sparse_[in]) return true;
+    }
+    return false;
+}
+
+void Executor::compute_sparse(const loc::ir::Graph& g, int id) {
+    using K = loc::ir::NodeKind;
+    const auto& n = g.nodes[id];
+    auto sp = [&](int v) { return sparse_[v].get(); };
+    auto rows = [&](int v) { return sp(v) ? sp(v)->rows() : cache_[v]->rows(); };
+    auto cols = [&](int v) { return sp(v) ? sp(v)->cols() : cache_[v]->cols(); };
+
+    SparsePtr s;                 // the result, if sparse
+    std::shared_ptr<Matrix> m;   // else dense
+    switch (n.kind) {
+    case K::Op:
+        sparse_[id] = reg_.get_sparse(n.name);
+        return;
+
+    case K::ScalarMul:
+        s = std::make_shared<const SparseMatrix>(sparse_lincomb({n.scalar}, {sp(n.inputs.at(0))}));
+        break;
+
+    case K::Add:
+    case K::LinComb: {
+        const bool add = n.kind == K::Add;
+        std::vector<double> dense_cs, sparse_cs;
+        std::vector<int> dense;
+        std::vector<const SparseMatrix*> sparse;
+        for (std::size_t i = 0; i < n.inputs.size(); ++i) {
+            const double c = add ? 1.0 : n.coeffs[i];
+            if (sp(n.inputs[i])) {
+                sparse.push_back(sp(n.inputs[i]));
+                sparse_cs.push_back(c);
+            } else {
+                dense.push_back(n.inputs[i]);
+                dense_cs.push_back(c);
+            }
+        }
+        const int a = n.inputs.at(0);
+        for (int in : n.inputs) {
+            if (rows(in) != rows(a) || cols(in) != cols(a)) throw std::runtime_error("Matrix add: shape mismatch");
+        }
+        if (dense.empty()) {
+            s = std::make_shared<const SparseMatrix>(sparse_lincomb(sparse_cs, sparse));
+            break;
+        }
+        // Dense terms as usual, then each sparse one over its nonzeros
+        std::vector<const Matrix*> xs;
+        for (int in : dense) xs.push_back(cache_[in].get());
+        int taken = -1;
+        for (int in : dense) {
+            if ((m = take_if_dead(in, rows(a), cols(a)))) {
+                taken = in;
+                break;
+            }
+        }
+        if (!m) m = std::make_shared<Matrix>(Matrix::uninitialized(rows(a), cols(a)));
+        if (!(dense.size() == 1 && dense_cs[0] == 1.0 && taken == dense[0])) lincomb_into(dense_cs, xs, *m);
+        for (std::size_t i = 0; i < sparse.size(); ++i) sparse_axpy(sparse_cs[i], *sparse[i], *m);
+        break;
+    }
+
+    case K::Compose:
+    case K::Gemm: {
+        // alpha * (a @ b) [+ beta * c]; Compose is alpha = 1 without c
+        const int a = n.inputs.at(0), b = n.inputs.at(1);
+        const int c = n.kind == K::Gemm && n.inputs.size() > 2 ? n.inputs[2] : -1;
+        const double alpha = n.kind == K::Gemm ? n.alpha : 1.0;
+        const double beta = n.kind == K::Gemm ? n.beta : 0.0;
+
+        // Transposed factors: a sparse one is transposed in O(nnz) (its CSC
+        // copy), a dense one is read in place by the GEMM kernel, or copied
+        // when the other factor is sparse
+        SparsePtr sa = sparse_[a], sb = sparse_[b];
+        MatrixPtr da = cache_[a], db = cache_[b];
+        bool ta = n.trans_a, tb = n.trans_b;
+        if (ta && (sa || sb)) {
+            if (sa) sa = std::make_shared<const SparseMatrix>(sa->transposed());
+            else da = std::make_shared<Matrix>(da->transpose());
+            ta = false;
+        }
+        if (tb && (sa || sb)) {
+            if (sb) sb = std::make_shared<const SparseMatrix>(sb->transposed());
+            else db = std::make_shared<Matrix>(db->transpose());
+            tb = false;
+        }
+        const std::size_t ra = sa ? sa->rows() : ta ? da->cols() : da->rows();
+        const std::size_t ka = sa ? sa->cols() : ta ? da->rows() : da->cols();
+        const std::size_t kb = sb ? sb->rows() : tb ? db->cols() : db->rows();
+        const std::size_t cb = sb ? sb->cols() : tb ? db->rows() : db->cols();
+        if (ka != kb) throw std::runtime_error("Matrix matmul: shape mismatch");
+        if (c >= 0 && (rows(c) != ra || cols(c) != cb))
+            throw std::runtime_error("Matrix add: shape mismatch");
+
+        if (sa && sb) {
+            SparseMatrix prod = spgemm(alpha, *sa, *sb);
+            if (c < 0) {
+                s = std::make_shared<const SparseMatrix>(std::move(prod));
+            } else if (sp(c)) {
+                s = std::make_shared<const SparseMatrix>(sparse_lincomb({1.0, beta}, {&prod, sp(c)}));
+            } else {
+                // beta * c, then the product's nonzeros on top
+                if ((m = take_if_dead(c, rows(c), cols(c)))) *m *= beta;
+                else m = std::make_shared<Matrix>(beta * *cache_[c]);
+                sparse_axpy(1.0, prod, *m);
+            }
+            break;
+        }
+
+        // Dense result: a dense c goes through the kernel's epilogue (in
+        // place if it is dying), a sparse c is added after
+        const Matrix* cd = c >= 0 && !sp(c) ? cache_[c].get() : nullptr;
+        if (cd) m = take_if_dead(c, ra, cb);
+        if (!m) m = std::make_shared<Matrix>(Matrix::uninitialized(ra, cb));
+        if (sa) {
+            spmm_into(alpha, *sa, *db, beta, cd, *m);
+        } else if (sb) {
+            dense_spmm_into(alpha, *da, *sb, beta, cd, *m);
+        } else {
+            const StructuredOp* sta = structured(g, a);
+            const StructuredOp* stb = structured(g, b);
+            if (sta || stb) structured_gemm_into(alpha, *da, sta, *db, stb, 0.0, nullptr, *m);
+            else gemm_into(alpha, *da, ta, *db, tb, 0.0, nullptr, *m);
+        }
+        if (c >= 0 && sp(c)) sparse_axpy(beta, *sp(c), *m);
+        break;
+    }
+
+    case K::Transpose:
+        s = std::make_shared<const SparseMatrix>(sp(n.inputs.at(0))->transposed());
+        break;
+
+    case K::Pow: {
+        // Sparse while the powers stay under the density policy, else dense
+        const SparseMatrix& a = *sp(n.inputs.at(0));
+        SparseMatrix p;
+        if (sparse_power(a, n.exponent, sparse_max_density(), p)) s = std::make_shared<const SparseMatrix>(std::move(p));
+        else m = std::make_shared<Matrix>(power(a.to_dense(), n.exponent));
+        break;
+    }
+
+    default:
+        throw std::runtime_error("Executor: unreachable");
+    }
+
+    // Density policy: a sum or product that filled in goes back to dense
+    if (s && n.kind != K::ScalarMul && n.kind != K::Transpose && s->density() > sparse_max_density()) {
+        m = std::make_shared<Matrix>(s->to_dense());
+        s.reset();
+    }
+    if (s) sparse_[id] = std::move(s);
+    else cache_[id] = std::move(m);
+
+    for (int in : n.inputs) release(in);
+}
+
+// ---------- Reduced precision ----------
+
+// Node `n` over float values (`vals`, one slot per node id); structured
+// operators are read as the dense matrices the registry also holds.
+static std::shared_ptr<const MatrixF32> compute_f32(const Registry& reg, const loc::ir::Node& n,
+                                                    const std::vector<std::shared_ptr<const MatrixF32>>& vals) {
+    using K = loc::ir::NodeKind;
+    auto in = [&](std::size_t i) -> const MatrixF32& { return *vals[n.inputs.at(i)]; };
+
+    switch (n.kind) {
+    case K::Op:
+        return std::make_shared<MatrixF32>(to_f32(*reg.get_shared(n.name)));
+    case K::ScalarMul:
+        return std::make_shared<MatrixF32>(n.scalar * in(0));
+    case K::Zero:
+        return std::make_shared<MatrixF32>(n.rows, n.cols, 0.0);
+    case K::Add:
+        return std::make_shared<MatrixF32>(in(0) + in(1));
+    case K::Compose:
+    case K::Gemm: {
+        const MatrixF32& a = in(0);
+        const MatrixF32& b = in(1);
+        const MatrixF32* c = n.kind == K::Gemm && n.inputs.size() > 2 ? &in(2) : nullptr;
+        const double alpha = n.kind == K::Gemm ? n.alpha : 1.0;
+        auto m = std::make_shared<MatrixF32>(MatrixF32::uninitialized(n.trans_a ? a.cols() : a.rows(),
+                                                                      n.trans_b ? b.rows() : b.cols()));
+        gemm_into(alpha, a, n.trans_a, b, n.trans_b, n.beta, c, *m);
+        return m;
+    }
+    case K::Transpose:
+        return std::make_shared<MatrixF32>(in(0).transpose());
+    case K::LinComb: {
+        std::vector<const MatrixF32*> xs;
+        xs.reserve(n.inputs.size());
+        for (int id : n.inputs) xs.push_back(vals[id].get());
+        auto m = std::make_shared<MatrixF32>(MatrixF32::uninitialized(xs.at(0)->rows(), xs[0]->cols()));
+        lincomb_into(n.coeffs, xs, *m);
+        return m;
+    }
+    case K::Pow:
+        return std::make_shared<MatrixF32>(power(in(0), n.exponent));
+    }
+    throw std::runtime_error("Executor: unreachable");
+}
+
+void Executor::run_reduced(const loc::ir::Graph& g) {
+    const auto lv = loc::ir::passes::compute_liveness(g);
+    std::vector<std::shared_ptr<const MatrixF32>> vals(g.nodes.size());
+    std::vector<int> remaining = lv.uses;
+    auto release = [&](int id) {
+        if (--remaining[id] == 0) vals[id].reset();
+    };
+
+    std::function<void(int)> eval = [&](int id) {
+        if (vals[id]) {
+            if (profiler) profiler->hit(id);
+            return;
+        }
+        const auto& n = g.nodes[id];
+        for (int in : n.inputs) eval(in);
+        const auto t0 = profiler ? Profiler::Clock::now() : Profiler::Clock::time_point{};
+        vals[id] = compute_f32(reg_, n, vals);
+        if (profiler) profiler->record(id, t0, Profiler::Clock::now(), vals[id]->rows(), vals[id]->cols());
+        for (int in : n.inputs) release(in);
+    };
+
+    for (const auto& s : g.program) {
+        if (s.kind != Stmt::Kind::Assign && s.kind != Stmt::Kind::Print) {
+            throw std::runtime_error("Executor: unknown stmt kind");
+        }
+        if (s.value < 0 || s.value >= (int)g.nodes.size()) {
+            throw std::runtime_error("Executor: invalid node id");
+        }
+        eval(s.value);
+        if (s.kind == Stmt::Kind::Print) emit(s, to_f64(*vals[s.value]));
+        release(s.value);
+    }
+}
+
+// ---------- Planned (static arena) schedule ----------
+
+void Executor::prepare(const loc::ir::Graph& g) {
+    plan_ = std::make_unique<MemoryPlan>(plan_memory(g, reg_));
+    planned_for_ = &g;
+
+    // Grow-only: a program that fits the current arena reuses it as is.
+    if (arena_.size() < plan_->arena_elems) {
+        arena_.clear();
+        arena_.shrink_to_fit();
+        arena_.resize(plan_->arena_elems);
+    }
+
+    views_.clear();
+    views_.resize(g.nodes.size());
+    values_.assign(g.nodes.size(), nullptr);
+    structs_.assign(g.nodes.size(), nullptr);
+    for (int id : plan_->liveness.order) {
+        if (g.nodes[id].kind == loc::ir::NodeKind::Op) {
+            if (sparse_op(g, id)) continue; // such graphs run Serial
+            values_[id] = &reg_.get(g.nodes[id].name);
+            structs_[id] = structured(g, id);
+        } else {
+            views_[id] = Matrix::view(plan_->rows[id], plan_->cols[id],
+                                      arena_.data() + plan_->offset[id]);
+            values_[id] = &views_[id];
+        }
+    }
+}
+
+void Executor::run_planned(const loc::ir::Graph& g) {
+    using K = loc::ir::NodeKind;
+    const auto& lv = plan_->liveness;
+
+    int step = 0;
+    for (size_t i = 0; i < g.program.size(); ++i) {
+        for (; step < lv.stmt_end[i]; ++step) {
+            const int id = lv.order[step];
+            const auto& n = g.nodes[id];
+            Matrix& out = views_[id];
+            const auto t0 = profiler ? Profiler::Clock::now() : Profiler::Clock::time_point{};
+
+            // Shapes were checked once by plan_memory: call the kernels
+            // directly, without per-node checks.
+            switch (n.kind) {
+            case K::Op:
+                break;
+            case K::Zero:
+                std::fill(out.data(), out.data() + out.size(), 0.0);
+                break;
+            case K::ScalarMul:
+                simd::scale(n.scalar, values_[n.inputs[0]]->data(), out.data(), out.size());
+                break;
+            case K::Add:
+                if (structs_[n.inputs[0]] || structs_[n.inputs[1]]) {
+                    planned_sum(n, out);
+                    break;
+                }
+                simd::add(values_[n.inputs[0]]->data(), values_[n.inputs[1]]->data(),
+                          out.data(), out.size());
+                break;
+            case K::LinComb:
+                if (std::any_of(n.inputs.begin(), n.inputs.end(), [&](int in) { return structs_[in]; })) {
+                    planned_sum(n, out);
+                    break;
+                }
+                ptrs_.clear();
+                for (int in : n.inputs) ptrs_.push_back(values_[in]->data());
+                simd::lincomb(ptrs_.size(), n.coeffs.data(), ptrs_.data(), out.data(), out.size());
+                break;
+            case K::Compose: {
+                const Matrix& a = *values_[n.inputs[0]];
+                const Matrix& b = *values_[n.inputs[1]];
+                if (structs_[n.inputs[0]] || structs_[n.inputs[1]]) {
+                    structured_gemm_into(1.0, a, structs_[n.inputs[0]], b, structs_[n.inputs[1]],
+                                         0.0, nullptr, out);
+                    break;
+                }
+                gemm(n.trans_a ? Trans::T : Trans::N, n.trans_b ? Trans::T : Trans::N,
+                     out.rows(), out.cols(), n.trans_a ? a.rows() : a.cols(),
+                     1.0, a.data(), a.cols(),
+                     b.data(), b.cols(),
+                     0.0, out.data(), out.cols(), out.data(), out.cols());
+                break;
+            }
+            case K::Gemm: {
+                const Matrix& a = *values_[n.inputs[0]];
+                const Matrix& b = *values_[n.inputs[1]];
+                const Matrix& c = n.inputs.size() > 2 ? *values_[n.inputs[2]] : out;
+                if (structs_[n.inputs[0]] || structs_[n.inputs[1]]) {
+                    structured_gemm_into(n.alpha, a, structs_[n.inputs[0]], b, structs_[n.inputs[1]],
+                                         n.beta, n.inputs.size() > 2 ? &c : nullptr, out);
+                    break;
+                }
+                gemm(n.trans_a ? Trans::T : Trans::N, n.trans_b ? Trans::T : Trans::N,
+                     out.rows(), out.cols(), n.trans_a ? a.rows() : a.cols(),
+                     n.alpha, a.data(), a.cols(),
+                     b.data(), b.cols(),
+                     n.inputs.size() > 2 ? n.beta : 0.0, c.data(), c.cols(),
+                     out.data(), out.cols());
+                break;
+            }
+            case K::Transpose:
+                transpose_into(*values_[n.inputs[0]], out);
+                break;
+            case K::Pow: {
+                const std::size_t sc = plan_->scratch[id];
+                power_into(*values_[n.inputs[0]], n.exponent, out,
+                           sc == MemoryPlan::kNoSlot ? nullptr : arena_.data() + sc);
+                break;
+            }
+            default:
+                throw std::runtime_error("Executor: unreachable");
+            }
+            if (profiler) {
+                profiler->record(id, t0, Profiler::Clock::now(),
+                                 values_[id]->rows(), values_[id]->cols());
+                profiler->hit(id, lv.uses[id] > 1 ? lv.uses[id] - 1 : 0);
+            }
+        }
+        emit(g.program[i], *values_[g.program[i].value]);
+    }
+}
+
+void Executor::planned_sum(const loc::ir::Node& n, Matrix& out) {
+    const bool add = n.kind == loc::ir::NodeKind::Add;
+    ptrs_.clear();
+    coeffs_.clear();
+    for (std::size_t i = 0; i < n.inputs.size(); ++i) {
+        if (structs_[n.inputs[i]]) continue;
+        ptrs_.push_back(values_[n.inputs[i]]->data());
+        coeffs_.push_back(add ? 1.0 : n.coeffs[i]);
+    }
+    if (ptrs_.empty()) {
+        std::fill(out.data(), out.data() + out.size(), 0.0);
+    } else if (!(ptrs_.size() == 1 && coeffs_[0] == 1.0 && ptrs_[0] == out.data())) {
+        simd::lincomb(ptrs_.size(), coeffs_.data(), ptrs_.data(), out.data(), out.size());
+    }
+    for (std::size_t i = 0; i < n.inputs.size(); ++i) {
+        if (const StructuredOp* s = structs_[n.inputs[i]]) structured_axpy(add ? 1.0 : n.coeffs[i], *s, out);
+    }
+}
+
+// ---------- Parallel DAG scheduling ----------
+//
+// Live nodes (reachable from the program) are ordered topologically; each
+// node carries a counter of unfinished input edges. Nodes whose counter is
+// zero are submitted to the work-stealing pool, and finishing a node
+// decrements its consumers' counters, submitting those that reach zero.
+// The calling thread walks the program in order, helping the pool until the
+// statement's node is done, and prints from there.
+
+namespace {
+
+struct DagRun {
+    std::vector<std::vector<int>> consumers;     // node -> consumers (one per edge)
+    std::unique_ptr<std::atomic<int>[]> pending; // unfinished input edges
+    std::unique_ptr<std::atomic<bool>[]> done;
+    std::atomic<int> inflight{0};
+    std::atomic<bool> failed{false};
+    std::mutex err_mu;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+void Executor::run_parallel(const loc::ir::Graph& g, const std::vector<int>& order) {
+    ThreadPool& pool = global_pool();
+
+    DagRun st;
+    st.consumers.resize(g.nodes.size());
+    st.pending.reset(new std::atomic<int>[g.nodes.size()]);
+    st.done.reset(new std::atomic<bool>[g.nodes.size()]);
+    for (size_t i = 0; i < g.nodes.size(); ++i) {
+        st.pending[i] = 0;
+        st.done[i] = false;
+    }
+    for (int id : order) {
+        for (int in : g.nodes[id].inputs) {
+            st.consumers[in].push_back(id);
+            ++st.pending[id];
+        }
+    }
+
+    std::function<void(int)> schedule = [&](int id) {
+        st.inflight.fetch_add(1);
+        pool.submit([&, id] {
+            if (!st.failed) {
+                try {
+                    compute_profiled(g, id);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk(st.err_mu);
+                    if (!st.error) st.error = std::current_exception();
+                    st.failed = true;
+                }
+            }
+            st.done[id] = true;
+            if (!st.failed) {
+                for (int c : st.consumers[id]) {
+                    if (st.pending[c].fetch_sub(1) == 1) schedule(c);
+                }
+            }
+            st.inflight.fetch_sub(1);
+        });
+    };
+
+    // Collect sources before submitting any: once tasks run, a zero counter
+    // no longer means "not yet scheduled".
+    std::vector<int> sources;
+    for (int id : order) {
+        if (st.pending[id] == 0) sources.push_back(id);
+    }
+    for (int id : sources) schedule(id);
+
+    for (const auto& s : g.program) {
+        pool.help_until([&] { return st.done[s.value].load() || st.failed.load(); });
+        if (st.failed) break;
+        emit_cached(s);
+        release(s.value);
+    }
+
+    // Tasks reference `st`; let every one of them retire before returning.
+    pool.help_until([&] { return st.inflight.load() == 0; });
+    if (st.error) std::rethrow_exception(st.error);
+}
+
+} // namespace loc::rt
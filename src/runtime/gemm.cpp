@@ -0,0 +1,583 @@
+#include "loc/runtime/gemm.hpp"
+#include "loc/runtime/simd.hpp"
+#include "loc/runtime/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LOC_GEMM_X86 1
+#include <immintrin.h>
+#define LOC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace loc::rt {
+
+// ---------- Kernel selection ----------
+
+static GemmKernel kernel_from_env() {
+    GemmKernel k = GemmKernel::Blocked;
+    if (const char* s = std::getenv("LOC_GEMM")) {
+        parse_gemm_kernel(s, k); // unknown names keep the default
+    }
+    return k;
+}
+
+static std::atomic<int>& kernel_slot() {
+    static std::atomic<int> slot{(int)kernel_from_env()};
+    return slot;
+}
+
+void set_gemm_kernel(GemmKernel k) {
+    kernel_slot().store((int)k, std::memory_order_relaxed);
+}
+
+GemmKernel gemm_kernel() {
+    return (GemmKernel)kernel_slot().load(std::memory_order_relaxed);
+}
+
+bool parse_gemm_kernel(const std::string& s, GemmKernel& out) {
+    if (s == "naive")   { out = GemmKernel::Naive;   return true; }
+    if (s == "blocked") { out = GemmKernel::Blocked; return true; }
+    return false;
+}
+
+const char* gemm_kernel_name(GemmKernel k) {
+    switch (k) {
+        case GemmKernel::Naive:   return "naive";
+        case GemmKernel::Blocked: return "blocked";
+    }
+    return "?";
+}
+
+static std::atomic<std::size_t>& mt_min_slot() {
+    static std::atomic<std::size_t> slot{[] {
+        std::size_t v = kGemmMtMinDefault;
+        if (const char* s = std::getenv("LOC_GEMM_MT_MIN")) {
+            const char* end = s + std::strlen(s);
+            std::size_t x = 0;
+            const auto [p, ec] = std::from_chars(s, end, x);
+            if (p != s && p == end) v = ec == std::errc() ? x : SIZE_MAX; // past SIZE_MAX: never split
+        }
+        return v;
+    }()};
+    return slot;
+}
+
+void set_gemm_parallel_threshold(std::size_t mnk) {
+    mt_min_slot().store(mnk, std::memory_order_relaxed);
+}
+
+std::size_t gemm_parallel_threshold() {
+    return mt_min_slot().load(std::memory_order_relaxed);
+}
+
+// Kernels take the beta operand (c0) separately from the output (c); c0 may
+// be c itself. op(A)(i, p) is a[i * rsa + p * csa] and op(B)(p, j) is
+// b[p * rsb + j * csb], so a transposed operand is just swapped strides.
+// A and B hold T; products accumulate, and C is stored, in Acc (the same
+// type except for mixed precision: float inputs into a double C).
+template <class T, class Acc>
+using GemmFn = void (*)(std::size_t, std::size_t, std::size_t,
+                        Acc, const T*, std::size_t, std::size_t,
+                        const T*, std::size_t, std::size_t,
+                        Acc, const Acc*, std::size_t,
+                        Acc*, std::size_t);
+
+template <class T, class Acc>
+static void naive_impl(std::size_t m, std::size_t n, std::size_t k,
+                       Acc alpha, const T* a, std::size_t rsa, std::size_t csa,
+                       const T* b, std::size_t rsb, std::size_t csb,
+                       Acc beta, const Acc* c0, std::size_t ldc0,
+                       Acc* c, std::size_t ldc);
+
+// A kernel with the register tile it computes C in (mr x nr).
+template <class T, class Acc>
+struct Kernel {
+    GemmFn<T, Acc> fn;
+    std::size_t mr, nr;
+
+    template <class Tile> static constexpr Kernel blocked();
+};
+template <class T, class Acc>
+static Kernel<T, Acc> blocked_kernel();
+
+static std::size_t ceil_div(std::size_t a, std::size_t b) { return (a + b - 1) / b; }
+
+// The selected kernel, on the thread pool above the threshold.
+template <class T, class Acc>
+static void dispatch(Trans ta, Trans tb, std::size_t m, std::size_t n, std::size_t k,
+                     Acc alpha, const T* a, std::size_t lda,
+                     const T* b, std::size_t ldb,
+                     Acc beta, const Acc* c0, std::size_t ldc0,
+                     Acc* c, std::size_t ldc) {
+    const std::size_t rsa = ta == Trans::N ? lda : 1, csa = ta == Trans::N ? 1 : lda;
+    const std::size_t rsb = tb == Trans::N ? ldb : 1, csb = tb == Trans::N ? 1 : ldb;
+    const Kernel<T, Acc> kernel = (gemm_kernel() == GemmKernel::Naive)
+        ? Kernel<T, Acc>{naive_impl<T, Acc>, kGemmMR, kGemmNR}
+        : blocked_kernel<T, Acc>();
+
+    ThreadPool& pool = global_pool();
+    const std::size_t threads = pool.size();
+    const double work = (double)m * (double)n * (double)k;
+    if (threads <= 1 || work < (double)gemm_parallel_threshold()) {
+        kernel.fn(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c0, ldc0, c, ldc);
+        return;
+    }
+
+    // 2D grid over C with ~2 tiles per thread for load balance; the grid's
+    // aspect ratio follows C's so tiles stay roughly square. Tile edges are
+    // multiples of the register tile so only the last row/column is ragged.
+    const std::size_t target = 2 * threads;
+    std::size_t tn = (std::size_t)std::lround(std::sqrt((double)target * n / m));
+    tn = std::clamp<std::size_t>(tn, 1, ceil_div(n, kernel.nr));
+    std::size_t tm = std::clamp<std::size_t>(ceil_div(target, tn), 1, ceil_div(m, kernel.mr));
+
+    const std::size_t bm = ceil_div(ceil_div(m, tm), kernel.mr) * kernel.mr;
+    const std::size_t bn = ceil_div(ceil_div(n, tn), kernel.nr) * kernel.nr;
+    tm = ceil_div(m, bm);
+    tn = ceil_div(n, bn);
+
+    pool.parallel_for(tm * tn, [&](std::size_t t) {
+        const std::size_t i0 = (t / tn) * bm;
+        const std::size_t j0 = (t % tn) * bn;
+        kernel.fn(std::min(bm, m - i0), std::min(bn, n - j0), k,
+                  alpha, a + i0 * rsa, rsa, csa,
+                  b + j0 * csb, rsb, csb,
+                  beta, c0 + i0 * ldc0 + j0, ldc0,
+                  c + i0 * ldc + j0, ldc);
+    });
+}
+
+void gemm(std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const double* a, std::size_t lda,
+          const double* b, std::size_t ldb,
+          double beta, double* c, std::size_t ldc) {
+    gemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, c, ldc);
+}
+
+void gemm(std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const double* a, std::size_t lda,
+          const double* b, std::size_t ldb,
+          double beta, const double* c0, std::size_t ldc0,
+          double* c, std::size_t ldc) {
+    gemm(Trans::N, Trans::N, m, n, k, alpha, a, lda, b, ldb, beta, c0, ldc0, c, ldc);
+}
+
+void gemm(Trans ta, Trans tb, std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const double* a, std::size_t lda,
+          const double* b, std::size_t ldb,
+          double beta, const double* c0, std::size_t ldc0,
+          double* c, std::size_t ldc) {
+    dispatch<double, double>(ta, tb, m, n, k, alpha, a, lda, b, ldb, beta, c0, ldc0, c, ldc);
+}
+
+void gemm(Trans ta, Trans tb, std::size_t m, std::size_t n, std::size_t k,
+          double alpha, const float* a, std::size_t lda,
+          const float* b, std::size_t ldb,
+          double beta, const float* c0, std::size_t ldc0,
+          float* c, std::size_t ldc, bool accumulate_f64) {
+    if (!accumulate_f64) {
+        dispatch<float, float>(ta, tb, m, n, k, (float)alpha, a, lda, b, ldb,
+                               (float)beta, c0, ldc0, c, ldc);
+        return;
+    }
+    // C is accumulated in a double buffer, so the partial sums carried
+    // between k-blocks are not rounded to float either; it is rounded once
+    // at the end.
+    thread_local std::vector<double> wide;
+    wide.resize(m * n);
+    if (beta != 0.0) {
+        for (std::size_t i = 0; i < m; ++i)
+            for (std::size_t j = 0; j < n; ++j) wide[i * n + j] = c0[i * ldc0 + j];
+    }
+    dispatch<float, double>(ta, tb, m, n, k, alpha, a, lda, b, ldb,
+                            beta, wide.data(), n, wide.data(), n);
+    for (std::size_t i = 0; i < m; ++i)
+        for (std::size_t j = 0; j < n; ++j) c[i * ldc + j] = (float)wide[i * n + j];
+}
+
+// C row i <- beta * C0 row i (beta == 0 overwrites, so NaNs in C0 don't leak)
+template <class Acc>
+static void scale_row(const Acc* c0i, Acc* ci, std::size_t n, Acc beta) {
+    if (beta == 0) {
+        std::fill(ci, ci + n, Acc(0));
+    } else if (beta != 1) {
+        for (std::size_t j = 0; j < n; ++j) ci[j] = beta * c0i[j];
+    } else if (c0i != ci) {
+        std::copy(c0i, c0i + n, ci);
+    }
+}
+
+// ---------- Naive i-k-j loop ----------
+
+void gemm_naive(std::size_t m, std::size_t n, std::size_t k,
+                double alpha, const double* a, std::size_t lda,
+                const double* b, std::size_t ldb,
+                double beta, double* c, std::size_t ldc) {
+    naive_impl<double, double>(m, n, k, alpha, a, lda, 1, b, ldb, 1, beta, c, ldc, c, ldc);
+}
+
+template <class T, class Acc>
+static void naive_impl(std::size_t m, std::size_t n, std::size_t k,
+                       Acc alpha, const T* a, std::size_t rsa, std::size_t csa,
+                       const T* b, std::size_t rsb, std::size_t csb,
+                       Acc beta, const Acc* c0, std::size_t ldc0,
+                       Acc* c, std::size_t ldc) {
+    for (std::size_t i = 0; i < m; ++i) {
+        Acc* ci = c + i * ldc;
+        scale_row(c0 + i * ldc0, ci, n, beta);
+        for (std::size_t p = 0; p < k; ++p) {
+            const Acc aik = alpha * (Acc)a[i * rsa + p * csa];
+            const T* bp = b + p * rsb;
+            if (csb == 1) {
+                for (std::size_t j = 0; j < n; ++j) ci[j] += aik * (Acc)bp[j];
+            } else {
+                for (std::size_t j = 0; j < n; ++j) ci[j] += aik * (Acc)bp[j * csb];
+            }
+        }
+    }
+}
+
+// ---------- Blocked kernel ----------
+
+constexpr std::size_t KC = kGemmKC;
+constexpr std::size_t NC = kGemmNC;
+
+// Packs the mc x kc block of op(A) into MR-row micro-panels, k-major inside
+// each panel. Rows past mc are zero-padded so the microkernel never branches.
+// A transposed A (rsa == 1) is read along its stored rows here, so NN and
+// TN produce the same panels from either layout. Elements are converted to
+// the accumulator type here, once per panel.
+template <std::size_t MR, class T, class Acc>
+static void pack_a(std::size_t mc, std::size_t kc,
+                   const T* a, std::size_t rsa, std::size_t csa, Acc* ap) {
+    for (std::size_t ir = 0; ir < mc; ir += MR) {
+        const std::size_t mr = std::min(MR, mc - ir);
+        for (std::size_t p = 0; p < kc; ++p) {
+            for (std::size_t i = 0; i < mr; ++i) ap[i] = (Acc)a[(ir + i) * rsa + p * csa];
+            for (std::size_t i = mr; i < MR; ++i) ap[i] = 0;
+            ap += MR;
+        }
+    }
+}
+
+// Packs the kc x nc block of op(B) into NR-column micro-panels, k-major
+// inside each panel, zero-padding columns past nc. A transposed B is copied
+// column by column so the reads follow its stored rows.
+template <std::size_t NR, class T, class Acc>
+static void pack_b(std::size_t kc, std::size_t nc,
+                   const T* b, std::size_t rsb, std::size_t csb, Acc* bp) {
+    for (std::size_t jr = 0; jr < nc; jr += NR) {
+        const std::size_t nr = std::min(NR, nc - jr);
+        if (csb == 1) {
+            for (std::size_t p = 0; p < kc; ++p) {
+                const T* row = b + p * rsb + jr;
+                for (std::size_t j = 0; j < nr; ++j) bp[p * NR + j] = (Acc)row[j];
+                for (std::size_t j = nr; j < NR; ++j) bp[p * NR + j] = 0;
+            }
+        } else {
+            for (std::size_t j = 0; j < nr; ++j) {
+                const T* col = b + (jr + j) * csb;
+                for (std::size_t p = 0; p < kc; ++p) bp[p * NR + j] = (Acc)col[p * rsb];
+            }
+            for (std::size_t p = 0; p < kc; ++p)
+                for (std::size_t j = nr; j < NR; ++j) bp[p * NR + j] = 0;
+        }
+        bp += NR * kc;
+    }
+}
+
+// ---------- Microkernels ----------
+//
+// A tile type fixes the register tile MR x NR and supplies
+//     run(kc, ap, bp, acc):  acc[i * NR + j] = sum_p ap[p * MR + i] * bp[p * NR + j]
+// over packed panels. Every tile of one call uses the same kernel, so the
+// result does not depend on how C is split across threads.
+
+// Portable MR x NR kernel, built for the baseline ISA. The accumulator is a
+// local with fixed, fully unrolled trip counts so the compiler keeps it in
+// vector registers (at -O2 the loops alone leave it on the stack, one
+// load/store per update); acc is written once at the end.
+template <class Acc>
+struct GenericTile {
+    static constexpr std::size_t MR = kGemmMR;
+    static constexpr std::size_t NR = kGemmNR;
+
+    static void run(std::size_t kc, const Acc* __restrict ap,
+                    const Acc* __restrict bp, Acc* __restrict acc) {
+        Acc c[MR][NR] = {};
+
+        for (std::size_t p = 0; p < kc; ++p) {
+#pragma GCC unroll 4
+            for (std::size_t i = 0; i < MR; ++i) {
+                const Acc ai = ap[i];
+#pragma GCC unroll 8
+                for (std::size_t j = 0; j < NR; ++j) {
+                    c[i][j] += ai * bp[j];
+                }
+            }
+            ap += MR;
+            bp += NR;
+        }
+
+        for (std::size_t i = 0; i < MR; ++i)
+            for (std::size_t j = 0; j < NR; ++j) acc[i * NR + j] = c[i][j];
+    }
+};
+
+#ifdef LOC_GEMM_X86
+
+// Vector kernels: each row of the tile is NV vectors of C, held in
+// registers for the whole k loop. Per k step the kernel loads NV vectors of
+// the B panel, broadcasts MR elements of the A panel and issues MR * NV
+// FMAs, enough independent accumulators to cover the FMA latency on both
+// ports. Tiles are sized to the 16 (AVX2) or 32 (AVX-512) vector registers.
+struct Avx2F64 {
+    using E = double;
+    using V = __m256d;
+    static constexpr std::size_t W = 4;
+    LOC_TARGET("avx2,fma") static V zero() { return _mm256_setzero_pd(); }
+    LOC_TARGET("avx2,fma") static V load(const E* p) { return _mm256_loadu_pd(p); }
+    LOC_TARGET("avx2,fma") static V bcast(const E* p) { return _mm256_broadcast_sd(p); }
+    LOC_TARGET("avx2,fma") static V fma(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+    LOC_TARGET("avx2,fma") static void store(E* p, V v) { _mm256_storeu_pd(p, v); }
+};
+
+struct Avx2F32 {
+    using E = float;
+    using V = __m256;
+    static constexpr std::size_t W = 8;
+    LOC_TARGET("avx2,fma") static V zero() { return _mm256_setzero_ps(); }
+    LOC_TARGET("avx2,fma") static V load(const E* p) { return _mm256_loadu_ps(p); }
+    LOC_TARGET("avx2,fma") static V bcast(const E* p) { return _mm256_broadcast_ss(p); }
+    LOC_TARGET("avx2,fma") static V fma(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+    LOC_TARGET("avx2,fma") static void store(E* p, V v) { _mm256_storeu_ps(p, v); }
+};
+
+struct Avx512F64 {
+    using E = double;
+    using V = __m512d;
+    static constexpr std::size_t W = 8;
+    LOC_TARGET("avx512f") static V zero() { return _mm512_setzero_pd(); }
+    LOC_TARGET("avx512f") static V load(const E* p) { return _mm512_loadu_pd(p); }
+    LOC_TARGET("avx512f") static V bcast(const E* p) { return _mm512_set1_pd(*p); }
+    LOC_TARGET("avx512f") static V fma(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+    LOC_TARGET("avx512f") static void store(E* p, V v) { _mm512_storeu_pd(p, v); }
+};
+
+struct Avx512F32 {
+    using E = float;
+    using V = __m512;
+    static constexpr std::size_t W = 16;
+    LOC_TARGET("avx512f") static V zero() { return _mm512_setzero_ps(); }
+    LOC_TARGET("avx512f") static V load(const E* p) { return _mm512_loadu_ps(p); }
+    LOC_TARGET("avx512f") static V bcast(const E* p) { return _mm512_set1_ps(*p); }
+    LOC_TARGET("avx512f") static V fma(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+    LOC_TARGET("avx512f") static void store(E* p, V v) { _mm512_storeu_ps(p, v); }
+};
+
+template <class X, std::size_t MR, std::size_t NV>
+LOC_TARGET("avx2,fma")
+static void vector_tile_avx2(std::size_t kc, const typename X::E* __restrict ap,
+                             const typename X::E* __restrict bp,
+                             typename X::E* __restrict acc) {
+    using V = typename X::V;
+    constexpr std::size_t NR = NV * X::W;
+    V c[MR][NV];
+#pragma GCC unroll 16
+    for (std::size_t i = 0; i < MR; ++i)
+#pragma GCC unroll 4
+        for (std::size_t v = 0; v < NV; ++v) c[i][v] = X::zero();
+
+    for (std::size_t p = 0; p < kc; ++p) {
+        V b[NV];
+#pragma GCC unroll 4
+        for (std::size_t v = 0; v < NV; ++v) b[v] = X::load(bp + v * X::W);
+#pragma GCC unroll 16
+        for (std::size_t i = 0; i < MR; ++i) {
+            const V ai = X::bcast(ap + i);
+#pragma GCC unroll 4
+            for (std::size_t v = 0; v < NV; ++v) c[i][v] = X::fma(ai, b[v], c[i][v]);
+        }
+        ap += MR;
+        bp += NR;
+    }
+
+#pragma GCC unroll 16
+    for (std::size_t i = 0; i < MR; ++i)
+#pragma GCC unroll 4
+        for (std::size_t v = 0; v < NV; ++v) X::store(acc + i * NR + v * X::W, c[i][v]);
+}
+
+// The same loop for AVX-512 (a target attribute can't be a parameter).
+template <class X, std::size_t MR, std::size_t NV>
+LOC_TARGET("avx512f")
+static void vector_tile_avx512(std::size_t kc, const typename X::E* __restrict ap,
+                               const typename X::E* __restrict bp,
+                               typename X::E* __restrict acc) {
+    using V = typename X::V;
+    constexpr std::size_t NR = NV * X::W;
+    V c[MR][NV];
+#pragma GCC unroll 16
+    for (std::size_t i = 0; i < MR; ++i)
+#pragma GCC unroll 4
+        for (std::size_t v = 0; v < NV; ++v) c[i][v] = X::zero();
+
+    for (std::size_t p = 0; p < kc; ++p) {
+        V b[NV];
+#pragma GCC unroll 4
+        for (std::size_t v = 0; v < NV; ++v) b[v] = X::load(bp + v * X::W);
+#pragma GCC unroll 16
+        for (std::size_t i = 0; i < MR; ++i) {
+            const V ai = X::bcast(ap + i);
+#pragma GCC unroll 4
+            for (std::size_t v = 0; v < NV; ++v) c[i][v] = X::fma(ai, b[v], c[i][v]);
+        }
+        ap += MR;
+        bp += NR;
+    }
+
+#pragma GCC unroll 16
+    for (std::size_t i = 0; i < MR; ++i)
+#pragma GCC unroll 4
+        for (std::size_t v = 0; v < NV; ++v) X::store(acc + i * NR + v * X::W, c[i][v]);
+}
+
+template <class X, std::size_t MR_, std::size_t NV, bool Avx512>
+struct VectorTile {
+    using Acc = typename X::E;
+    static constexpr std::size_t MR = MR_;
+    static constexpr std::size_t NR = NV * X::W;
+
+    static void run(std::size_t kc, const Acc* ap, const Acc* bp, Acc* acc) {
+        if constexpr (Avx512) vector_tile_avx512<X, MR, NV>(kc, ap, bp, acc);
+        else                  vector_tile_avx2<X, MR, NV>(kc, ap, bp, acc);
+    }
+};
+
+#endif // LOC_GEMM_X86
+
+// C tile <- alpha * acc + beta * C0 tile (only the valid mr x nr corner).
+// This is the epilogue: the scale and the accumulation happen while the
+// tile is in registers, with no separate pass over C.
+template <std::size_t NR, class Acc>
+static void store_tile(std::size_t mr, std::size_t nr, Acc alpha,
+                       const Acc* acc, Acc beta,
+                       const Acc* c0, std::size_t ldc0,
+                       Acc* c, std::size_t ldc) {
+    for (std::size_t i = 0; i < mr; ++i) {
+        const Acc* ai = acc + i * NR;
+        const Acc* c0i = c0 + i * ldc0;
+        Acc* ci = c + i * ldc;
+        if (beta == 0) {
+            for (std::size_t j = 0; j < nr; ++j) ci[j] = alpha * ai[j];
+        } else {
+            for (std::size_t j = 0; j < nr; ++j) ci[j] = alpha * ai[j] + beta * c0i[j];
+        }
+    }
+}
+
+template <class T, class Acc, class Tile>
+static void blocked_impl(std::size_t m, std::size_t n, std::size_t k,
+                         Acc alpha, const T* a, std::size_t rsa, std::size_t csa,
+                         const T* b, std::size_t rsb, std::size_t csb,
+                         Acc beta, const Acc* c0, std::size_t ldc0,
+                         Acc* c, std::size_t ldc) {
+    constexpr std::size_t MR = Tile::MR;
+    constexpr std::size_t NR = Tile::NR;
+    // A blocks are a whole number of micro-panels, so only the last one of
+    // the call is ragged.
+    constexpr std::size_t MC = std::max<std::size_t>(kGemmMC / MR, 1) * MR;
+
+    if (m == 0 || n == 0) return;
+    if (k == 0) {
+        for (std::size_t i = 0; i < m; ++i) scale_row(c0 + i * ldc0, c + i * ldc, n, beta);
+        return;
+    }
+
+    // Packing buffers are reused across calls (and are per-thread).
+    thread_local std::vector<Acc> a_pack;
+    thread_local std::vector<Acc> b_pack;
+    a_pack.resize(MC * KC);
+    b_pack.resize(((NC + NR - 1) / NR) * NR * KC);
+
+    Acc acc[MR * NR];
+
+    for (std::size_t jc = 0; jc < n; jc += NC) {
+        const std::size_t nc = std::min(NC, n - jc);
+
+        for (std::size_t pc = 0; pc < k; pc += KC) {
+            const std::size_t kc = std::min(KC, k - pc);
+            // First k-block applies the caller's beta to C0, later ones
+            // accumulate onto C.
+            const Acc beta_eff = (pc == 0) ? beta : Acc(1);
+            const Acc* src = (pc == 0) ? c0 : c;
+            const std::size_t ldsrc = (pc == 0) ? ldc0 : ldc;
+
+            pack_b<NR>(kc, nc, b + pc * rsb + jc * csb, rsb, csb, b_pack.data());
+
+            for (std::size_t ic = 0; ic < m; ic += MC) {
+                const std::size_t mc = std::min(MC, m - ic);
+                pack_a<MR>(mc, kc, a + ic * rsa + pc * csa, rsa, csa, a_pack.data());
+
+                for (std::size_t jr = 0; jr < nc; jr += NR) {
+                    const std::size_t nr = std::min(NR, nc - jr);
+                    const Acc* bp = b_pack.data() + jr * kc;
+
+                    for (std::size_t ir = 0; ir < mc; ir += MR) {
+                        const std::size_t mr = std::min(MR, mc - ir);
+                        const Acc* ap = a_pack.data() + ir * kc;
+
+                        Tile::run(kc, ap, bp, acc);
+                        store_tile<NR>(mr, nr, alpha, acc, beta_eff,
+                                       src + (ic + ir) * ldsrc + jc + jr, ldsrc,
+                                       c + (ic + ir) * ldc + jc + jr, ldc);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// ---------- Tile selection ----------
+
+template <class T, class Acc>
+template <class Tile>
+constexpr Kernel<T, Acc> Kernel<T, Acc>::blocked() {
+    return {blocked_impl<T, Acc, Tile>, Tile::MR, Tile::NR};
+}
+
+// The widest tile the active ISA (simd::active_isa(), so `--simd=` caps it)
+// has a kernel for; the portable one otherwise.
+template <class T, class Acc>
+static Kernel<T, Acc> blocked_kernel() {
+    using K = Kernel<T, Acc>;
+#ifdef LOC_GEMM_X86
+    using X512 = std::conditional_t<std::is_same_v<Acc, double>, Avx512F64, Avx512F32>;
+    using X256 = std::conditional_t<std::is_same_v<Acc, double>, Avx2F64, Avx2F32>;
+    switch (simd::active_isa()) {
+        case simd::Isa::AVX512: return K::template blocked<VectorTile<X512, 12, 2, true>>();
+        case simd::Isa::AVX2:   return K::template blocked<VectorTile<X256, 6, 2, false>>();
+        default: break;
+    }
+#endif
+    return K::template blocked<GenericTile<Acc>>();
+}
+
+void gemm_blocked(std::size_t m, std::size_t n, std::size_t k,
+                  double alpha, const double* a, std::size_t lda,
+                  const double* b, std::size_t ldb,
+                  double beta, double* c, std::size_t ldc) {
+    blocked_kernel<double, double>().fn(m, n, k, alpha, a, lda, 1, b, ldb, 1,
+                                        beta, c, ldc, c, ldc);
+}
+
+} // namespace loc::rt
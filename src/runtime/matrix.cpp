@@ -1,65 +1,350 @@
 #include "loc/runtime/matrix.hpp"
+#include "loc/runtime/gemm.hpp"
+#include "loc/runtime/precision.hpp"
+#include "loc/runtime/simd.hpp"
+#include <algorithm>
+#include <atomic>
 #include <stdexcept>
+#include <string>
 #include <iomanip>
 
 namespace loc::rt {
 
-Matrix::Matrix(std::size_t r, std::size_t c, double fill)
-    : r_(r), c_(c), data_(r * c, fill) {}
+// ---------- Storage accounting ----------
 
-Matrix Matrix::identity(std::size_t n) {
-    Matrix I(n, n, 0.0);
-    for (std::size_t i = 0; i < n; ++i) I(i, i) = 1.0;
+static std::atomic<std::size_t> g_live_bytes{0};
+static std::atomic<std::size_t> g_peak_bytes{0};
+static std::atomic<std::size_t> g_allocations{0};
+
+void detail::track_alloc(std::size_t bytes) {
+    const std::size_t live = g_live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::size_t peak = g_peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !g_peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void detail::track_free(std::size_t bytes) {
+    g_live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MatrixMemStats matrix_mem_stats() {
+    MatrixMemStats s;
+    s.live_bytes = g_live_bytes.load(std::memory_order_relaxed);
+    s.peak_bytes = g_peak_bytes.load(std::memory_order_relaxed);
+    s.allocations = g_allocations.load(std::memory_order_relaxed);
+    return s;
+}
+
+void reset_matrix_mem_stats() {
+    g_peak_bytes.store(g_live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    g_allocations.store(0, std::memory_order_relaxed);
+}
+
+// ---------- Matrix ----------
+
+template <class T>
+BasicMatrix<T>::BasicMatrix(std::size_t r, std::size_t c, double fill)
+    : r_(r), c_(c), data_(r * c, (T)fill) {}
+
+template <class T>
+BasicMatrix<T>::BasicMatrix(std::size_t r, std::size_t c, Storage&& data)
+    : r_(r), c_(c), data_(std::move(data)) {
+    if (data_.size() != r * c) throw std::runtime_error("Matrix: storage size does not match shape");
+}
+
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::identity(std::size_t n) {
+    BasicMatrix I(n, n, 0.0);
+    for (std::size_t i = 0; i < n; ++i) I(i, i) = 1;
     return I;
 }
 
-double& Matrix::operator()(std::size_t i, std::size_t j) {
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::uninitialized(std::size_t r, std::size_t c) {
+    BasicMatrix m;
+    m.r_ = r;
+    m.c_ = c;
+    m.data_.resize(r * c); // default-init: no fill
+    return m;
+}
+
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::view(std::size_t r, std::size_t c, T* data) {
+    BasicMatrix m;
+    m.r_ = r;
+    m.c_ = c;
+    m.view_ = data;
+    return m;
+}
+
+template <class T>
+BasicMatrix<T>::BasicMatrix(const BasicMatrix& o)
+    : r_(o.r_), c_(o.c_), data_(o.data(), o.data() + o.size()) {}
+
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator=(const BasicMatrix& o) {
+    if (this != &o) *this = BasicMatrix(o);
+    return *this;
+}
+
+template <class T>
+T& BasicMatrix<T>::operator()(std::size_t i, std::size_t j) {
     if (i >= r_ || j >= c_) throw std::out_of_range("Matrix index out of range");
-    return data_[i * c_ + j];
+    return data()[i * c_ + j];
 }
 
-double Matrix::operator()(std::size_t i, std::size_t j) const {
+template <class T>
+T BasicMatrix<T>::operator()(std::size_t i, std::size_t j) const {
     if (i >= r_ || j >= c_) throw std::out_of_range("Matrix index out of range");
-    return data_[i * c_ + j];
+    return data()[i * c_ + j];
 }
 
-Matrix operator+(const Matrix& a, const Matrix& b) {
+template <class T>
+BasicMatrix<T> operator+(const BasicMatrix<T>& a, const BasicMatrix<T>& b) {
     if (a.rows() != b.rows() || a.cols() != b.cols())
         throw std::runtime_error("Matrix add: shape mismatch");
 
-    Matrix out(a.rows(), a.cols(), 0.0);
-    for (std::size_t i = 0; i < a.rows(); ++i)
-        for (std::size_t j = 0; j < a.cols(); ++j)
-            out(i, j) = a(i, j) + b(i, j);
+    BasicMatrix<T> out = BasicMatrix<T>::uninitialized(a.rows(), a.cols());
+    add_into(a, b, out);
     return out;
 }
 
-Matrix operator*(double s, const Matrix& a) {
-    Matrix out(a.rows(), a.cols(), 0.0);
-    for (std::size_t i = 0; i < a.rows(); ++i)
-        for (std::size_t j = 0; j < a.cols(); ++j)
-            out(i, j) = s * a(i, j);
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator+=(const BasicMatrix& b) {
+    if (r_ != b.rows() || c_ != b.cols())
+        throw std::runtime_error("Matrix add: shape mismatch");
+
+    simd::add(data(), b.data(), data(), size());
+    return *this;
+}
+
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator*=(double s) {
+    simd::scale((T)s, data(), data(), size());
+    return *this;
+}
+
+template <class T>
+BasicMatrix<T> operator*(double s, const BasicMatrix<T>& a) {
+    BasicMatrix<T> out = BasicMatrix<T>::uninitialized(a.rows(), a.cols());
+    scale_into(s, a, out);
     return out;
 }
 
-Matrix Matrix::matmul(const Matrix& b) const {
+template <class T>
+BasicMatrix<T> axpby(double alpha, const BasicMatrix<T>& x, double beta, const BasicMatrix<T>& y) {
+    if (x.rows() != y.rows() || x.cols() != y.cols())
+        throw std::runtime_error("Matrix axpby: shape mismatch");
+
+    BasicMatrix<T> out = BasicMatrix<T>::uninitialized(x.rows(), x.cols());
+    simd::axpby((T)alpha, x.data(), (T)beta, y.data(), out.data(), x.size());
+    return out;
+}
+
+template <class T>
+static void check_out(const BasicMatrix<T>& out, std::size_t r, std::size_t c, const char* what) {
+    if (out.rows() != r || out.cols() != c)
+        throw std::runtime_error(std::string(what) + ": output shape mismatch");
+}
+
+template <class T>
+void add_into(const BasicMatrix<T>& a, const BasicMatrix<T>& b, BasicMatrix<T>& out) {
+    if (a.rows() != b.rows() || a.cols() != b.cols())
+        throw std::runtime_error("Matrix add: shape mismatch");
+    check_out(out, a.rows(), a.cols(), "Matrix add");
+    simd::add(a.data(), b.data(), out.data(), a.size());
+}
+
+template <class T>
+void scale_into(double s, const BasicMatrix<T>& a, BasicMatrix<T>& out) {
+    check_out(out, a.rows(), a.cols(), "Matrix scale");
+    simd::scale((T)s, a.data(), out.data(), a.size());
+}
+
+template <class T>
+void lincomb_into(const std::vector<double>& coeffs,
+                  const std::vector<const BasicMatrix<T>*>& xs, BasicMatrix<T>& out) {
+    if (xs.empty() || coeffs.size() != xs.size())
+        throw std::runtime_error("Matrix lincomb: expected one coefficient per input");
+
+    std::vector<const T*> ptrs;
+    ptrs.reserve(xs.size());
+    for (const BasicMatrix<T>* x : xs) {
+        if (x->rows() != out.rows() || x->cols() != out.cols())
+            throw std::runtime_error("Matrix add: shape mismatch");
+        ptrs.push_back(x->data());
+    }
+    const std::vector<T> cs(coeffs.begin(), coeffs.end());
+    simd::lincomb(xs.size(), cs.data(), ptrs.data(), out.data(), out.size());
+}
+
+// The GEMM entry point for each element type: float takes the precision
+// setting's accumulator.
+static void gemm_t(Trans ta, Trans tb, std::size_t m, std::size_t n, std::size_t k,
+                   double alpha, const double* a, std::size_t lda,
+                   const double* b, std::size_t ldb,
+                   double beta, const double* c0, std::size_t ldc0,
+                   double* c, std::size_t ldc) {
+    gemm(ta, tb, m, n, k, alpha, a, lda, b, ldb, beta, c0, ldc0, c, ldc);
+}
+
+static void gemm_t(Trans ta, Trans tb, std::size_t m, std::size_t n, std::size_t k,
+                   double alpha, const float* a, std::size_t lda,
+                   const float* b, std::size_t ldb,
+                   double beta, const float* c0, std::size_t ldc0,
+                   float* c, std::size_t ldc) {
+    gemm(ta, tb, m, n, k, alpha, a, lda, b, ldb, beta, c0, ldc0, c, ldc,
+         precision() == Precision::Mixed);
+}
+
+template <class T>
+void BasicMatrix<T>::matmul_into(const BasicMatrix& b, BasicMatrix& out) const {
     if (c_ != b.rows())
         throw std::runtime_error("Matrix matmul: shape mismatch");
+    check_out(out, r_, b.cols(), "Matrix matmul");
+    gemm_t(Trans::N, Trans::N, r_, b.cols(), c_,
+           1.0, data(), c_,
+           b.data(), b.cols(),
+           0.0, out.data(), out.cols(),
+           out.data(), out.cols());
+}
 
-    Matrix out(r_, b.cols(), 0.0);
+template <class T>
+void gemm_into(double alpha, const BasicMatrix<T>& a, const BasicMatrix<T>& b,
+               double beta, const typename detail::NonDeduced<BasicMatrix<T>>::type* c,
+               BasicMatrix<T>& out) {
+    gemm_into(alpha, a, false, b, false, beta, c, out);
+}
 
-    for (std::size_t i = 0; i < r_; ++i) {
-        for (std::size_t k = 0; k < c_; ++k) {
-            double aik = (*this)(i, k);
-            for (std::size_t j = 0; j < b.cols(); ++j) {
-                out(i, j) += aik * b(k, j);
-            }
+template <class T>
+void gemm_into(double alpha, const BasicMatrix<T>& a, bool trans_a,
+               const BasicMatrix<T>& b, bool trans_b,
+               double beta, const typename detail::NonDeduced<BasicMatrix<T>>::type* c,
+               BasicMatrix<T>& out) {
+    const std::size_t m = trans_a ? a.cols() : a.rows();
+    const std::size_t k = trans_a ? a.rows() : a.cols();
+    const std::size_t n = trans_b ? b.rows() : b.cols();
+    if (k != (trans_b ? b.cols() : b.rows()))
+        throw std::runtime_error("Matrix matmul: shape mismatch");
+    check_out(out, m, n, "Matrix matmul");
+    if (c && (c->rows() != out.rows() || c->cols() != out.cols()))
+        throw std::runtime_error("Matrix add: shape mismatch");
+
+    const BasicMatrix<T>& c0 = c ? *c : out;
+    gemm_t(trans_a ? Trans::T : Trans::N, trans_b ? Trans::T : Trans::N, m, n, k,
+           alpha, a.data(), a.cols(),
+           b.data(), b.cols(),
+           c ? beta : 0.0, c0.data(), c0.cols(),
+           out.data(), out.cols());
+}
+
+template <class T>
+void transpose_into(const BasicMatrix<T>& a, BasicMatrix<T>& out) {
+    check_out(out, a.cols(), a.rows(), "Matrix transpose");
+    // 32x32 tiles: one tile of each side fits in L1, so neither the
+    // row-order reads nor the column-order writes miss on every element
+    constexpr std::size_t TS = 32;
+    const std::size_t r = a.rows(), c = a.cols();
+    const T* src = a.data();
+    T* dst = out.data();
+    for (std::size_t i0 = 0; i0 < r; i0 += TS) {
+        const std::size_t i1 = std::min(r, i0 + TS);
+        for (std::size_t j0 = 0; j0 < c; j0 += TS) {
+            const std::size_t j1 = std::min(c, j0 + TS);
+            for (std::size_t i = i0; i < i1; ++i)
+                for (std::size_t j = j0; j < j1; ++j) dst[j * r + i] = src[i * c + j];
         }
     }
+}
+
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::transpose() const {
+    BasicMatrix out = BasicMatrix::uninitialized(c_, r_);
+    transpose_into(*this, out);
     return out;
 }
 
-std::ostream& operator<<(std::ostream& os, const Matrix& m) {
+template <class T>
+void power_into(const BasicMatrix<T>& a, std::uint64_t k, BasicMatrix<T>& out, T* scratch) {
+    const std::size_t n = a.rows();
+    if (a.cols() != n)
+        throw std::runtime_error("Matrix power: matrix is not square");
+    check_out(out, n, n, "Matrix power");
+    const std::size_t size = a.size();
+    if (k == 0) {
+        std::fill(out.data(), out.data() + size, T(0));
+        for (std::size_t i = 0; i < n; ++i) out.data()[i * n + i] = 1;
+        return;
+    }
+
+    // sq runs through a^(2^i); acc collects the product of those for the
+    // set bits of k. Each product goes to whichever of the three buffers
+    // neither of them holds.
+    T* const bufs[3] = {out.data(), scratch, scratch ? scratch + size : nullptr};
+    const T* sq = a.data();
+    T* sq_buf = nullptr;
+    T* acc = nullptr;
+    auto spare = [&] {
+        for (T* b : bufs) {
+            if (b != sq_buf && b != acc) return b;
+        }
+        return bufs[0]; // unreachable: at most two are held
+    };
+    auto mul = [&](const T* x, const T* y, T* z) {
+        gemm_t(Trans::N, Trans::N, n, n, n, 1.0, x, n, y, n, 0.0, z, n, z, n);
+    };
+
+    for (;;) {
+        if (k & 1) {
+            T* z = spare();
+            if (acc) mul(acc, sq, z);
+            else std::copy(sq, sq + size, z);
+            acc = z;
+        }
+        k >>= 1;
+        if (!k) break;
+        T* z = spare();
+        mul(sq, sq, z);
+        sq = sq_buf = z;
+    }
+    if (acc != out.data()) std::copy(acc, acc + size, out.data());
+}
+
+template <class T>
+BasicMatrix<T> power(const BasicMatrix<T>& a, std::uint64_t k) {
+    if (a.cols() != a.rows())
+        throw std::runtime_error("Matrix power: matrix is not square");
+    BasicMatrix<T> out = BasicMatrix<T>::uninitialized(a.rows(), a.cols());
+    typename BasicMatrix<T>::Storage scratch(k > 1 ? 2 * a.size() : 0);
+    power_into(a, k, out, scratch.data());
+    return out;
+}
+
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::matmul(const BasicMatrix& b) const {
+    if (c_ != b.rows())
+        throw std::runtime_error("Matrix matmul: shape mismatch");
+
+    BasicMatrix out = BasicMatrix::uninitialized(r_, b.cols()); // beta = 0: C is not read
+    matmul_into(b, out);
+    return out;
+}
+
+MatrixF32 to_f32(const Matrix& m) {
+    MatrixF32 out = MatrixF32::uninitialized(m.rows(), m.cols());
+    std::copy(m.data(), m.data() + m.size(), out.data());
+    return out;
+}
+
+Matrix to_f64(const MatrixF32& m) {
+    Matrix out = Matrix::uninitialized(m.rows(), m.cols());
+    std::copy(m.data(), m.data() + m.size(), out.data());
+    return out;
+}
+
+template <class T>
+std::ostream& operator<<(std::ostream& os, const BasicMatrix<T>& m) {
     os << std::fixed << std::setprecision(3);
     for (std::size_t i = 0; i < m.rows(); ++i) {
         os << "[ ";
@@ -72,4 +357,29 @@ std::ostream& operator<<(std::ostream& os, const Matrix& m) {
     return os;
 }
 
+// ---------- Instantiations ----------
+
+#define LOC_MATRIX_INSTANTIATE(T)                                                          \
+    template class BasicMatrix<T>;                                                         \
+    template void add_into(const BasicMatrix<T>&, const BasicMatrix<T>&, BasicMatrix<T>&); \
+    template void scale_into(double, const BasicMatrix<T>&, BasicMatrix<T>&);             \
+    template BasicMatrix<T> operator+(const BasicMatrix<T>&, const BasicMatrix<T>&);       \
+    template BasicMatrix<T> operator*(double, const BasicMatrix<T>&);                      \
+    template BasicMatrix<T> axpby(double, const BasicMatrix<T>&, double, const BasicMatrix<T>&); \
+    template void gemm_into(double, const BasicMatrix<T>&, const BasicMatrix<T>&,          \
+                            double, const BasicMatrix<T>*, BasicMatrix<T>&);               \
+    template void gemm_into(double, const BasicMatrix<T>&, bool, const BasicMatrix<T>&,    \
+                            bool, double, const BasicMatrix<T>*, BasicMatrix<T>&);         \
+    template void lincomb_into(const std::vector<double>&,                                 \
+                               const std::vector<const BasicMatrix<T>*>&, BasicMatrix<T>&); \
+    template BasicMatrix<T> power(const BasicMatrix<T>&, std::uint64_t);                   \
+    template void power_into(const BasicMatrix<T>&, std::uint64_t, BasicMatrix<T>&, T*);   \
+    template void transpose_into(const BasicMatrix<T>&, BasicMatrix<T>&);                  \
+    template std::ostream& operator<<(std::ostream&, const BasicMatrix<T>&);
+
+LOC_MATRIX_INSTANTIATE(double)
+LOC_MATRIX_INSTANTIATE(float)
+
+#undef LOC_MATRIX_INSTANTIATE
+
 } // namespace loc::rt
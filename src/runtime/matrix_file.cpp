@@ -0,0 +1,232 @@
+#include "loc/runtime/matrix_file.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LOC_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace loc::rt {
+
+static constexpr char kMagic[8] = {'L', 'O', 'C', 'M', 'A', 'T', '\0', '\0'};
+static constexpr std::uint32_t kVersion = 1;
+
+static bool little_endian() {
+    const std::uint32_t one = 1;
+    unsigned char b;
+    std::memcpy(&b, &one, 1);
+    return b == 1;
+}
+
+// Checks `h` against a file of `file_bytes` bytes; returns the element count.
+static std::size_t check_header(const MatrixFileHeader& h, std::size_t file_bytes,
+                                const std::string& path) {
+    auto fail = [&](const std::string& why) {
+        throw std::runtime_error("load(\"" + path + "\"): " + why);
+    };
+    if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0) fail("not a matrix file (bad magic)");
+    if (h.version != kVersion) fail("unsupported version " + std::to_string(h.version));
+    if (h.elem_size != sizeof(double)) fail("unsupported element size " + std::to_string(h.elem_size));
+    if (h.rows == 0 || h.cols == 0) fail("empty matrix");
+    if (h.cols > (SIZE_MAX - sizeof h) / sizeof(double) / h.rows) fail("matrix too large");
+
+    const std::size_t n = h.rows * h.cols;
+    if (file_bytes != sizeof h + n * sizeof(double)) {
+        fail("expected " + std::to_string(sizeof h + n * sizeof(double)) + " bytes for " +
+             std::to_string(h.rows) + "x" + std::to_string(h.cols) + ", file has " +
+             std::to_string(file_bytes));
+    }
+    return n;
+}
+
+#ifdef LOC_HAVE_MMAP
+
+namespace {
+
+// Owns the mapping; the matrix is a view into it.
+struct MappedMatrix {
+    void* addr = MAP_FAILED;
+    std::size_t len = 0;
+    Matrix m;
+
+    ~MappedMatrix() {
+        if (addr != MAP_FAILED) munmap(addr, len);
+    }
+};
+
+} // namespace
+
+MatrixPtr load_matrix(const std::string& path) {
+    if (!little_endian()) throw std::runtime_error("load: only little-endian hosts are supported");
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("load(\"" + path + "\"): " + std::strerror(errno));
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const int err = errno;
+        ::close(fd);
+        throw std::runtime_error("load(\"" + path + "\"): " + std::strerror(err));
+    }
+    const std::size_t len = (std::size_t)st.st_size;
+    if (len < sizeof(MatrixFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("load(\"" + path + "\"): file too short for a header");
+    }
+
+    // Private and writable: pages are shared with the page cache until
+    // written, and a write never reaches the file.
+    auto mapped = std::make_shared<MappedMatrix>();
+    mapped->addr = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    const int err = errno;
+    ::close(fd); // the mapping keeps the file referenced
+    if (mapped->addr == MAP_FAILED) throw std::runtime_error("load(\"" + path + "\"): mmap: " + std::strerror(err));
+    mapped->len = len;
+
+    MatrixFileHeader h;
+    std::memcpy(&h, mapped->addr, sizeof h);
+    check_header(h, len, path);
+    ::madvise(mapped->addr, len, MADV_WILLNEED);
+
+    double* data = reinterpret_cast<double*>(static_cast<char*>(mapped->addr) + sizeof h);
+    mapped->m = Matrix::view(h.rows, h.cols, data);
+    return MatrixPtr(mapped, &mapped->m);
+}
+
+#else
+
+MatrixPtr load_matrix(const std::string& path) {
+    if (!little_endian()) throw std::runtime_error("load: only little-endian hosts are supported");
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) throw std::runtime_error("load(\"" + path + "\"): could not open file");
+    const std::size_t len = (std::size_t)in.tellg();
+    in.seekg(0);
+
+    MatrixFileHeader h;
+    if (len < sizeof h || !in.read(reinterpret_cast<char*>(&h), sizeof h))
+        throw std::runtime_error("load(\"" + path + "\"): file too short for a header");
+    const std::size_t n = check_header(h, len, path);
+
+    Matrix m = Matrix::uninitialized(h.rows, h.cols);
+    if (!in.read(reinterpret_cast<char*>(m.data()), (std::streamsize)(n * sizeof(double))))
+        throw std::runtime_error("load(\"" + path + "\"): read failed");
+    return std::make_shared<const Matrix>(std::move(m));
+}
+
+#endif
+
+void save_matrix(const std::string& path, const Matrix& m) {
+    if (!little_endian()) throw std::runtime_error("save: only little-endian hosts are supported");
+
+    MatrixFileHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof kMagic);
+    h.version = kVersion;
+    h.elem_size = sizeof(double);
+    h.rows = m.rows();
+    h.cols = m.cols();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("save(\"" + path + "\"): could not open file");
+    out.write(reinterpret_cast<const char*>(&h), sizeof h);
+    out.write(reinterpret_cast<const char*>(m.data()), (std::streamsize)(m.size() * sizeof(double)));
+    if (!out) throw std::runtime_error("save(\"" + path + "\"): write failed");
+}
+
+// ---------- Sparse (CSR) files ----------
+
+static constexpr char kSparseMagic[8] = {'L', 'O', 'C', 'C', 'S', 'R', '\0', '\0'};
+
+static std::size_t padded_index_bytes(std::uint64_t nnz) {
+    return (std::size_t)((nnz * sizeof(SparseMatrix::Index) + 7) / 8 * 8);
+}
+
+bool is_sparse_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    return in.read(magic, sizeof magic) && std::memcmp(magic, kSparseMagic, sizeof magic) == 0;
+}
+
+SparsePtr load_sparse_matrix(const std::string& path) {
+    if (!little_endian()) throw std::runtime_error("load: only little-endian hosts are supported");
+    auto fail = [&](const std::string& why) {
+        throw std::runtime_error("load(\"" + path + "\"): " + why);
+    };
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) fail("could not open file");
+    const std::size_t len = (std::size_t)in.tellg();
+    in.seekg(0);
+
+    SparseFileHeader h;
+    if (len < sizeof h || !in.read(reinterpret_cast<char*>(&h), sizeof h)) fail("file too short for a header");
+    if (std::memcmp(h.magic, kSparseMagic, sizeof kSparseMagic) != 0) fail("not a sparse matrix file (bad magic)");
+    if (h.version != kVersion) fail("unsupported version " + std::to_string(h.version));
+    if (h.elem_size != sizeof(double)) fail("unsupported element size " + std::to_string(h.elem_size));
+    if (h.rows == 0 || h.cols == 0) fail("empty matrix");
+    if (h.rows >= len || h.nnz >= len) fail("file too short for " + std::to_string(h.rows) + " rows, " +
+                                            std::to_string(h.nnz) + " nonzeros");
+
+    const std::size_t expect = sizeof h + (h.rows + 1) * sizeof(std::uint64_t) +
+                               padded_index_bytes(h.nnz) + h.nnz * sizeof(double);
+    if (len != expect) {
+        fail("expected " + std::to_string(expect) + " bytes for " + std::to_string(h.rows) + "x" +
+             std::to_string(h.cols) + " with " + std::to_string(h.nnz) + " nonzeros, file has " +
+             std::to_string(len));
+    }
+
+    std::vector<std::uint64_t> rp(h.rows + 1);
+    SparseMatrix::Array<SparseMatrix::Index> ci(h.nnz);
+    SparseMatrix::Array<double> v(h.nnz);
+    in.read(reinterpret_cast<char*>(rp.data()), (std::streamsize)(rp.size() * sizeof rp[0]));
+    in.read(reinterpret_cast<char*>(ci.data()), (std::streamsize)(ci.size() * sizeof ci[0]));
+    in.seekg((std::streamoff)(sizeof h + rp.size() * sizeof rp[0] + padded_index_bytes(h.nnz)));
+    in.read(reinterpret_cast<char*>(v.data()), (std::streamsize)(v.size() * sizeof v[0]));
+    if (!in) fail("read failed");
+
+    try {
+        return std::make_shared<const SparseMatrix>(
+            h.rows, h.cols, SparseMatrix::Array<std::size_t>(rp.begin(), rp.end()), std::move(ci),
+            std::move(v));
+    } catch (const std::runtime_error& e) {
+        fail(e.what());
+    }
+    return nullptr;
+}
+
+void save_sparse_matrix(const std::string& path, const SparseMatrix& m) {
+    if (!little_endian()) throw std::runtime_error("save: only little-endian hosts are supported");
+
+    SparseFileHeader h{};
+    std::memcpy(h.magic, kSparseMagic, sizeof kSparseMagic);
+    h.version = kVersion;
+    h.elem_size = sizeof(double);
+    h.rows = m.rows();
+    h.cols = m.cols();
+    h.nnz = m.nnz();
+
+    const std::vector<std::uint64_t> rp(m.row_ptr().begin(), m.row_ptr().end());
+    const std::size_t pad = padded_index_bytes(h.nnz) - m.nnz() * sizeof(SparseMatrix::Index);
+    const char zeros[8] = {};
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("save(\"" + path + "\"): could not open file");
+    out.write(reinterpret_cast<const char*>(&h), sizeof h);
+    out.write(reinterpret_cast<const char*>(rp.data()), (std::streamsize)(rp.size() * sizeof rp[0]));
+    out.write(reinterpret_cast<const char*>(m.col_idx().data()),
+              (std::streamsize)(m.nnz() * sizeof(SparseMatrix::Index)));
+    out.write(zeros, (std::streamsize)pad);
+    out.write(reinterpret_cast<const char*>(m.values().data()), (std::streamsize)(m.nnz() * sizeof(double)));
+    if (!out) throw std::runtime_error("save(\"" + path + "\"): write failed");
+}
+
+} // namespace loc::rt
@@ -0,0 +1,200 @@
+#include "loc/runtime/memory_plan.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace loc::rt {
+
+// Slots start on 64-byte boundaries so SIMD kernels see aligned outputs.
+static constexpr std::size_t kSlotAlign = 64 / sizeof(double);
+
+static std::size_t round_up(std::size_t n) {
+    return (n + kSlotAlign - 1) / kSlotAlign * kSlotAlign;
+}
+
+namespace {
+
+struct Buffer {
+    std::size_t size = 0;   // doubles, rounded to kSlotAlign
+    int start = 0, end = 0; // closed lifetime interval over evaluation steps
+    std::size_t offset = 0;
+};
+
+} // namespace
+
+MemoryPlan plan_memory(const loc::ir::Graph& g, const Registry& reg) {
+    using K = loc::ir::NodeKind;
+
+    MemoryPlan p;
+    p.liveness = loc::ir::passes::compute_liveness(g);
+    const auto& lv = p.liveness;
+
+    const std::size_t n_nodes = g.nodes.size();
+    p.rows.assign(n_nodes, 0);
+    p.cols.assign(n_nodes, 0);
+    p.offset.assign(n_nodes, MemoryPlan::kNoSlot);
+    p.scratch.assign(n_nodes, MemoryPlan::kNoSlot);
+
+    // 1) Shapes, in evaluation order (inputs first)
+    for (int id : lv.order) {
+        const auto& n = g.nodes[id];
+        switch (n.kind) {
+        case K::Op: {
+            const loc::ir::Shape sh = reg.shape(n.name);
+            p.rows[id] = sh.rows;
+            p.cols[id] = sh.cols;
+            break;
+        }
+        case K::Zero:
+            p.rows[id] = n.rows;
+            p.cols[id] = n.cols;
+            break;
+        case K::ScalarMul:
+            p.rows[id] = p.rows[n.inputs.at(0)];
+            p.cols[id] = p.cols[n.inputs.at(0)];
+            break;
+        case K::Add: {
+            const int a = n.inputs.at(0), b = n.inputs.at(1);
+            if (p.rows[a] != p.rows[b] || p.cols[a] != p.cols[b])
+                throw std::runtime_error("Matrix add: shape mismatch");
+            p.rows[id] = p.rows[a];
+            p.cols[id] = p.cols[a];
+            break;
+        }
+        case K::LinComb: {
+            const int a = n.inputs.at(0);
+            for (int b : n.inputs) {
+                if (p.rows[a] != p.rows[b] || p.cols[a] != p.cols[b])
+                    throw std::runtime_error("Matrix add: shape mismatch");
+            }
+            p.rows[id] = p.rows[a];
+            p.cols[id] = p.cols[a];
+            break;
+        }
+        case K::Compose:
+        case K::Gemm: {
+            const int a = n.inputs.at(0), b = n.inputs.at(1);
+            const std::size_t m = n.trans_a ? p.cols[a] : p.rows[a];
+            const std::size_t k = n.trans_a ? p.rows[a] : p.cols[a];
+            const std::size_t cols = n.trans_b ? p.rows[b] : p.cols[b];
+            if (k != (n.trans_b ? p.cols[b] : p.rows[b]))
+                throw std::runtime_error("Matrix matmul: shape mismatch");
+            if (n.inputs.size() > 2) {
+                const int c = n.inputs[2];
+                if (p.rows[c] != m || p.cols[c] != cols)
+                    throw std::runtime_error("Matrix add: shape mismatch");
+            }
+            p.rows[id] = m;
+            p.cols[id] = cols;
+            break;
+        }
+        case K::Transpose: {
+            const int a = n.inputs.at(0);
+            p.rows[id] = p.cols[a];
+            p.cols[id] = p.rows[a];
+            break;
+        }
+        case K::Pow: {
+            const int a = n.inputs.at(0);
+            if (p.rows[a] != p.cols[a])
+                throw std::runtime_error("Matrix power: matrix is not square");
+            p.rows[id] = p.rows[a];
+            p.cols[id] = p.cols[a];
+            break;
+        }
+        default:
+            throw std::runtime_error("plan_memory: unknown node kind");
+        }
+    }
+
+    // 2) One buffer per intermediate, except results that can take over an
+    //    input dying at the same step.
+    std::vector<int> buf_of(n_nodes, -1);
+    std::vector<int> scratch_of(n_nodes, -1);
+    std::vector<Buffer> bufs;
+
+    for (int pos = 0; pos < (int)lv.order.size(); ++pos) {
+        const int id = lv.order[pos];
+        const auto& n = g.nodes[id];
+        if (n.kind == K::Op) continue;
+
+        const std::size_t size = p.rows[id] * p.cols[id];
+        p.naive_elems += size;
+
+        // Elementwise kernels may overwrite any input; a Gemm only its
+        // accumulation operand, and only if it is not also a factor.
+        std::vector<int> candidates;
+        if (n.kind == K::Add || n.kind == K::ScalarMul || n.kind == K::LinComb) {
+            candidates = n.inputs;
+        } else if (n.kind == K::Gemm && n.inputs.size() > 2 &&
+                   n.inputs[2] != n.inputs[0] && n.inputs[2] != n.inputs[1]) {
+            candidates = {n.inputs[2]};
+        }
+
+        int reuse = -1;
+        for (int in : candidates) {
+            const int b = buf_of[in];
+            if (b >= 0 && lv.last_use[in] == pos && bufs[b].end == pos &&
+                p.rows[in] * p.cols[in] == size) {
+                reuse = b;
+                break;
+            }
+        }
+
+        if (reuse >= 0) {
+            buf_of[id] = reuse;
+            bufs[reuse].end = std::max(bufs[reuse].end, lv.last_use[id]);
+            ++p.in_place;
+        } else {
+            buf_of[id] = (int)bufs.size();
+            bufs.push_back(Buffer{round_up(size), pos, lv.last_use[id], 0});
+        }
+
+        // Repeated squaring keeps two more powers, only while it runs
+        if (n.kind == K::Pow && n.exponent > 1) {
+            scratch_of[id] = (int)bufs.size();
+            bufs.push_back(Buffer{round_up(2 * size), pos, pos, 0});
+            p.naive_elems += 2 * size;
+        }
+    }
+
+    // 3) Greedy offset assignment, largest first
+    std::vector<int> by_size(bufs.size());
+    std::iota(by_size.begin(), by_size.end(), 0);
+    std::stable_sort(by_size.begin(), by_size.end(), [&](int a, int b) {
+        return bufs[a].size > bufs[b].size;
+    });
+
+    std::vector<int> placed;
+    std::vector<int> conflicts;
+    for (int b : by_size) {
+        Buffer& cur = bufs[b];
+
+        conflicts.clear();
+        for (int o : placed) {
+            if (bufs[o].start <= cur.end && cur.start <= bufs[o].end) conflicts.push_back(o);
+        }
+        std::sort(conflicts.begin(), conflicts.end(), [&](int x, int y) {
+            return bufs[x].offset < bufs[y].offset;
+        });
+
+        // Lowest gap between conflicting buffers that fits
+        std::size_t off = 0;
+        for (int o : conflicts) {
+            if (off + cur.size <= bufs[o].offset) break;
+            off = std::max(off, bufs[o].offset + bufs[o].size);
+        }
+        cur.offset = off;
+        p.arena_elems = std::max(p.arena_elems, off + cur.size);
+        placed.push_back(b);
+    }
+
+    for (std::size_t id = 0; id < n_nodes; ++id) {
+        if (buf_of[id] >= 0) p.offset[id] = bufs[buf_of[id]].offset;
+        if (scratch_of[id] >= 0) p.scratch[id] = bufs[scratch_of[id]].offset;
+    }
+    return p;
+}
+
+} // namespace loc::rt
@@ -0,0 +1,62 @@
+#include "loc/runtime/precision.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace loc::rt {
+
+static std::atomic<int>& precision_slot() {
+    static std::atomic<int> slot{[] {
+        Precision p = Precision::F64;
+        if (const char* s = std::getenv("LOC_PRECISION")) {
+            parse_precision(s, p); // unknown names keep the default
+        }
+        return (int)p;
+    }()};
+    return slot;
+}
+
+void set_precision(Precision p) {
+    precision_slot().store((int)p, std::memory_order_relaxed);
+}
+
+Precision precision() {
+    return (Precision)precision_slot().load(std::memory_order_relaxed);
+}
+
+bool parse_precision(const std::string& s, Precision& out) {
+    if (s == "f64")   { out = Precision::F64;   return true; }
+    if (s == "f32")   { out = Precision::F32;   return true; }
+    if (s == "mixed") { out = Precision::Mixed; return true; }
+    return false;
+}
+
+const char* precision_name(Precision p) {
+    switch (p) {
+        case Precision::F64:   return "f64";
+        case Precision::F32:   return "f32";
+        case Precision::Mixed: return "mixed";
+    }
+    return "?";
+}
+
+PrecisionError precision_error(const Matrix& value, const Matrix& reference) {
+    if (value.rows() != reference.rows() || value.cols() != reference.cols())
+        throw std::runtime_error("precision_error: shape mismatch");
+
+    PrecisionError e;
+    double scale = 0.0;
+    const double* x = value.data();
+    const double* r = reference.data();
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        e.max_abs = std::max(e.max_abs, std::fabs(x[i] - r[i]));
+        scale = std::max(scale, std::fabs(r[i]));
+    }
+    e.rel = e.max_abs / (scale > 0.0 ? scale : 1.0);
+    return e;
+}
+
+} // namespace loc::rt
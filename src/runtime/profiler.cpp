@@ -0,0 +1,188 @@
+#include "loc/runtime/profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+namespace loc::rt {
+
+// Small stable id for the calling thread (trace track).
+static int thread_index() {
+    static std::atomic<int> next{0};
+    thread_local const int idx = next.fetch_add(1);
+    return idx;
+}
+
+static std::string label_of(const loc::ir::Node& n) {
+    using K = loc::ir::NodeKind;
+    std::ostringstream oss;
+    switch (n.kind) {
+    case K::Op:        oss << "Op(" << n.name << ")"; break;
+    case K::ScalarMul: oss << "ScalarMul(" << n.scalar << ")"; break;
+    case K::Add:       oss << "Add"; break;
+    case K::Compose:   oss << "Compose(@)"; break;
+    case K::LinComb:   oss << "LinComb(" << n.inputs.size() << ")"; break;
+    case K::Gemm:      oss << (n.inputs.size() > 2 ? "Gemm(+C)" : "Gemm"); break;
+    case K::Zero:      oss << "Zero"; break;
+    case K::Pow:       oss << "Pow(" << n.exponent << ")"; break;
+    case K::Transpose: oss << "Transpose"; break;
+    }
+    return oss.str();
+}
+
+void Profiler::start(const loc::ir::Graph& g) {
+    std::lock_guard<std::mutex> lk(mu_);
+    g_ = &g;
+    origin_ = Clock::now();
+    nodes_.assign(g.nodes.size(), NodeStats{});
+    for (std::size_t i = 0; i < g.nodes.size(); ++i) nodes_[i].label = label_of(g.nodes[i]);
+    events_.clear();
+}
+
+void Profiler::record(int id, Clock::time_point t0, Clock::time_point t1,
+                      std::size_t rows, std::size_t cols) {
+    using K = loc::ir::NodeKind;
+    const auto& n = g_->nodes[id];
+    NodeStats& s = nodes_[id];
+
+    // Analytic cost from the shapes recorded for this node and its inputs
+    const std::uint64_t out = (std::uint64_t)rows * cols;
+    std::uint64_t in_elems = 0;
+    for (int v : n.inputs) in_elems += (std::uint64_t)nodes_[v].rows * nodes_[v].cols;
+
+    std::uint64_t flops = 0;
+    switch (n.kind) {
+    case K::Op:
+        in_elems = 0;
+        break;
+    case K::ScalarMul:
+    case K::Add:
+        flops = out;
+        break;
+    case K::LinComb:
+        flops = out * (2 * n.inputs.size() - 1);
+        break;
+    case K::Zero:
+    case K::Transpose: // a copy: bytes only
+        break;
+    case K::Compose:
+    case K::Gemm: {
+        // A structured operator factor (see structure.hpp) costs one
+        // multiply per output element instead of a k-long dot product; a
+        // sparse one only its nonzeros' share
+        auto structure = [&](int v) {
+            return g_->nodes[v].kind == K::Op ? g_->nodes[v].structure : loc::ir::Structure::Dense;
+        };
+        auto density = [&](int v) {
+            return structure(v) == loc::ir::Structure::Sparse ? g_->nodes[v].scalar : 1.0;
+        };
+        auto structured = [&](int v) {
+            return structure(v) != loc::ir::Structure::Dense && structure(v) != loc::ir::Structure::Sparse;
+        };
+        const std::uint64_t k = n.trans_a ? nodes_[n.inputs[0]].rows : nodes_[n.inputs[0]].cols;
+        flops = structured(n.inputs[0]) || structured(n.inputs[1])
+                    ? out
+                    : (std::uint64_t)(2.0 * (double)out * (double)k *
+                                      density(n.inputs[0]) * density(n.inputs[1]));
+        if (n.kind == K::Gemm) flops += out * (n.inputs.size() > 2 ? 3 : 1);
+        break;
+    }
+    case K::Pow:
+        // Square, so each product is 2 * out * rows (counted dense)
+        flops = 2 * out * rows * loc::ir::pow_products(n.exponent);
+        break;
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        events_.push_back(Event{id, thread_index(),
+                                std::chrono::duration<double, std::micro>(t0 - origin_).count(),
+                                ms * 1000.0});
+    }
+    s.rows = rows;
+    s.cols = cols;
+    s.ms += ms;
+    s.flops = flops;
+    s.bytes = n.kind == K::Op ? 0 : (in_elems + out) * sizeof(double);
+    ++s.misses;
+}
+
+void Profiler::hit(int id, std::size_t n) {
+    std::lock_guard<std::mutex> lk(mu_);
+    nodes_[id].hits += n;
+}
+
+void Profiler::print_summary(std::ostream& os) const {
+    std::vector<int> ids;
+    double total = 0.0;
+    for (std::size_t i = 0; i < nodes_.size(); ++i) {
+        if (!nodes_[i].misses || g_->nodes[i].kind == loc::ir::NodeKind::Op) continue;
+        ids.push_back((int)i);
+        total += nodes_[i].ms;
+    }
+    std::stable_sort(ids.begin(), ids.end(), [&](int a, int b) { return nodes_[a].ms > nodes_[b].ms; });
+
+    const auto flags = os.flags();
+    const auto prec = os.precision();
+    os << "=== Node profile ===\n"
+       << std::left << std::setw(8) << "node" << std::setw(18) << "kind" << std::right
+       << std::setw(13) << "shape" << std::setw(11) << "ms" << std::setw(7) << "%"
+       << std::setw(11) << "GFLOP/s" << std::setw(9) << "GB/s"
+       << std::setw(10) << "hit/miss" << "\n";
+    os << std::fixed;
+
+    std::uint64_t flops = 0, bytes = 0;
+    for (int id : ids) {
+        const NodeStats& s = nodes_[id];
+        const double sec = s.ms / 1000.0;
+        flops += s.flops * s.misses;
+        bytes += s.bytes * s.misses;
+        os << std::left << std::setw(8) << ("%" + std::to_string(id)) << std::setw(18) << s.label
+           << std::right
+           << std::setw(13) << (std::to_string(s.rows) + "x" + std::to_string(s.cols))
+           << std::setw(11) << std::setprecision(3) << s.ms
+           << std::setw(7) << std::setprecision(1) << (total > 0 ? 100.0 * s.ms / total : 0.0)
+           << std::setw(11) << std::setprecision(2) << (sec > 0 ? s.flops * s.misses / sec / 1e9 : 0.0)
+           << std::setw(9) << std::setprecision(2) << (sec > 0 ? s.bytes * s.misses / sec / 1e9 : 0.0)
+           << std::setw(10) << (std::to_string(s.hits) + "/" + std::to_string(s.misses)) << "\n";
+    }
+    const double sec = total / 1000.0;
+    os << std::left << std::setw(8) << "total" << std::setw(18) << "" << std::right
+       << std::setw(13) << ""
+       << std::setw(11) << std::setprecision(3) << total
+       << std::setw(7) << std::setprecision(1) << (total > 0 ? 100.0 : 0.0)
+       << std::setw(11) << std::setprecision(2) << (sec > 0 ? flops / sec / 1e9 : 0.0)
+       << std::setw(9) << std::setprecision(2) << (sec > 0 ? bytes / sec / 1e9 : 0.0) << "\n";
+    os.flags(flags);
+    os.precision(prec);
+}
+
+void Profiler::write_trace(std::ostream& os) const {
+    std::vector<Event> evs = events_;
+    std::stable_sort(evs.begin(), evs.end(), [](const Event& a, const Event& b) { return a.ts_us < b.ts_us; });
+
+    const auto flags = os.flags();
+    const auto prec = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (std::size_t i = 0; i < evs.size(); ++i) {
+        const Event& e = evs[i];
+        const NodeStats& s = nodes_[e.id];
+        // Labels hold only identifier characters, digits and punctuation
+        // that need no JSON escaping (operator names are identifiers).
+        os << (i ? ",\n" : "\n")
+           << "  {\"name\": \"%" << e.id << " " << s.label << "\", \"cat\": \"node\", \"ph\": \"X\""
+           << ", \"ts\": " << e.ts_us << ", \"dur\": " << e.dur_us
+           << ", \"pid\": 1, \"tid\": " << e.tid
+           << ", \"args\": {\"shape\": \"" << s.rows << "x" << s.cols << "\""
+           << ", \"flops\": " << s.flops << ", \"bytes\": " << s.bytes << "}}";
+    }
+    os << "\n]}\n";
+    os.flags(flags);
+    os.precision(prec);
+}
+
+} // namespace loc::rt
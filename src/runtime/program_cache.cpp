@@ -0,0 +1,168 @@
+#include "loc/runtime/program_cache.hpp"
+#include "loc/ir/serialize.hpp"
+#include "loc/runtime/matrix_file.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+namespace loc::rt {
+
+namespace fs = std::filesystem;
+
+static constexpr char kMagic[8] = {'L', 'O', 'C', 'I', 'R', '\0', '\0', '\0'};
+
+std::string operator_path(const std::string& base_dir, const std::string& path) {
+    return path.rfind('/', 0) == 0 ? path : base_dir + path;
+}
+
+// ---------- Key ----------
+
+// 64-bit FNV-1a
+static std::uint64_t fnv1a(std::uint64_t h, const void* data, std::size_t n) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+std::uint64_t program_cache_key(const std::string& source, const std::string& pipeline) {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    h = fnv1a(h, &kProgramCacheVersion, sizeof kProgramCacheVersion);
+    const std::uint64_t len = pipeline.size();
+    h = fnv1a(h, &len, sizeof len); // keeps pipeline and source apart
+    h = fnv1a(h, pipeline.data(), pipeline.size());
+    return fnv1a(h, source.data(), source.size());
+}
+
+// ---------- Entries ----------
+
+std::string ProgramCache::entry_path(std::uint64_t key) const {
+    char hex[17];
+    std::snprintf(hex, sizeof hex, "%016llx", (unsigned long long)key);
+    return (fs::path(dir_) / (std::string(hex) + ".locir")).string();
+}
+
+std::string ProgramCache::operator_file(std::uint64_t key, std::size_t i) const {
+    std::string p = entry_path(key);
+    p.resize(p.size() - 6); // ".locir"
+    return p + "." + std::to_string(i) + ".bin";
+}
+
+static void write_shape(loc::ir::ByteWriter& w, const loc::ir::Shape& s) {
+    w.varint(s.rows);
+    w.varint(s.cols);
+    w.byte((std::uint8_t)s.structure);
+    w.f64(s.scale);
+}
+
+static loc::ir::Shape read_shape(loc::ir::ByteReader& r) {
+    loc::ir::Shape s;
+    s.rows = (std::size_t)r.varint();
+    s.cols = (std::size_t)r.varint();
+    s.structure = (loc::ir::Structure)r.byte();
+    s.scale = r.f64();
+    return s;
+}
+
+std::optional<loc::ir::Graph> ProgramCache::load(std::uint64_t key, const std::string& base_dir,
+                                                 Registry& reg) const {
+    std::ifstream in(entry_path(key), std::ios::binary);
+    if (!in) return std::nullopt;
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    try {
+        loc::ir::ByteReader r(data.data(), data.size());
+        for (char c : kMagic) {
+            if (r.byte() != (std::uint8_t)c) return std::nullopt;
+        }
+        if (r.varint() != kProgramCacheVersion || r.varint() != key) return std::nullopt;
+
+        const std::uint64_t count = r.varint();
+        for (std::uint64_t i = 0; i < count; ++i) {
+            std::string name = r.str();
+            const auto source = (CachedOperator::Source)r.byte();
+            const std::string path = r.str();
+            const loc::ir::Shape want = read_shape(r);
+            switch (source) {
+            case CachedOperator::Source::Literal: reg.set_shared(name, load_matrix(operator_file(key, i))); break;
+            case CachedOperator::Source::File:    reg.load(name, operator_path(base_dir, path)); break;
+            case CachedOperator::Source::Default: reg.set(name, Matrix::identity(want.rows)); break;
+            default: return std::nullopt;
+            }
+            const loc::ir::Shape got = reg.shape(name);
+            if (got.rows != want.rows || got.cols != want.cols ||
+                got.structure != want.structure || got.scale != want.scale) {
+                return std::nullopt;
+            }
+        }
+
+        loc::ir::Graph g = loc::ir::read_graph(r);
+        if (!r.done()) return std::nullopt;
+        return g;
+    } catch (const std::exception&) {
+        return std::nullopt; // unreadable entry or operator file: compile afresh
+    }
+}
+
+bool ProgramCache::store(std::uint64_t key, const loc::ir::Graph& g,
+                         const std::vector<CachedOperator>& ops, const Registry& reg) const {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) return false;
+
+    // Per-writer temporary suffix, so concurrent writers of one entry
+    // never interleave inside a file
+    std::random_device rd;
+    const std::string tmp = ".tmp" + std::to_string(rd()) + std::to_string(rd());
+    auto publish = [&](const std::string& path) {
+        fs::rename(path + tmp, path, ec);
+        if (ec) fs::remove(path + tmp, ec);
+        return !ec;
+    };
+
+    std::string pending; // file being written under its temporary name
+    try {
+        std::string data;
+        loc::ir::ByteWriter w(data);
+        for (char c : kMagic) w.byte((std::uint8_t)c);
+        w.varint(kProgramCacheVersion);
+        w.varint(key);
+
+        w.varint(ops.size());
+        for (std::size_t i = 0; i < ops.size(); ++i) {
+            const CachedOperator& op = ops[i];
+            w.str(op.name);
+            w.byte((std::uint8_t)op.source);
+            w.str(op.path);
+            write_shape(w, reg.shape(op.name));
+            if (op.source == CachedOperator::Source::Literal) {
+                // Saved dense, so the density policy of the run that reads
+                // it back decides its storage (and its shape check)
+                pending = operator_file(key, i);
+                if (SparsePtr sp = reg.get_sparse(op.name)) save_matrix(pending + tmp, sp->to_dense());
+                else save_matrix(pending + tmp, reg.get(op.name));
+                if (!publish(pending)) return false;
+            }
+        }
+        loc::ir::write_graph(w, g);
+
+        pending = entry_path(key);
+        {
+            std::ofstream out(pending + tmp, std::ios::binary | std::ios::trunc);
+            out.write(data.data(), (std::streamsize)data.size());
+            if (!out) throw std::runtime_error("write failed");
+        }
+        return publish(pending);
+    } catch (const std::exception&) {
+        if (!pending.empty()) fs::remove(pending + tmp, ec);
+        return false;
+    }
+}
+
+} // namespace loc::rt
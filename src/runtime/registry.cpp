@@ -1,13 +1,60 @@
 #include "loc/runtime/registry.hpp"
+#include "loc/runtime/matrix_file.hpp"
 #include <stdexcept>
 
 namespace loc::rt {
 
 void Registry::set(std::string name, Matrix m) {
-    ops_[std::move(name)] = std::move(m);
+    set_shared(std::move(name), std::make_shared<const Matrix>(std::move(m)));
+}
+
+void Registry::set_shared(std::string name, MatrixPtr m) {
+    StructuredOp s = detect_structure(*m);
+    if (s.kind == Structure::Dense) {
+        if (SparsePtr sp = sparsify(*m)) {
+            set_sparse(std::move(name), std::move(sp));
+            return;
+        }
+    }
+    ops_[std::move(name)] = Entry{std::move(m), nullptr, std::move(s)};
+}
+
+void Registry::set_sparse(std::string name, SparsePtr m) {
+    StructuredOp s;
+    s.kind = Structure::Sparse;
+    ops_[std::move(name)] = Entry{nullptr, std::move(m), std::move(s)};
+}
+
+void Registry::load(std::string name, const std::string& path) {
+    if (is_sparse_file(path)) set_sparse(std::move(name), load_sparse_matrix(path));
+    else set_shared(std::move(name), load_matrix(path));
 }
 
 const Matrix& Registry::get(const std::string& name) const {
+    return *get_shared(name);
+}
+
+MatrixPtr Registry::get_shared(const std::string& name) const {
+    const Entry& e = find(name);
+    if (!e.m) throw std::runtime_error("Registry: operator '" + name + "' is stored sparse");
+    return e.m;
+}
+
+SparsePtr Registry::get_sparse(const std::string& name) const {
+    return find(name).sp;
+}
+
+const StructuredOp& Registry::structure(const std::string& name) const {
+    return find(name).s;
+}
+
+loc::ir::Shape Registry::shape(const std::string& name) const {
+    const Entry& e = find(name);
+    if (e.sp) return loc::ir::Shape{e.sp->rows(), e.sp->cols(), Structure::Sparse, e.sp->density()};
+    return loc::ir::Shape{e.m->rows(), e.m->cols(), e.s.kind, e.s.scale};
+}
+
+const Registry::Entry& Registry::find(const std::string& name) const {
     auto it = ops_.find(name);
     if (it == ops_.end()) {
         throw std::runtime_error("Registry: unknown operator '" + name + "'");
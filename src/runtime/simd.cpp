@@ -0,0 +1,483 @@
+#include "loc/runtime/simd.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LOC_SIMD_X86 1
+#include <immintrin.h>
+#define LOC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace loc::rt::simd {
+
+// ---------- Scalar fallback ----------
+
+template <class T>
+static void add_scalar(const T* x, const T* y, T* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = x[i] + y[i];
+}
+
+template <class T>
+static void scale_scalar(T a, const T* x, T* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = a * x[i];
+}
+
+template <class T>
+static void axpby_scalar(T a, const T* x, T b, const T* y, T* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = a * x[i] + b * y[i];
+}
+
+#ifdef LOC_SIMD_X86
+
+// Each kernel peels scalars until `out` is vector-aligned, then runs aligned
+// (or streaming) stores with unaligned loads, then finishes the tail.
+template <class T>
+static std::size_t peel(const T* out, std::size_t n, std::size_t align) {
+    std::size_t i = 0;
+    while (i < n && (reinterpret_cast<std::uintptr_t>(out + i) & (align - 1))) ++i;
+    return i;
+}
+
+// ---------- SSE2 ----------
+
+LOC_TARGET("sse2")
+static void add_sse2(const double* x, const double* y, double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 16);
+    add_scalar(x, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_add_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i));
+        if (stream) _mm_stream_pd(out + i, v); else _mm_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    add_scalar(x + i, y + i, out + i, n - i);
+}
+
+LOC_TARGET("sse2")
+static void scale_sse2(double a, const double* x, double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 16);
+    scale_scalar(a, x, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m128d va = _mm_set1_pd(a);
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_mul_pd(va, _mm_loadu_pd(x + i));
+        if (stream) _mm_stream_pd(out + i, v); else _mm_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    scale_scalar(a, x + i, out + i, n - i);
+}
+
+LOC_TARGET("sse2")
+static void axpby_sse2(double a, const double* x, double b, const double* y,
+                       double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 16);
+    axpby_scalar(a, x, b, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m128d va = _mm_set1_pd(a);
+    const __m128d vb = _mm_set1_pd(b);
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(x + i)),
+                               _mm_mul_pd(vb, _mm_loadu_pd(y + i)));
+        if (stream) _mm_stream_pd(out + i, v); else _mm_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    axpby_scalar(a, x + i, b, y + i, out + i, n - i);
+}
+
+LOC_TARGET("sse2")
+static void add_sse2_f32(const float* x, const float* y, float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 16);
+    add_scalar(x, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_add_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i));
+        if (stream) _mm_stream_ps(out + i, v); else _mm_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    add_scalar(x + i, y + i, out + i, n - i);
+}
+
+LOC_TARGET("sse2")
+static void scale_sse2_f32(float a, const float* x, float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 16);
+    scale_scalar(a, x, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m128 va = _mm_set1_ps(a);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_mul_ps(va, _mm_loadu_ps(x + i));
+        if (stream) _mm_stream_ps(out + i, v); else _mm_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    scale_scalar(a, x + i, out + i, n - i);
+}
+
+LOC_TARGET("sse2")
+static void axpby_sse2_f32(float a, const float* x, float b, const float* y,
+                           float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 16);
+    axpby_scalar(a, x, b, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m128 va = _mm_set1_ps(a);
+    const __m128 vb = _mm_set1_ps(b);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(x + i)),
+                              _mm_mul_ps(vb, _mm_loadu_ps(y + i)));
+        if (stream) _mm_stream_ps(out + i, v); else _mm_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    axpby_scalar(a, x + i, b, y + i, out + i, n - i);
+}
+
+// ---------- AVX2 ----------
+
+LOC_TARGET("avx2")
+static void add_avx2(const double* x, const double* y, double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 32);
+    add_scalar(x, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_add_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i));
+        if (stream) _mm256_stream_pd(out + i, v); else _mm256_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    add_scalar(x + i, y + i, out + i, n - i);
+}
+
+LOC_TARGET("avx2")
+static void scale_avx2(double a, const double* x, double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 32);
+    scale_scalar(a, x, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m256d va = _mm256_set1_pd(a);
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_mul_pd(va, _mm256_loadu_pd(x + i));
+        if (stream) _mm256_stream_pd(out + i, v); else _mm256_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    scale_scalar(a, x + i, out + i, n - i);
+}
+
+// No FMA here on purpose: a*x + b*y rounds the same way on every ISA.
+LOC_TARGET("avx2")
+static void axpby_avx2(double a, const double* x, double b, const double* y,
+                       double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 32);
+    axpby_scalar(a, x, b, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m256d va = _mm256_set1_pd(a);
+    const __m256d vb = _mm256_set1_pd(b);
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(x + i)),
+                                  _mm256_mul_pd(vb, _mm256_loadu_pd(y + i)));
+        if (stream) _mm256_stream_pd(out + i, v); else _mm256_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    axpby_scalar(a, x + i, b, y + i, out + i, n - i);
+}
+
+LOC_TARGET("avx2")
+static void add_avx2_f32(const float* x, const float* y, float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 32);
+    add_scalar(x, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i));
+        if (stream) _mm256_stream_ps(out + i, v); else _mm256_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    add_scalar(x + i, y + i, out + i, n - i);
+}
+
+LOC_TARGET("avx2")
+static void scale_avx2_f32(float a, const float* x, float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 32);
+    scale_scalar(a, x, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m256 va = _mm256_set1_ps(a);
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_mul_ps(va, _mm256_loadu_ps(x + i));
+        if (stream) _mm256_stream_ps(out + i, v); else _mm256_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    scale_scalar(a, x + i, out + i, n - i);
+}
+
+LOC_TARGET("avx2")
+static void axpby_avx2_f32(float a, const float* x, float b, const float* y,
+                           float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 32);
+    axpby_scalar(a, x, b, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m256 va = _mm256_set1_ps(a);
+    const __m256 vb = _mm256_set1_ps(b);
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(va, _mm256_loadu_ps(x + i)),
+                                 _mm256_mul_ps(vb, _mm256_loadu_ps(y + i)));
+        if (stream) _mm256_stream_ps(out + i, v); else _mm256_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    axpby_scalar(a, x + i, b, y + i, out + i, n - i);
+}
+
+// ---------- AVX-512 ----------
+
+LOC_TARGET("avx512f")
+static void add_avx512(const double* x, const double* y, double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 64);
+    add_scalar(x, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    for (; i + 8 <= n; i += 8) {
+        __m512d v = _mm512_add_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i));
+        if (stream) _mm512_stream_pd(out + i, v); else _mm512_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    add_scalar(x + i, y + i, out + i, n - i);
+}
+
+LOC_TARGET("avx512f")
+static void scale_avx512(double a, const double* x, double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 64);
+    scale_scalar(a, x, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m512d va = _mm512_set1_pd(a);
+    for (; i + 8 <= n; i += 8) {
+        __m512d v = _mm512_mul_pd(va, _mm512_loadu_pd(x + i));
+        if (stream) _mm512_stream_pd(out + i, v); else _mm512_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    scale_scalar(a, x + i, out + i, n - i);
+}
+
+LOC_TARGET("avx512f")
+static void axpby_avx512(double a, const double* x, double b, const double* y,
+                         double* out, std::size_t n) {
+    std::size_t i = peel(out, n, 64);
+    axpby_scalar(a, x, b, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m512d va = _mm512_set1_pd(a);
+    const __m512d vb = _mm512_set1_pd(b);
+    for (; i + 8 <= n; i += 8) {
+        __m512d v = _mm512_add_pd(_mm512_mul_pd(va, _mm512_loadu_pd(x + i)),
+                                  _mm512_mul_pd(vb, _mm512_loadu_pd(y + i)));
+        if (stream) _mm512_stream_pd(out + i, v); else _mm512_store_pd(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    axpby_scalar(a, x + i, b, y + i, out + i, n - i);
+}
+
+LOC_TARGET("avx512f")
+static void add_avx512_f32(const float* x, const float* y, float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 64);
+    add_scalar(x, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_add_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i));
+        if (stream) _mm512_stream_ps(out + i, v); else _mm512_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    add_scalar(x + i, y + i, out + i, n - i);
+}
+
+LOC_TARGET("avx512f")
+static void scale_avx512_f32(float a, const float* x, float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 64);
+    scale_scalar(a, x, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m512 va = _mm512_set1_ps(a);
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_mul_ps(va, _mm512_loadu_ps(x + i));
+        if (stream) _mm512_stream_ps(out + i, v); else _mm512_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    scale_scalar(a, x + i, out + i, n - i);
+}
+
+LOC_TARGET("avx512f")
+static void axpby_avx512_f32(float a, const float* x, float b, const float* y,
+                             float* out, std::size_t n) {
+    std::size_t i = peel(out, n, 64);
+    axpby_scalar(a, x, b, y, out, i);
+    const bool stream = n >= kStreamMinElems;
+    const __m512 va = _mm512_set1_ps(a);
+    const __m512 vb = _mm512_set1_ps(b);
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_add_ps(_mm512_mul_ps(va, _mm512_loadu_ps(x + i)),
+                                 _mm512_mul_ps(vb, _mm512_loadu_ps(y + i)));
+        if (stream) _mm512_stream_ps(out + i, v); else _mm512_store_ps(out + i, v);
+    }
+    if (stream) _mm_sfence();
+    axpby_scalar(a, x + i, b, y + i, out + i, n - i);
+}
+
+#endif // LOC_SIMD_X86
+
+// ---------- Dispatch ----------
+
+template <class T>
+struct Kernels {
+    void (*add)(const T*, const T*, T*, std::size_t);
+    void (*scale)(T, const T*, T*, std::size_t);
+    void (*axpby)(T, const T*, T, const T*, T*, std::size_t);
+};
+
+static Kernels<double> kernels_for(Isa isa) {
+    switch (isa) {
+#ifdef LOC_SIMD_X86
+        case Isa::AVX512: return {add_avx512, scale_avx512, axpby_avx512};
+        case Isa::AVX2:   return {add_avx2,   scale_avx2,   axpby_avx2};
+        case Isa::SSE2:   return {add_sse2,   scale_sse2,   axpby_sse2};
+#endif
+        default:          return {add_scalar<double>, scale_scalar<double>, axpby_scalar<double>};
+    }
+}
+
+static Kernels<float> kernels_f32_for(Isa isa) {
+    switch (isa) {
+#ifdef LOC_SIMD_X86
+        case Isa::AVX512: return {add_avx512_f32, scale_avx512_f32, axpby_avx512_f32};
+        case Isa::AVX2:   return {add_avx2_f32,   scale_avx2_f32,   axpby_avx2_f32};
+        case Isa::SSE2:   return {add_sse2_f32,   scale_sse2_f32,   axpby_sse2_f32};
+#endif
+        default:          return {add_scalar<float>, scale_scalar<float>, axpby_scalar<float>};
+    }
+}
+
+Isa detected_isa() {
+    static const Isa isa = [] {
+#ifdef LOC_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Isa::AVX2;
+        return Isa::SSE2; // baseline on x86-64
+#else
+        return Isa::Scalar;
+#endif
+    }();
+    return isa;
+}
+
+static std::atomic<int>& isa_slot() {
+    static std::atomic<int> slot{[] {
+        Isa isa = detected_isa();
+        if (const char* s = std::getenv("LOC_SIMD")) {
+            Isa want;
+            if (parse_isa(s, want) && (int)want < (int)isa) isa = want;
+        }
+        return (int)isa;
+    }()};
+    return slot;
+}
+
+// One kernel table per ISA, built once; dispatch is an index by active ISA.
+static const Kernels<double>& table() {
+    static const Kernels<double> tables[] = {
+        kernels_for(Isa::Scalar), kernels_for(Isa::SSE2),
+        kernels_for(Isa::AVX2),   kernels_for(Isa::AVX512),
+    };
+    return tables[isa_slot().load(std::memory_order_relaxed)];
+}
+
+static const Kernels<float>& table_f32() {
+    static const Kernels<float> tables[] = {
+        kernels_f32_for(Isa::Scalar), kernels_f32_for(Isa::SSE2),
+        kernels_f32_for(Isa::AVX2),   kernels_f32_for(Isa::AVX512),
+    };
+    return tables[isa_slot().load(std::memory_order_relaxed)];
+}
+
+Isa active_isa() {
+    return (Isa)isa_slot().load(std::memory_order_relaxed);
+}
+
+void set_isa(Isa isa) {
+    if ((int)isa > (int)detected_isa()) isa = detected_isa();
+    isa_slot().store((int)isa, std::memory_order_relaxed);
+}
+
+bool parse_isa(const std::string& s, Isa& out) {
+    if (s == "scalar") { out = Isa::Scalar; return true; }
+    if (s == "sse2")   { out = Isa::SSE2;   return true; }
+    if (s == "avx2")   { out = Isa::AVX2;   return true; }
+    if (s == "avx512") { out = Isa::AVX512; return true; }
+    return false;
+}
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return "scalar";
+        case Isa::SSE2:   return "sse2";
+        case Isa::AVX2:   return "avx2";
+        case Isa::AVX512: return "avx512";
+    }
+    return "?";
+}
+
+void add(const double* x, const double* y, double* out, std::size_t n) {
+    table().add(x, y, out, n);
+}
+
+void scale(double a, const double* x, double* out, std::size_t n) {
+    table().scale(a, x, out, n);
+}
+
+void axpby(double a, const double* x, double b, const double* y,
+           double* out, std::size_t n) {
+    table().axpby(a, x, b, y, out, n);
+}
+
+void add(const float* x, const float* y, float* out, std::size_t n) {
+    table_f32().add(x, y, out, n);
+}
+
+void scale(float a, const float* x, float* out, std::size_t n) {
+    table_f32().scale(a, x, out, n);
+}
+
+void axpby(float a, const float* x, float b, const float* y,
+           float* out, std::size_t n) {
+    table_f32().axpby(a, x, b, y, out, n);
+}
+
+template <class T>
+static void lincomb_impl(const Kernels<T>& kr, std::size_t k, const T* coeffs,
+                         const T* const* xs, T* out, std::size_t n) {
+    if (k == 1) {
+        kr.scale(coeffs[0], xs[0], out, n);
+        return;
+    }
+
+    alignas(64) T acc[kLinCombBlock];
+    for (std::size_t off = 0; off < n; off += kLinCombBlock) {
+        const std::size_t len = std::min(kLinCombBlock, n - off);
+
+        if (coeffs[0] == 1) std::memcpy(acc, xs[0] + off, len * sizeof(T));
+        else kr.scale(coeffs[0], xs[0] + off, acc, len);
+
+        for (std::size_t i = 1; i + 1 < k; ++i) {
+            if (coeffs[i] == 1) kr.add(acc, xs[i] + off, acc, len);
+            else kr.axpby(1, acc, coeffs[i], xs[i] + off, acc, len);
+        }
+
+        // Last term lands in `out`; every input's block has been read by now,
+        // so writing it is safe even when `out` aliases one of them.
+        const T c = coeffs[k - 1];
+        if (c == 1) kr.add(acc, xs[k - 1] + off, out + off, len);
+        else kr.axpby(1, acc, c, xs[k - 1] + off, out + off, len);
+    }
+}
+
+void lincomb(std::size_t k, const double* coeffs, const double* const* xs,
+             double* out, std::size_t n) {
+    lincomb_impl(table(), k, coeffs, xs, out, n);
+}
+
+void lincomb(std::size_t k, const float* coeffs, const float* const* xs,
+             float* out, std::size_t n) {
+    lincomb_impl(table_f32(), k, coeffs, xs, out, n);
+}
+
+} // namespace loc::rt::simd
@@ -0,0 +1,404 @@
+#include "loc/runtime/sparse.hpp"
+#include "loc/runtime/gemm.hpp"
+#include "loc/runtime/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace loc::rt {
+
+SparseMatrix::SparseMatrix(std::size_t rows, std::size_t cols, Array<std::size_t> row_ptr,
+                           Array<Index> col_idx, Array<double> values)
+    : r_(rows), c_(cols), row_ptr_(std::move(row_ptr)), col_idx_(std::move(col_idx)),
+      val_(std::move(values)) {
+    auto fail = [](const std::string& why) { throw std::runtime_error("SparseMatrix: " + why); };
+    if (c_ > (std::size_t)std::numeric_limits<Index>::max() ||
+        r_ > (std::size_t)std::numeric_limits<Index>::max())
+        fail("dimension too large");
+    if (row_ptr_.size() != r_ + 1 || row_ptr_[0] != 0 || row_ptr_[r_] != val_.size() ||
+        col_idx_.size() != val_.size())
+        fail("inconsistent CSR arrays");
+    for (std::size_t i = 0; i < r_; ++i) {
+        if (row_ptr_[i + 1] < row_ptr_[i]) fail("row pointers decrease");
+        for (std::size_t p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p) {
+            if (col_idx_[p] >= c_) fail("column index out of range in row " + std::to_string(i));
+            if (p > row_ptr_[i] && col_idx_[p] <= col_idx_[p - 1])
+                fail("column indices not increasing in row " + std::to_string(i));
+        }
+    }
+
+    // CSC by counting sort; rows are visited in order, so row indices come
+    // out increasing within each column
+    col_ptr_.assign(c_ + 1, 0);
+    for (Index j : col_idx_) ++col_ptr_[j + 1];
+    for (std::size_t j = 0; j < c_; ++j) col_ptr_[j + 1] += col_ptr_[j];
+    row_idx_.resize(nnz());
+    cval_.resize(nnz());
+    std::vector<std::size_t> next(col_ptr_.begin(), col_ptr_.end() - 1);
+    for (std::size_t i = 0; i < r_; ++i) {
+        for (std::size_t p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p) {
+            const std::size_t q = next[col_idx_[p]]++;
+            row_idx_[q] = (Index)i;
+            cval_[q] = val_[p];
+        }
+    }
+}
+
+SparseMatrix SparseMatrix::from_dense(const Matrix& m) {
+    Array<std::size_t> row_ptr(m.rows() + 1, 0);
+    Array<Index> col_idx;
+    Array<double> values;
+    const double* p = m.data();
+    for (std::size_t i = 0; i < m.rows(); ++i) {
+        for (std::size_t j = 0; j < m.cols(); ++j) {
+            const double v = p[i * m.cols() + j];
+            if (v != 0.0) {
+                col_idx.push_back((Index)j);
+                values.push_back(v);
+            }
+        }
+        row_ptr[i + 1] = values.size();
+    }
+    return SparseMatrix(m.rows(), m.cols(), std::move(row_ptr), std::move(col_idx), std::move(values));
+}
+
+Matrix SparseMatrix::to_dense() const {
+    Matrix m(r_, c_, 0.0);
+    sparse_axpy(1.0, *this, m);
+    return m;
+}
+
+SparseMatrix SparseMatrix::transposed() const {
+    return SparseMatrix(c_, r_, col_ptr_, row_idx_, cval_);
+}
+
+std::size_t SparseMatrix::bytes() const {
+    return (row_ptr_.size() + col_ptr_.size()) * sizeof(std::size_t) +
+           (col_idx_.size() + row_idx_.size()) * sizeof(Index) +
+           (val_.size() + cval_.size()) * sizeof(double);
+}
+
+// ---------- Density policy ----------
+
+static std::atomic<double>& max_density_slot() {
+    static std::atomic<double> slot{[] {
+        double v = kSparseMaxDensityDefault;
+        if (const char* s = std::getenv("LOC_SPARSE_MAX_DENSITY")) {
+            char* end = nullptr;
+            const double x = std::strtod(s, &end);
+            if (end != s && x >= 0.0 && x <= 1.0) v = x;
+        }
+        return v;
+    }()};
+    return slot;
+}
+
+void set_sparse_max_density(double d) {
+    max_density_slot().store(d, std::memory_order_relaxed);
+}
+
+double sparse_max_density() {
+    return max_density_slot().load(std::memory_order_relaxed);
+}
+
+SparsePtr sparsify(const Matrix& m) {
+    const double d = sparse_max_density();
+    if (d <= 0.0 || m.size() < kSparseMinElems) return nullptr;
+    const std::size_t limit = (std::size_t)(d * (double)m.size());
+    const double* p = m.data();
+    std::size_t nnz = 0;
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        if (p[i] != 0.0 && ++nnz > limit) return nullptr;
+    }
+    return std::make_shared<const SparseMatrix>(SparseMatrix::from_dense(m));
+}
+
+// ---------- Kernels ----------
+
+namespace {
+
+inline double epilogue(double alpha, double acc, double beta, const double* c, std::size_t k) {
+    return c ? alpha * acc + beta * c[k] : alpha * acc;
+}
+
+// Runs f(begin, end) over [0, n) in chunks: on the pool when `work`
+// (multiply-adds) reaches the GEMM threshold, else inline.
+void for_ranges(std::size_t n, double work,
+                const std::function<void(std::size_t, std::size_t)>& f) {
+    ThreadPool& pool = global_pool();
+    if (pool.size() <= 1 || n < 2 || work < (double)gemm_parallel_threshold()) {
+        f(0, n);
+        return;
+    }
+    const std::size_t chunks = std::min(n, 4 * pool.size());
+    const std::size_t step = (n + chunks - 1) / chunks;
+    pool.parallel_for((n + step - 1) / step, [&](std::size_t t) {
+        f(t * step, std::min(n, (t + 1) * step));
+    });
+}
+
+void check_product(std::size_t ar, std::size_t ac, std::size_t br, std::size_t bc,
+                   const Matrix* c, const Matrix& out) {
+    if (ac != br) throw std::runtime_error("Matrix matmul: shape mismatch");
+    if (out.rows() != ar || out.cols() != bc)
+        throw std::runtime_error("Matrix matmul: output shape mismatch");
+    if (c && (c->rows() != ar || c->cols() != bc))
+        throw std::runtime_error("Matrix add: shape mismatch");
+}
+
+} // namespace
+
+void spmm_into(double alpha, const SparseMatrix& a, const Matrix& b,
+               double beta, const Matrix* c, Matrix& out) {
+    check_product(a.rows(), a.cols(), b.rows(), b.cols(), c, out);
+    if (c && beta == 0.0) c = nullptr;
+
+    const std::size_t N = b.cols();
+    const auto& rp = a.row_ptr();
+    const auto& ci = a.col_idx();
+    const auto& av = a.values();
+    const double* bd = b.data();
+    const double* cd = c ? c->data() : nullptr;
+    double* o = out.data();
+
+    // out row i = sum over row i's nonzeros a(i, k) * b row k
+    for_ranges(a.rows(), (double)a.nnz() * (double)N, [&](std::size_t i0, std::size_t i1) {
+        std::vector<double> acc(N);
+        for (std::size_t i = i0; i < i1; ++i) {
+            std::fill(acc.begin(), acc.end(), 0.0);
+            for (std::size_t p = rp[i]; p < rp[i + 1]; ++p) {
+                const double v = av[p];
+                const double* brow = bd + (std::size_t)ci[p] * N;
+                for (std::size_t j = 0; j < N; ++j) acc[j] += v * brow[j];
+            }
+            const double* crow = cd ? cd + i * N : nullptr;
+            double* dst = o + i * N;
+            for (std::size_t j = 0; j < N; ++j) dst[j] = epilogue(alpha, acc[j], beta, crow, j);
+        }
+    });
+}
+
+void dense_spmm_into(double alpha, const Matrix& a, const SparseMatrix& b,
+                     double beta, const Matrix* c, Matrix& out) {
+    check_product(a.rows(), a.cols(), b.rows(), b.cols(), c, out);
+    if (c && beta == 0.0) c = nullptr;
+
+    const std::size_t K = a.cols(), N = b.cols();
+    const auto& cp = b.col_ptr();
+    const auto& ri = b.row_idx();
+    const auto& bv = b.col_values();
+    const double* ad = a.data();
+    const double* cd = c ? c->data() : nullptr;
+    double* o = out.data();
+
+    // out(i, j) = a row i dotted with column j's nonzeros
+    for_ranges(a.rows(), (double)a.rows() * (double)b.nnz(), [&](std::size_t i0, std::size_t i1) {
+        for (std::size_t i = i0; i < i1; ++i) {
+            const double* arow = ad + i * K;
+            const double* crow = cd ? cd + i * N : nullptr;
+            double* dst = o + i * N;
+            for (std::size_t j = 0; j < N; ++j) {
+                double acc = 0.0;
+                for (std::size_t p = cp[j]; p < cp[j + 1]; ++p) acc += arow[ri[p]] * bv[p];
+                dst[j] = epilogue(alpha, acc, beta, crow, j);
+            }
+        }
+    });
+}
+
+namespace {
+
+// Rows of a sparse result built independently (one chunk per task), then
+// stitched into CSR.
+struct RowChunk {
+    std::vector<std::size_t> lens;
+    SparseMatrix::Array<SparseMatrix::Index> cols;
+    SparseMatrix::Array<double> vals;
+};
+
+// Accumulates row entries in a dense scratch row, remembering which columns
+// were touched; each column sums its terms in the order they arrive.
+struct RowAccumulator {
+    std::vector<double> acc;
+    std::vector<std::size_t> mark; // row that last touched the column
+    std::vector<SparseMatrix::Index> touched;
+
+    explicit RowAccumulator(std::size_t n)
+        : acc(n), mark(n, std::numeric_limits<std::size_t>::max()) {}
+
+    void add(std::size_t row, SparseMatrix::Index j, double v) {
+        if (mark[j] != row) {
+            mark[j] = row;
+            acc[j] = v;
+            touched.push_back(j);
+        } else {
+            acc[j] += v;
+        }
+    }
+
+    // Appends the row's nonzeros (times alpha) to `out` in column order.
+    void flush(double alpha, RowChunk& out) {
+        std::sort(touched.begin(), touched.end());
+        std::size_t len = 0;
+        for (SparseMatrix::Index j : touched) {
+            const double v = alpha * acc[j];
+            if (v == 0.0) continue;
+            out.cols.push_back(j);
+            out.vals.push_back(v);
+            ++len;
+        }
+        out.lens.push_back(len);
+        touched.clear();
+    }
+};
+
+SparseMatrix stitch(std::size_t rows, std::size_t cols, std::vector<RowChunk>& chunks) {
+    SparseMatrix::Array<std::size_t> row_ptr(rows + 1, 0);
+    std::size_t nnz = 0, i = 0;
+    for (const auto& ch : chunks) nnz += ch.vals.size();
+    SparseMatrix::Array<SparseMatrix::Index> col_idx;
+    SparseMatrix::Array<double> values;
+    if (chunks.size() == 1) { // single-threaded: adopt the chunk's arrays
+        col_idx = std::move(chunks[0].cols);
+        values = std::move(chunks[0].vals);
+    } else {
+        col_idx.reserve(nnz);
+        values.reserve(nnz);
+    }
+    for (auto& ch : chunks) {
+        for (std::size_t len : ch.lens) {
+            row_ptr[i + 1] = row_ptr[i] + len;
+            ++i;
+        }
+        if (chunks.size() > 1) {
+            col_idx.insert(col_idx.end(), ch.cols.begin(), ch.cols.end());
+            values.insert(values.end(), ch.vals.begin(), ch.vals.end());
+        }
+        ch = RowChunk{};
+    }
+    return SparseMatrix(rows, cols, std::move(row_ptr), std::move(col_idx), std::move(values));
+}
+
+// Splits [0, rows) into chunks, runs build(chunk, begin, end) on each (on
+// the pool for large `work`) and stitches the result.
+SparseMatrix build_rows(std::size_t rows, std::size_t cols, double work,
+                        const std::function<void(RowChunk&, std::size_t, std::size_t)>& build) {
+    const std::size_t threads = global_pool().size();
+    const std::size_t n_chunks =
+        threads <= 1 || rows < 2 || work < (double)gemm_parallel_threshold() ? 1 : std::min(rows, 4 * threads);
+    const std::size_t step = (rows + n_chunks - 1) / std::max<std::size_t>(n_chunks, 1);
+    std::vector<RowChunk> chunks(rows ? (rows + step - 1) / step : 0);
+    for_ranges(chunks.size(), work, [&](std::size_t t0, std::size_t t1) {
+        for (std::size_t t = t0; t < t1; ++t) build(chunks[t], t * step, std::min(rows, (t + 1) * step));
+    });
+    return stitch(rows, cols, chunks);
+}
+
+} // namespace
+
+SparseMatrix spgemm(double alpha, const SparseMatrix& a, const SparseMatrix& b) {
+    if (a.cols() != b.rows()) throw std::runtime_error("Matrix matmul: shape mismatch");
+
+    const auto& arp = a.row_ptr();
+    const auto& aci = a.col_idx();
+    const auto& av = a.values();
+    const auto& brp = b.row_ptr();
+    const auto& bci = b.col_idx();
+    const auto& bv = b.values();
+
+    double work = 0.0;
+    for (auto k : aci) work += (double)(brp[k + 1] - brp[k]);
+
+    return build_rows(a.rows(), b.cols(), work, [&](RowChunk& out, std::size_t i0, std::size_t i1) {
+        RowAccumulator row(b.cols());
+        for (std::size_t i = i0; i < i1; ++i) {
+            // Terms arrive in increasing k for every column
+            for (std::size_t p = arp[i]; p < arp[i + 1]; ++p) {
+                const std::size_t k = aci[p];
+                for (std::size_t q = brp[k]; q < brp[k + 1]; ++q) row.add(i, bci[q], av[p] * bv[q]);
+            }
+            row.flush(alpha, out);
+        }
+    });
+}
+
+SparseMatrix sparse_lincomb(const std::vector<double>& coeffs,
+                            const std::vector<const SparseMatrix*>& xs) {
+    if (xs.empty() || coeffs.size() != xs.size())
+        throw std::runtime_error("sparse_lincomb: need one coefficient per input");
+    const std::size_t R = xs[0]->rows(), C = xs[0]->cols();
+    double work = 0.0;
+    for (const SparseMatrix* x : xs) {
+        if (x->rows() != R || x->cols() != C) throw std::runtime_error("Matrix add: shape mismatch");
+        work += (double)x->nnz();
+    }
+
+    return build_rows(R, C, work, [&](RowChunk& out, std::size_t i0, std::size_t i1) {
+        RowAccumulator row(C);
+        for (std::size_t i = i0; i < i1; ++i) {
+            // Terms arrive in input order, as in the dense lincomb
+            for (std::size_t t = 0; t < xs.size(); ++t) {
+                const auto& rp = xs[t]->row_ptr();
+                const auto& ci = xs[t]->col_idx();
+                const auto& v = xs[t]->values();
+                for (std::size_t p = rp[i]; p < rp[i + 1]; ++p) row.add(i, ci[p], coeffs[t] * v[p]);
+            }
+            row.flush(1.0, out);
+        }
+    });
+}
+
+bool sparse_power(const SparseMatrix& a, std::uint64_t k, double max_density, SparseMatrix& out) {
+    using Index = SparseMatrix::Index;
+    const std::size_t n = a.rows();
+    if (a.cols() != n) throw std::runtime_error("Matrix power: matrix is not square");
+    if (k == 0) {
+        SparseMatrix::Array<std::size_t> rp(n + 1);
+        SparseMatrix::Array<Index> ci(n);
+        SparseMatrix::Array<double> v(n, 1.0);
+        for (std::size_t i = 0; i <= n; ++i) rp[i] = i;
+        for (std::size_t i = 0; i < n; ++i) ci[i] = (Index)i;
+        out = SparseMatrix(n, n, std::move(rp), std::move(ci), std::move(v));
+        return true;
+    }
+
+    // The dense power()'s schedule: sq runs through a^(2^i), acc collects
+    // the ones for k's set bits
+    SparseMatrix sq, acc;
+    const SparseMatrix* cur = &a;
+    bool have = false;
+    for (;;) {
+        if (k & 1) {
+            acc = have ? spgemm(1.0, acc, *cur) : *cur;
+            have = true;
+            if (acc.density() > max_density) return false;
+        }
+        k >>= 1;
+        if (!k) break;
+        sq = spgemm(1.0, *cur, *cur);
+        cur = &sq;
+        if (sq.density() > max_density) return false;
+    }
+    out = std::move(acc);
+    return true;
+}
+
+void sparse_axpy(double coeff, const SparseMatrix& s, Matrix& out) {
+    if (out.rows() != s.rows() || out.cols() != s.cols())
+        throw std::runtime_error("Matrix add: shape mismatch");
+    const auto& rp = s.row_ptr();
+    const auto& ci = s.col_idx();
+    const auto& v = s.values();
+    double* o = out.data();
+    for (std::size_t i = 0; i < s.rows(); ++i) {
+        double* row = o + i * s.cols();
+        for (std::size_t p = rp[i]; p < rp[i + 1]; ++p) row[ci[p]] += coeff * v[p];
+    }
+}
+
+} // namespace loc::rt
@@ -0,0 +1,183 @@
+#include "loc/runtime/structure.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace loc::rt {
+
+StructuredOp detect_structure(const Matrix& m) {
+    StructuredOp s;
+    const std::size_t R = m.rows(), C = m.cols();
+    const double* p = m.data();
+
+    if (R != C) {
+        if (std::all_of(p, p + m.size(), [](double x) { return x == 0.0; })) s.kind = Structure::Zero;
+        return s;
+    }
+
+    // One pass over rows: each row may hold at most one nonzero
+    bool diagonal = true, permutation = true;
+    std::vector<double> diag(R, 0.0);
+    std::vector<std::size_t> perm(R, 0);
+    for (std::size_t i = 0; i < R; ++i) {
+        const double* row = p + i * C;
+        std::size_t nnz = 0, at = 0;
+        for (std::size_t j = 0; j < C; ++j) {
+            if (row[j] != 0.0) {
+                if (++nnz > 1) return s;
+                at = j;
+            }
+        }
+        if (nnz == 0) {
+            permutation = false;
+            continue;
+        }
+        if (at != i) diagonal = false;
+        else diag[i] = row[at];
+        if (row[at] != 1.0) permutation = false;
+        perm[i] = at;
+        if (!diagonal && !permutation) return s;
+    }
+
+    if (diagonal) {
+        if (std::all_of(diag.begin(), diag.end(), [](double x) { return x == 0.0; })) {
+            s.kind = Structure::Zero;
+        } else if (std::all_of(diag.begin(), diag.end(), [&](double x) { return x == diag[0]; })) {
+            s.kind = diag[0] == 1.0 ? Structure::Identity : Structure::ScaledIdentity;
+            s.scale = diag[0];
+        } else {
+            s.kind = Structure::Diagonal;
+            s.diag = std::move(diag);
+        }
+        return s;
+    }
+
+    // Every row has a single 1; a permutation also uses every column once
+    std::vector<std::size_t> inv(R, R);
+    for (std::size_t i = 0; i < R; ++i) {
+        if (inv[perm[i]] != R) return s;
+        inv[perm[i]] = i;
+    }
+    s.kind = Structure::Permutation;
+    s.perm = std::move(perm);
+    s.inv = std::move(inv);
+    return s;
+}
+
+// ---------- Kernels ----------
+//
+// A structured factor moves or scales whole rows (on the left) or columns
+// (on the right) of the other one. Each output element is the single
+// nonzero product of the dense sum, computed with the same operations as
+// the GEMM epilogue (alpha * acc [+ beta * c]), so for finite inputs the
+// results match the dense kernels bit for bit. A zero factor (of any
+// shape) contributes acc = 0 everywhere and the other operand is not read,
+// so non-finite values in it don't reach the result.
+
+namespace {
+
+// Source index and factor of output row (left) or column (right) i.
+struct Pick {
+    std::size_t from;
+    double factor;
+};
+
+Pick pick(const StructuredOp& s, std::size_t i, bool left) {
+    switch (s.kind) {
+    case Structure::Identity:       return {i, 1.0};
+    case Structure::ScaledIdentity: return {i, s.scale};
+    case Structure::Diagonal:       return {i, s.diag[i]};
+    case Structure::Permutation:    return {left ? s.perm[i] : s.inv[i], 1.0};
+    case Structure::Zero:           // no source row; handled by the caller
+    case Structure::Dense:
+    case Structure::Sparse:         break;
+    }
+    throw std::runtime_error("structured kernel: no source to pick");
+}
+
+inline double epilogue(double alpha, double acc, double beta, const double* c, std::size_t k) {
+    return c ? alpha * acc + beta * c[k] : alpha * acc;
+}
+
+} // namespace
+
+void structured_gemm_into(double alpha, const Matrix& a, const StructuredOp* sa,
+                          const Matrix& b, const StructuredOp* sb,
+                          double beta, const Matrix* c, Matrix& out) {
+    if (a.cols() != b.rows())
+        throw std::runtime_error("Matrix matmul: shape mismatch");
+    if (out.rows() != a.rows() || out.cols() != b.cols())
+        throw std::runtime_error("Matrix matmul: output shape mismatch");
+    if (c && (c->rows() != out.rows() || c->cols() != out.cols()))
+        throw std::runtime_error("Matrix add: shape mismatch");
+
+    const std::size_t R = out.rows(), C = out.cols();
+    const double* cd = c ? c->data() : nullptr;
+    double* o = out.data();
+
+    if ((sa && sa->kind == Structure::Zero) || (sb && sb->kind == Structure::Zero)) {
+        for (std::size_t i = 0; i < R; ++i) {
+            const double* crow = cd ? cd + i * C : nullptr;
+            double* dst = o + i * C;
+            for (std::size_t j = 0; j < C; ++j) dst[j] = epilogue(alpha, 0.0, beta, crow, j);
+        }
+        return;
+    }
+    if (sa && sa->kind != Structure::Dense && sa->kind != Structure::Sparse) {
+        // (S @ b)[i][:] = factor(i) * b[from(i)][:]
+        const double* bd = b.data();
+        for (std::size_t i = 0; i < R; ++i) {
+            const Pick pk = pick(*sa, i, true);
+            const double* src = bd + pk.from * C;
+            const double* crow = cd ? cd + i * C : nullptr;
+            double* dst = o + i * C;
+            for (std::size_t j = 0; j < C; ++j) dst[j] = epilogue(alpha, src[j] * pk.factor, beta, crow, j);
+        }
+        return;
+    }
+    if (!sb || sb->kind == Structure::Dense || sb->kind == Structure::Sparse)
+        throw std::runtime_error("structured_gemm_into: no structured operand");
+
+    // (a @ S)[:][j] = a[:][from(j)] * factor(j)
+    std::vector<Pick> cols(C);
+    for (std::size_t j = 0; j < C; ++j) cols[j] = pick(*sb, j, false);
+    const double* ad = a.data();
+    const std::size_t K = a.cols();
+    for (std::size_t i = 0; i < R; ++i) {
+        const double* src = ad + i * K;
+        const double* crow = cd ? cd + i * C : nullptr;
+        double* dst = o + i * C;
+        for (std::size_t j = 0; j < C; ++j) {
+            dst[j] = epilogue(alpha, src[cols[j].from] * cols[j].factor, beta, crow, j);
+        }
+    }
+}
+
+void structured_axpy(double coeff, const StructuredOp& s, Matrix& out) {
+    if (out.rows() != out.cols() && s.kind != Structure::Zero)
+        throw std::runtime_error("Matrix add: shape mismatch");
+
+    const std::size_t n = out.rows();
+    double* o = out.data();
+    switch (s.kind) {
+    case Structure::Zero:
+        break;
+    case Structure::Identity:
+    case Structure::ScaledIdentity: {
+        const double v = coeff * s.scale;
+        for (std::size_t i = 0; i < n; ++i) o[i * n + i] += v;
+        break;
+    }
+    case Structure::Diagonal:
+        for (std::size_t i = 0; i < n; ++i) o[i * n + i] += coeff * s.diag[i];
+        break;
+    case Structure::Permutation:
+        for (std::size_t i = 0; i < n; ++i) o[i * n + s.perm[i]] += coeff;
+        break;
+    case Structure::Dense:
+    case Structure::Sparse:
+        throw std::runtime_error("structured_axpy: dense operand");
+    }
+}
+
+} // namespace loc::rt
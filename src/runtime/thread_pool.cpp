@@ -0,0 +1,227 @@
+#include "loc/runtime/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+
+namespace loc::rt {
+
+// Which pool (and which worker slot) the current thread belongs to.
+static thread_local const ThreadPool* tl_pool = nullptr;
+static thread_local std::size_t tl_index = 0;
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    const std::size_t n = threads > 1 ? threads - 1 : 0;
+    local_.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) local_.push_back(std::make_unique<Queue>());
+    workers_.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        workers_.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+bool ThreadPool::pop_local(std::size_t self, Task& out) {
+    Queue& q = *local_[self];
+    std::lock_guard<std::mutex> lk(q.mu);
+    if (q.tasks.empty()) return false;
+    out = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    pending_.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::pop_any(std::size_t self, Task& out) {
+    {
+        std::lock_guard<std::mutex> lk(inject_.mu);
+        if (!inject_.tasks.empty()) {
+            out = std::move(inject_.tasks.front());
+            inject_.tasks.pop_front();
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    const std::size_t w = local_.size();
+    for (std::size_t i = 1; i <= w; ++i) {
+        Queue& q = *local_[(self + i) % w];
+        std::lock_guard<std::mutex> lk(q.mu);
+        if (q.tasks.empty()) continue;
+        out = std::move(q.tasks.front()); // steal the oldest
+        q.tasks.pop_front();
+        pending_.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+// Tasks must not throw; parallel_for and the executor catch inside theirs.
+void ThreadPool::run_task(Task& t) {
+    t();
+    if (helpers_waiting_.load() > 0) {
+        std::lock_guard<std::mutex> lk(mu_);
+        done_cv_.notify_all();
+    }
+}
+
+void ThreadPool::worker_loop(std::size_t self) {
+    tl_pool = this;
+    tl_index = self;
+    for (;;) {
+        Task t;
+        if (pop_local(self, t) || pop_any(self, t)) {
+            run_task(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [&] { return stop_ || pending_.load() > 0; });
+        if (stop_ && pending_.load() == 0) return;
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+    Queue& q = (tl_pool == this) ? *local_[tl_index] : inject_;
+    {
+        std::lock_guard<std::mutex> lk(q.mu);
+        q.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        pending_.fetch_add(1);
+    }
+    cv_.notify_one();
+    if (helpers_waiting_.load() > 0) done_cv_.notify_all();
+}
+
+void ThreadPool::help_until(const std::function<bool()>& done) {
+    const bool is_worker = (tl_pool == this);
+    const std::size_t self = is_worker ? tl_index : 0;
+    while (!done()) {
+        Task t;
+        if ((is_worker && pop_local(self, t)) || (!local_.empty() && pop_any(self, t))) {
+            run_task(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(mu_);
+        helpers_waiting_.fetch_add(1);
+        done_cv_.wait(lk, [&] { return done() || pending_.load() > 0; });
+        helpers_waiting_.fetch_sub(1);
+    }
+}
+
+namespace {
+
+// Shared between the caller and helper tasks; helpers may outlive the call
+// (they find no index left and return without touching `f`).
+struct ForState {
+    std::size_t n = 0;
+    const std::function<void(std::size_t)>* f = nullptr;
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::mutex mu;
+    std::condition_variable cv;
+    std::exception_ptr error;
+
+    void work() {
+        for (;;) {
+            const std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= n) return;
+            try {
+                (*f)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lk(mu);
+                if (!error) error = std::current_exception();
+            }
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == n) {
+                std::lock_guard<std::mutex> lk(mu);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+void ThreadPool::parallel_for(std::size_t n, const std::function<void(std::size_t)>& f) {
+    if (n == 0) return;
+    if (n == 1 || workers_.empty()) {
+        for (std::size_t i = 0; i < n; ++i) f(i);
+        return;
+    }
+
+    auto st = std::make_shared<ForState>();
+    st->n = n;
+    st->f = &f;
+
+    const std::size_t helpers = std::min(workers_.size(), n - 1);
+    for (std::size_t h = 0; h < helpers; ++h) {
+        submit([st] { st->work(); });
+    }
+
+    st->work();
+
+    std::unique_lock<std::mutex> lk(st->mu);
+    st->cv.wait(lk, [&] { return st->done.load(std::memory_order_acquire) == n; });
+    if (st->error) std::rethrow_exception(st->error);
+}
+
+// ---------- Runtime-wide pool ----------
+
+static std::size_t hardware_threads() {
+    const unsigned hw = std::thread::hardware_concurrency();
+    return hw ? hw : 1;
+}
+
+std::size_t max_num_threads() {
+    return std::max<std::size_t>(kMaxThreadsFloor, kMaxThreadsPerCore * hardware_threads());
+}
+
+std::size_t default_num_threads() {
+    if (const char* s = std::getenv("LOC_NUM_THREADS")) {
+        const char* end = s + std::strlen(s);
+        std::size_t v = 0;
+        const auto [p, ec] = std::from_chars(s, end, v);
+        if (p != s && p == end) {
+            // Too many threads (even past 2^64) is clamped, not ignored
+            if (ec == std::errc::result_out_of_range) return max_num_threads();
+            if (ec == std::errc() && v > 0) return std::min(v, max_num_threads());
+        }
+    }
+    return hardware_threads();
+}
+
+static std::mutex g_pool_mu;
+static std::unique_ptr<ThreadPool> g_pool;
+
+ThreadPool& global_pool() {
+    std::lock_guard<std::mutex> lk(g_pool_mu);
+    if (!g_pool) g_pool = std::make_unique<ThreadPool>(default_num_threads());
+    return *g_pool;
+}
+
+void set_num_threads(std::size_t n) {
+    std::lock_guard<std::mutex> lk(g_pool_mu);
+    g_pool = std::make_unique<ThreadPool>(std::clamp<std::size_t>(n, 1, max_num_threads()));
+}
+
+std::size_t num_threads() {
+    return global_pool().size();
+}
+
+} // namespace loc::rt